@@ -6,9 +6,42 @@
 
 #define WIN32_LEAN_AND_MEAN	// Reduce the inclusion of rarely used Windows headers to speed up compilation.
 #include <windows.h>
+#include <winsock2.h>
+#include <winioctl.h>
+#include <iphlpapi.h>
+#include <winternl.h>
+#include <powrprof.h>
+#include <psapi.h>
+#include <pdh.h>
 #include <string>
+#include <vector>
+#include <math.h>
+#include <time.h>
 #include <nvml.h>
 
+#include "CState.h"
+#include "CpuThrottle.h"
+#include "CpuTopology.h"
+#include "DashboardServer.h"
+#include "EffectiveClock.h"
+#include "FanHealth.h"
+#include "History.h"
+#include "MetricExporter.h"
+#include "Metrics.h"
+#include "Msr.h"
+#include "MsrBatch.h"
+#include "PerfCounters.h"
+#include "Predict.h"
+#include "Rates.h"
+#include "Rrd.h"
+#include "SensorLabels.h"
+#include "Sketch.h"
+#include "SubscriptionServer.h"
+#define CPUGPU_BUILD     // Export the snapshot API instead of importing it
+#include "SnapshotApi.h"
+#include "Snapshot.h"
+#include "TopProcesses.h"
+
 #using "LibreHardwareMonitorLib.dll"
 
 using namespace LibreHardwareMonitor::Hardware;
@@ -22,35 +55,248 @@ using namespace LibreHardwareMonitor::Hardware;
 #define NVML_CLK_THROTTLE_REASON_SW_POWER_CAP 0x0000000000000008LL
 
 
+// Source of the GPU data shown by function 2
+enum GpuBackend {
+    GPU_NONE,
+    GPU_NVIDIA,     // NVML
+    GPU_AMD,        // LibreHardwareMonitor
+    GPU_INTEL       // LibreHardwareMonitor, integrated GPUs
+};
+
 static bool nvmlInitialized = false;
+static GpuBackend gpuBackend = GPU_NONE;
 static const int CPU_FAN = 2;       // Index of the CPU fan, based on motherboard specifications. For me it is a #2 on Nuvoton NCT6796D-R chip
 static const int CPU_SPEED = 1800;  // Maximum CPU fan speed in RPM, based on CPU cooler specs
 static const int MIN_INTERVAL = 300; // Minimum refresh interval in milliseconds
+static const int HISTORY_HOURS = 72; // How long per-second sensor history is kept in memory
+static const int CPU_TEMP_LIMIT = 100; // CPU throttling temperature (TjMax) in C when it cannot be read from IA32_TEMPERATURE_TARGET
+static const int GPU_TEMP_LIMIT = 90; // Slowdown temperature in C of AMD and Intel GPUs that report no limit sensor, based on GPU specs
+static const int THROTTLE_WARNING = 60; // Show the warning glyph when a thermal limit is predicted within this many seconds
+static const bool PERF_COUNTERS = false; // Program the CPU performance counters for IPC and cache misses; off by default to leave them to profilers
+static const char* SUBSCRIPTION_PIPE = "CPUGPU"; // Named pipe streaming the values to local clients (\\.\pipe\CPUGPU); empty to disable
+static const char* PUSH_ADDRESS = "";   // Collector to push all metrics to, e.g. "udp://127.0.0.1:8125" (StatsD) or "tcp://127.0.0.1:8094" (Influx); empty to disable
+static const ExportFormat PUSH_FORMAT = EXPORT_STATSD; // EXPORT_STATSD gauges or EXPORT_INFLUX line protocol
+static const int PUSH_INTERVAL = 10;    // Seconds between two pushes to the collector
+static const bool ATTACH_DAEMON = true; // Take the per-second samples from a running CPUGPUd daemon (through SUBSCRIPTION_PIPE) instead of sampling here
+static const int DASHBOARD_PORT = 0;    // Port of the web dashboard on 127.0.0.1 (e.g. 8086 for http://127.0.0.1:8086/); 0 to disable
+static const char* JOB_NAME = "";       // Job object (e.g. of a container) whose CPU load and memory are shown instead of the whole system's; empty for the system
+
+static std::vector<HistorySeries> history;  // One compressed series per Metric
+static double lastValues[METRIC_COUNT];     // Readings of the last history sample, for the snapshot API
+static bool apiOpen = false;                // cpugpu_open was called
+static SubscriptionServer subscriptions;    // Delta stream of the values to pipe clients
+static MetricExporter exporter;             // Push to the collector at PUSH_ADDRESS
+static DashboardServer dashboard;           // Web dashboard on DASHBOARD_PORT
+static time_t lastPush = 0;
+static SubscriptionClient daemonStream;     // Samples of a CPUGPUd daemon
+static bool attachedToDaemon = false;
+static time_t nextAttach = 0;               // Next check for a daemon to hand the sampling over to
+static time_t handoverUntil = 0;            // Services stopped for a starting daemon to take them over until then
+static bool servicesStarted = false;        // StartServices was called and StopServices was not
+static HANDLE daemonMutex = NULL;           // Held by a process serving through cpugpu_serve
+static const char* DAEMON_MUTEX = "Global\\CPUGPUd";
+static const int DAEMON_TIMEOUT = 2;        // Seconds without a frame after which the daemon is considered lost
+static const int ATTACH_RETRY = 10;         // Seconds between two checks for a daemon after falling back
+static const int HANDOVER_TIMEOUT = 5;      // Seconds a starting daemon has to serve the pipe once the plugin freed it
+static RrdFile database;                    // Persistent downsampled history, survives restarts
+static WindowedSketch quantiles[METRIC_COUNT];  // Percentiles over the lifetime and recent hours
+static ThermalPredictor cpuThermal;         // Temperature vs power models for time-to-throttle
+static ThermalPredictor gpuThermal;
+static FanMonitor cpuFanMonitor;            // Learned normal CPU fan speed vs temperature and load
+static time_t lastHistorySample = 0;
+static PDH_HQUERY memoryQuery = NULL;       // Windows performance counters for paging
+static PDH_HCOUNTER pageReadsCounter = NULL;
+static PDH_HCOUNTER pageFileCounter = NULL;
+static const int MAX_DISKS = 32;            // Physical drives probed for I/O counters
+
+
+// Cumulative I/O counters of a physical drive, turned into rates
+struct DiskCounters {
+    int number;                             // N of \\.\PhysicalDriveN
+    HANDLE handle;
+    RateTracker readBytes;
+    RateTracker writeBytes;
+    RateTracker reads = RateTracker(32);    // Operation counts are 32 bits wide and wrap
+    RateTracker writes = RateTracker(32);
+    RateTracker idleTime;                   // 100 ns units spent idle
+};
+
+// Cumulative traffic counters of a network interface, turned into rates
+struct NetCounters {
+    ULONG64 luid;
+    bool up;                                // Connected at the last sample
+    RateTracker received;
+    RateTracker sent;
+};
+
+static std::vector<DiskCounters> disks;
+static bool disksEnumerated = false;        // Cleared by CloseDiskCounters, so a reopen enumerates the drives again
+static std::vector<NetCounters> interfaces; // Physical interfaces in the order they were first seen
+static TopProcesses topProcesses;           // Top CPU and memory consumers
+static HANDLE jobHandle = NULL;             // Job object named by JOB_NAME
+static RateTracker jobCpuTime;              // CPU time of all processes of the job, 100 ns units
 
 
 // Class for monitoring CPU
 public ref class HardwareMonitor abstract sealed {
 public:
     static Computer^ computer = nullptr;
+    static System::Collections::Generic::Dictionary<IHardware^, System::Int64>^ lastUpdate = nullptr;    // Stopwatch timestamp of the last update of each item
     // Initialize the hardware monitor
     static void Initialize() {
         if (computer == nullptr) {
+            lastUpdate = gcnew System::Collections::Generic::Dictionary<IHardware^, System::Int64>();
             computer = gcnew Computer();
             computer->IsCpuEnabled = true;
             computer->IsMotherboardEnabled = true,
+            computer->IsMemoryEnabled = true;
+            computer->IsStorageEnabled = true;
             computer->Open();
         }
     }
+    // Update the sensors of a hardware item unless that was done within MIN_INTERVAL. Every getter of one refresh
+    // and the history sample then share one pass over the item's registers instead of reading them once per value
+    static void Update(IHardware^ hardware) {
+        System::Int64 now = System::Diagnostics::Stopwatch::GetTimestamp();
+        System::Int64 last;
+        if (lastUpdate->TryGetValue(hardware, last) &&
+            now - last < System::Diagnostics::Stopwatch::Frequency * MIN_INTERVAL / 1000) {
+            return;
+        }
+        hardware->Update();
+        lastUpdate[hardware] = now;
+    }
     // Close the hardware monitor
     static void Close() {
         if (computer != nullptr) {
             computer->Close();
             computer = nullptr;
+            lastUpdate = nullptr;
+        }
+    }
+};
+
+
+// Signature of LibreHardwareMonitor's Ring0.ReadMsr(uint index, out uint eax, out uint edx)
+delegate bool ReadMsrHandler(System::UInt32 index, System::UInt32% eax, System::UInt32% edx);
+// Signature of LibreHardwareMonitor's Ring0.WriteMsr(uint index, uint eax, uint edx)
+delegate bool WriteMsrHandler(System::UInt32 index, System::UInt32 eax, System::UInt32 edx);
+
+
+// Access to model-specific registers through the WinRing0 driver opened by LibreHardwareMonitor.
+// Ring0 is internal to LibreHardwareMonitorLib, so its ReadMsr and WriteMsr methods are bound once via reflection
+public ref class MsrAccess abstract sealed {
+public:
+    static ReadMsrHandler^ readMsr = nullptr;
+    static WriteMsrHandler^ writeMsr = nullptr;
+    static bool lookedUp = false;
+
+    static bool Initialize() {
+        if (!lookedUp) {
+            lookedUp = true;
+            try {
+                System::Type^ ring0 = Computer::typeid->Assembly->GetType("LibreHardwareMonitor.Hardware.Ring0");
+                System::Type^ byRef = System::UInt32::typeid->MakeByRefType();
+                System::Reflection::MethodInfo^ method = (ring0 == nullptr) ? nullptr : ring0->GetMethod("ReadMsr",
+                    System::Reflection::BindingFlags::Static | System::Reflection::BindingFlags::Public | System::Reflection::BindingFlags::NonPublic,
+                    nullptr, gcnew array<System::Type^> { System::UInt32::typeid, byRef, byRef }, nullptr);
+                if (method != nullptr) {
+                    readMsr = (ReadMsrHandler^)System::Delegate::CreateDelegate(ReadMsrHandler::typeid, method, false);
+                }
+                method = (ring0 == nullptr) ? nullptr : ring0->GetMethod("WriteMsr",
+                    System::Reflection::BindingFlags::Static | System::Reflection::BindingFlags::Public | System::Reflection::BindingFlags::NonPublic,
+                    nullptr, gcnew array<System::Type^> { System::UInt32::typeid, System::UInt32::typeid, System::UInt32::typeid }, nullptr);
+                if (method != nullptr) {
+                    writeMsr = (WriteMsrHandler^)System::Delegate::CreateDelegate(WriteMsrHandler::typeid, method, false);
+                }
+            }
+            catch (System::Exception^) {
+                readMsr = nullptr;
+                writeMsr = nullptr;
+            }
+        }
+        return readMsr != nullptr;
+    }
+};
+
+
+// MSR reader that pins the calling thread to the target processor for the duration of a batch
+class Ring0MsrReader : public MsrReader {
+public:
+    int ProcessorCount() const override {
+        return (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    }
+
+    bool Read(int processor, const uint32_t* indices, int count, uint64_t* values) override {
+        if (!MsrAccess::Initialize()) return false;
+
+        GROUP_AFFINITY previous = {};
+        if (!PinToProcessor(processor, &previous)) return false;
+
+        bool success = true;
+        try {
+            for (int i = 0; i < count && success; i++) {
+                System::UInt32 eax = 0;
+                System::UInt32 edx = 0;
+                success = MsrAccess::readMsr(indices[i], eax, edx);
+                values[i] = ((uint64_t)edx << 32) | eax;
+            }
         }
+        catch (System::Exception^) {
+            success = false;
+        }
+
+        SetThreadGroupAffinity(GetCurrentThread(), &previous, NULL);
+        return success;
+    }
+
+    bool Write(int processor, uint32_t index, uint64_t value) override {
+        if (!MsrAccess::Initialize() || MsrAccess::writeMsr == nullptr) return false;
+
+        GROUP_AFFINITY previous = {};
+        if (!PinToProcessor(processor, &previous)) return false;
+
+        bool success = false;
+        try {
+            success = MsrAccess::writeMsr(index, (System::UInt32)value, (System::UInt32)(value >> 32));
+        }
+        catch (System::Exception^) {
+            success = false;
+        }
+
+        SetThreadGroupAffinity(GetCurrentThread(), &previous, NULL);
+        return success;
+    }
+
+private:
+    // Pin the calling thread to a system-wide processor number, saving the previous affinity
+    static bool PinToProcessor(int processor, GROUP_AFFINITY* previous) {
+        // Translate the system-wide processor number to a processor group and index
+        WORD group = 0;
+        WORD groupCount = GetActiveProcessorGroupCount();
+        while (group < groupCount && processor >= (int)GetActiveProcessorCount(group)) {
+            processor -= GetActiveProcessorCount(group);
+            group++;
+        }
+        if (group >= groupCount) return false;
+
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = group;
+        affinity.Mask = (KAFFINITY)1 << processor;
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, previous) != FALSE;
     }
 };
 
 
+static Ring0MsrReader msrReader;
+static BatchedMsrReader msrBatch(&msrReader); // One pinned read per logical processor for all engines of a tick
+static EffectiveClock cpuClocks(&msrBatch); // Delivered clocks of all logical processors
+static CpuThrottle cpuThrottle(&msrBatch);  // Package thermal and power limit status
+static CpuTopology cpuTopology;             // Packages and core classes of the logical processors
+static PerfCounters perfCounters(&msrBatch); // Instructions, cycles and LLC misses of all logical processors
+static CStateResidency cStates(&msrBatch);  // Core and package idle state residency
+
+
 // Check if the program is running with administrative privileges
 bool IsRunningAsAdmin() {
     BOOL isAdmin = FALSE;
@@ -81,36 +327,199 @@ bool checkNvmlInitialized(char* errorMsg, size_t bufSize) {
 }
 
 
-// Get the current CPU load in percentage
-int GetCpuLoad() {
+// Seconds on the high-resolution monotonic clock
+double MonotonicSeconds() {
+    static LARGE_INTEGER frequency = {};
+    LARGE_INTEGER now;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / frequency.QuadPart;
+}
+
+
+// Sample the CPU time of the job object named by JOB_NAME. The job is reopened if it went away
+void UpdateJobCounters() {
+    if (JOB_NAME[0] == '\0') return;
+    if (jobHandle == NULL) {
+        jobHandle = OpenJobObjectA(JOB_OBJECT_QUERY, FALSE, JOB_NAME);
+        if (jobHandle == NULL) return;
+    }
+
+    JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+    if (!QueryInformationJobObject(jobHandle, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL)) {
+        CloseHandle(jobHandle);
+        jobHandle = NULL;
+        jobCpuTime.Reset();
+        return;
+    }
+    // Includes the time of processes of the job that have already exited
+    jobCpuTime.Update(accounting.TotalUserTime.QuadPart + accounting.TotalKernelTime.QuadPart, MonotonicSeconds());
+}
+
+
+// Get the CPU load of the job in percentage of its hard CPU rate cap, or of all logical processors without a cap
+int GetJobCpuLoad() {
+    if (jobHandle == NULL || !jobCpuTime.Valid()) return -1;
+
+    double capacity = 1e7 * GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);   // 100 ns units per second
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = {};
+    if (QueryInformationJobObject(jobHandle, JobObjectCpuRateControlInformation, &rate, sizeof(rate), NULL) &&
+        (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) && (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP)) {
+        capacity = capacity * rate.CpuRate / 10000.0;  // CpuRate is in 1/100 of a percent
+    }
+    return static_cast<int>(100.0 * jobCpuTime.Rate() / capacity + 0.5);
+}
+
+
+// Get the memory committed by the job's processes and the job memory limit (0 without a limit) in bytes
+bool GetJobMemory(double* used, double* limit) {
+    JOBOBJECT_MEMORY_USAGE_INFORMATION usage;
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+    if (jobHandle == NULL ||
+        !QueryInformationJobObject(jobHandle, JobObjectMemoryUsageInformation, &usage, sizeof(usage), NULL) ||
+        !QueryInformationJobObject(jobHandle, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL)) {
+        return false;
+    }
+    *used = (double)usage.JobMemory;
+    *limit = (limits.BasicLimitInformation.LimitFlags & JOB_OBJECT_LIMIT_JOB_MEMORY) ? (double)limits.JobMemoryLimit : 0.0;
+    return true;
+}
+
+
+// Package temperature sensor of each CPU, found by canonical name under the rules of SensorLabels.h.
+// Resolved once per hardware item and hardware monitor, so labels are not marshalled on every reading
+public ref class PackageSensors abstract sealed {
+public:
+    static Computer^ owner = nullptr;
+    static System::Collections::Generic::Dictionary<IHardware^, ISensor^>^ sensors = nullptr;   // nullptr if none
+
+    static ISensor^ Find(IHardware^ hardware) {
+        if (owner != HardwareMonitor::computer) {
+            owner = HardwareMonitor::computer;
+            sensors = gcnew System::Collections::Generic::Dictionary<IHardware^, ISensor^>();
+        }
+
+        ISensor^ found = nullptr;
+        if (sensors->TryGetValue(hardware, found)) return found;
+        for each (ISensor ^ sensor in hardware->Sensors) {
+            if (sensor->SensorType != SensorType::Temperature) continue;
+            System::IntPtr label = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(sensor->Name);
+            const char* name = CanonicalSensorName(SENSOR_TEMPERATURE, static_cast<const char*>(label.ToPointer()));
+            System::Runtime::InteropServices::Marshal::FreeHGlobal(label);
+            if (name != nullptr && strcmp(name, "Package") == 0) {
+                found = sensor;
+                break;
+            }
+        }
+        sensors->Add(hardware, found);
+        return found;
+    }
+};
+
+
+// Get the current CPU load in percentage of one package, or averaged over all packages for -1
+// (the load of the job named by JOB_NAME if one is configured)
+int GetCpuLoad(int package = -1) {
+    if (package < 0 && JOB_NAME[0] != '\0') return GetJobCpuLoad();
     HardwareMonitor::Initialize();
+    int index = 0;
+    int found = 0;
+    float sum = 0.0f;
 
     for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
         if (hardware->HardwareType == HardwareType::Cpu) {
-            hardware->Update();
+            if (package < 0 || index == package) {
+                HardwareMonitor::Update(hardware);
+
+                for each (ISensor ^ sensor in hardware->Sensors) {
+                    if (sensor->SensorType == SensorType::Load && sensor->Name == "CPU Total") {
+                        sum += sensor->Value.GetValueOrDefault(0.0f);
+                        found++;
+                        break;
+                    }
+                }
+            }
+            index++;
+        }
+    }
+    if (found == 0) return -1; // Return -1 if the sensor is not found or the value is unavailable
+    return static_cast<int>(sum / found);
+}
+
+
+// Get the current CPU power consumption in watts of one package, or the total of all packages for -1
+int GetCpuPower(int package = -1) {
+    HardwareMonitor::Initialize();
+    int index = 0;
+    int found = 0;
+    float sum = 0.0f;
 
-            for each (ISensor ^ sensor in hardware->Sensors) {
-                if (sensor->SensorType == SensorType::Load && sensor->Name == "CPU Total") {
-                    return static_cast<int>(sensor->Value.GetValueOrDefault(0.0f));
+    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+        if (hardware->HardwareType == HardwareType::Cpu) {
+            if (package < 0 || index == package) {
+                HardwareMonitor::Update(hardware);
+
+                for each (ISensor ^ sensor in hardware->Sensors) {
+                    if (sensor->SensorType == SensorType::Power && sensor->Name->Contains("Package")) {
+                        sum += sensor->Value.GetValueOrDefault(0.0f);
+                        found++;
+                        break;
+                    }
                 }
             }
+            index++;
         }
     }
-    return -1; // Return -1 if the sensor is not found or the value is unavailable
+    if (found == 0) return -1; // Return -1 if the sensor is not found or the value is unavailable
+    return static_cast<int>(sum);
 }
 
 
-// Get the current CPU power consumption in watts
-int GetCpuPower() {
+// Get the current CPU temperature in degrees Celsius of one package, or the hottest package for -1
+int GetCpuTemperature(int package = -1) {
     HardwareMonitor::Initialize();
+    int index = 0;
+    int hottest = -1;
 
     for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
         if (hardware->HardwareType == HardwareType::Cpu) {
-            hardware->Update();
-            
-            for each (ISensor ^ sensor in hardware->Sensors) {
-                if (sensor->SensorType == SensorType::Power && sensor->Name->Contains("Package")) {
-                    return static_cast<int>(sensor->Value.GetValueOrDefault(0.0f));
+            if (package < 0 || index == package) {
+                HardwareMonitor::Update(hardware);
+
+                ISensor^ sensor = PackageSensors::Find(hardware);
+                if (sensor != nullptr) {
+                    //     
+                    int temp = static_cast<int>(sensor->Value.GetValueOrDefault(0.0f));
+                    if (temp > hottest) hottest = temp;
+                }
+            }
+            index++;
+        }
+    }
+    return hottest; // Return -1 if the sensor is not found or the value is unavailable
+}
+
+
+// Get the current CPU fan speed as a percentage of the maximum speed
+int GetCpuFanSpeed(int fanIndex, int maxFanSpeed) {
+    HardwareMonitor::Initialize();
+    int currentFanIndex = 0;
+
+    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+        HardwareMonitor::Update(hardware);
+        // Check subcomponents (e.g., additional sensors on the motherboard)
+        for each (IHardware ^ subHardware in hardware->SubHardware) {
+            HardwareMonitor::Update(subHardware);
+
+            for each (ISensor ^ subSensor in subHardware->Sensors) {
+                if (subSensor->SensorType == SensorType::Fan) {
+                    if (currentFanIndex == fanIndex) {
+                        float currentSpeed = subSensor->Value.GetValueOrDefault(0.0f);
+                        if (currentSpeed == 0.0f) return 0; // Return 0 if the fan is not spinning.
+                        // Convert speed to percentage
+                        return static_cast<int>((currentSpeed / maxFanSpeed) * 100.0f);
+                    }
+                    currentFanIndex++;
                 }
             }
         }
@@ -119,97 +528,1269 @@ int GetCpuPower() {
 }
 
 
-// Get the current CPU temperature in degrees Celsius
-int GetCpuTemperature() {
-    HardwareMonitor::Initialize();
-
-    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
-        if (hardware->HardwareType == HardwareType::Cpu) {
-            hardware->Update();
+// Get the current CPU fan speed in RPM
+int GetCpuFanSpeedRPM(int fanIndex, int maxFanSpeed) {
+    HardwareMonitor::Initialize();
+    int currentFanIndex = 0;
+
+    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+        HardwareMonitor::Update(hardware);
+        // Check subcomponents (e.g., additional sensors on the motherboard)
+        for each (IHardware ^ subHardware in hardware->SubHardware) {
+            HardwareMonitor::Update(subHardware);
+
+            for each (ISensor ^ subSensor in subHardware->Sensors) {
+                if (subSensor->SensorType == SensorType::Fan) {
+                    if (currentFanIndex == fanIndex) {
+                        return static_cast<int>(subSensor->Value.GetValueOrDefault(0.0f));
+                    }
+                    currentFanIndex++;
+                }
+            }
+        }
+    }
+    return -1; // Return -1 if the sensor is not found or the value is unavailable
+}
+
+
+// Get the current CPU clock frequency in MHz of the first core of a package (the first package for -1)
+float GetCpuFrequency(int package = -1) {
+    HardwareMonitor::Initialize();
+    int index = 0;
+
+    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+        if (hardware->HardwareType == HardwareType::Cpu) {
+            if (package < 0 || index == package) {
+                HardwareMonitor::Update(hardware);
+
+                for each (ISensor ^ sensor in hardware->Sensors) {
+                    if (sensor->SensorType == SensorType::Clock && sensor->Name == "CPU Core #1") {
+                        return sensor->Value.GetValueOrDefault(0.0f);
+                    }
+                }
+            }
+            index++;
+        }
+    }
+    return -1;  // Return -1 if the sensor is not found or the value is unavailable
+}
+
+
+// Get the value of a sensor of a hardware item, the first sensor of the type if 'name' is nullptr.
+// Returns -1 if the sensor is not found or the value is unavailable
+float GetSensorValue(IHardware^ hardware, SensorType type, System::String^ name) {
+    for each (ISensor ^ sensor in hardware->Sensors) {
+        if (sensor->SensorType == type && (name == nullptr || sensor->Name == name) && sensor->Value.HasValue) {
+            return sensor->Value.Value;
+        }
+    }
+    return -1;
+}
+
+
+static std::vector<std::string> voltageLabels;     // Label of each of VoltageSensors::sensors, marshalled once
+
+// Voltage sensors of the motherboard chips and CPUs with their labels, enumerated once per hardware monitor
+public ref class VoltageSensors abstract sealed {
+public:
+    static Computer^ owner = nullptr;
+    static System::Collections::Generic::List<ISensor^>^ sensors = nullptr;
+
+    static void Enumerate() {
+        HardwareMonitor::Initialize();
+        if (owner == HardwareMonitor::computer) return;
+        owner = HardwareMonitor::computer;
+        sensors = gcnew System::Collections::Generic::List<ISensor^>();
+        voltageLabels.clear();
+
+        // Motherboard chips measure the rails, CPUs mostly report requested voltages, so the chips come first
+        for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+            if (hardware->HardwareType == HardwareType::Motherboard) Add(hardware);
+        }
+        for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+            if (hardware->HardwareType == HardwareType::Cpu) Add(hardware);
+        }
+    }
+
+private:
+    static void Add(IHardware^ hardware) {
+        // Monitoring chips only list the sensors that returned a reading
+        HardwareMonitor::Update(hardware);
+        for each (ISensor ^ sensor in hardware->Sensors) {
+            if (sensor->SensorType != SensorType::Voltage) continue;
+            System::IntPtr label = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(sensor->Name);
+            voltageLabels.push_back(static_cast<const char*>(label.ToPointer()));
+            System::Runtime::InteropServices::Marshal::FreeHGlobal(label);
+            sensors->Add(sensor);
+        }
+        for each (IHardware ^ subHardware in hardware->SubHardware) Add(subHardware);
+    }
+};
+
+
+// Get a motherboard or CPU voltage in volts by canonical name (VCore, 12V, DRAM, ...) or by the label the chip
+// reports, e.g. "Voltage #5". Returns NAN if there is no such sensor or it has no reading
+double GetVoltage(const char* name) {
+    VoltageSensors::Enumerate();
+    std::vector<const char*> labels;
+    for (size_t i = 0; i < voltageLabels.size(); i++) labels.push_back(voltageLabels[i].c_str());
+    int index = FindSensor(SENSOR_VOLTAGE, name, labels.data(), (int)labels.size());
+    if (index < 0) return NAN;
+
+    ISensor^ found = VoltageSensors::sensors[index];
+    HardwareMonitor::Update(found->Hardware);
+    return found->Value.HasValue ? found->Value.Value : NAN;
+}
+
+
+// Find the first GPU LibreHardwareMonitor reports for the selected backend
+IHardware^ FindLhmGpu() {
+    HardwareType type;
+    if (gpuBackend == GPU_AMD) type = HardwareType::GpuAmd;
+    else if (gpuBackend == GPU_INTEL) type = HardwareType::GpuIntel;
+    else return nullptr;
+
+    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+        if (hardware->HardwareType == type) return hardware;
+    }
+    return nullptr;
+}
+
+
+// Get a GPU metric from LibreHardwareMonitor for GPUs without NVML, in the units of the NVML
+// readings (MHz, W, bytes, %). Returns NAN if the GPU does not report the metric
+double GetLhmGpuMetric(int metric) {
+    HardwareMonitor::Initialize();
+    IHardware^ gpu = FindLhmGpu();
+    if (gpu == nullptr) return NAN;
+    HardwareMonitor::Update(gpu);
+
+    float value = -1;
+    switch (metric) {
+    case METRIC_GPU_LOAD:
+        // Integrated GPUs only report the Direct3D engine loads, the 3D engine is the busiest one
+        value = GetSensorValue(gpu, SensorType::Load, "GPU Core");
+        if (value < 0) value = GetSensorValue(gpu, SensorType::Load, "D3D 3D");
+        break;
+    case METRIC_GPU_TEMP:      value = GetSensorValue(gpu, SensorType::Temperature, "GPU Core"); break;
+    case METRIC_GPU_FAN:       value = GetSensorValue(gpu, SensorType::Control, "GPU Fan"); break;
+    case METRIC_GPU_CLOCK:     value = GetSensorValue(gpu, SensorType::Clock, "GPU Core"); break;
+    case METRIC_GPU_MEM_CLOCK: value = GetSensorValue(gpu, SensorType::Clock, "GPU Memory"); break;
+    case METRIC_GPU_POWER:
+        value = GetSensorValue(gpu, SensorType::Power, "GPU Package");
+        if (value < 0) value = GetSensorValue(gpu, SensorType::Power, nullptr);
+        break;
+    case METRIC_GPU_MEM_ALLOC:
+    case METRIC_GPU_MEM_USAGE: {
+        // Memory sizes are reported in MB, by the driver or else by Direct3D; integrated GPUs use shared memory
+        float used = GetSensorValue(gpu, SensorType::SmallData, "GPU Memory Used");
+        float total = GetSensorValue(gpu, SensorType::SmallData, "GPU Memory Total");
+        if (used < 0) {
+            used = GetSensorValue(gpu, SensorType::SmallData, "D3D Dedicated Memory Used");
+            total = GetSensorValue(gpu, SensorType::SmallData, "D3D Dedicated Memory Total");
+        }
+        if (used < 0) {
+            used = GetSensorValue(gpu, SensorType::SmallData, "D3D Shared Memory Used");
+            total = GetSensorValue(gpu, SensorType::SmallData, "D3D Shared Memory Total");
+        }
+        if (metric == METRIC_GPU_MEM_ALLOC) return (used < 0) ? NAN : used * 1024.0 * 1024.0;
+        return (used < 0 || total <= 0) ? NAN : floor(used * 100.0 / total);
+    }
+    default: break;     // The power limit status is not reported
+    }
+    return (value < 0) ? NAN : value;
+}
+
+
+// Choose where GPU data comes from: NVML when it is available, otherwise an AMD GPU or else an
+// Intel integrated GPU through LibreHardwareMonitor
+void SelectGpuBackend() {
+    if (nvmlInitialized) {
+        gpuBackend = GPU_NVIDIA;
+        return;
+    }
+
+    // GPUs are only enumerated by LibreHardwareMonitor when NVML is missing, NVIDIA cards are read through NVML
+    HardwareMonitor::Initialize();
+    HardwareMonitor::computer->IsGpuEnabled = true;
+    gpuBackend = GPU_AMD;
+    if (FindLhmGpu() != nullptr) return;
+    gpuBackend = GPU_INTEL;
+    if (FindLhmGpu() == nullptr) gpuBackend = GPU_NONE;
+}
+
+
+// Format a sampled value with the unit and precision of its metric, or an error naming the device if it is unavailable
+void FormatSample(int metric, double value, const char* device, bool showUnits, char* out, size_t outSize) {
+    const MetricInfo& info = METRICS[metric];
+    if (isnan(value)) {
+        snprintf(out, outSize, "Error reading %s %s", device, info.name);
+    }
+    else {
+        snprintf(out, outSize, "%.*f%s", info.decimals, value * info.scale, showUnits ? info.unit : "");
+    }
+}
+
+
+// Format a GPU param of a GPU read through LibreHardwareMonitor, with the names and units of the NVML params
+void FormatLhmGpu(const char* param, bool showUnits, char* out, size_t outSize) {
+    int metric = FindMetric(GROUP_GPU, param, strlen(param));
+    if (metric == METRIC_COUNT) {
+        snprintf(out, outSize, "Invalid parameter");
+        return;
+    }
+    FormatSample(metric, GetLhmGpuMetric(metric), "GPU", showUnits, out, outSize);
+}
+
+
+// Collect the paging performance counters; rates are computed by PDH between two collections
+void UpdateMemoryCounters() {
+    if (memoryQuery == NULL) {
+        if (PdhOpenQueryA(NULL, 0, &memoryQuery) != ERROR_SUCCESS) {
+            memoryQuery = NULL;
+            return;
+        }
+        // Page reads are the disk reads that resolve hard (major) page faults
+        PdhAddEnglishCounterA(memoryQuery, "\\Memory\\Page Reads/sec", 0, &pageReadsCounter);
+        PdhAddEnglishCounterA(memoryQuery, "\\Paging File(_Total)\\% Usage", 0, &pageFileCounter);
+    }
+    PdhCollectQueryData(memoryQuery);
+}
+
+
+// Get the current value of a performance counter, NAN if it is unavailable
+double GetCounterValue(PDH_HCOUNTER counter) {
+    PDH_FMT_COUNTERVALUE value;
+    if (counter == NULL || PdhGetFormattedCounterValue(counter, PDH_FMT_DOUBLE, NULL, &value) != ERROR_SUCCESS) {
+        return NAN;
+    }
+    return value.doubleValue;
+}
+
+
+// Get a system memory metric in bytes, percent or faults per second: RAM from LibreHardwareMonitor
+// (or of the job named by JOB_NAME), the file cache and page file from Windows. Returns NAN if it is unavailable
+double GetMemoryMetric(int metric) {
+    if (JOB_NAME[0] != '\0' && (metric == METRIC_MEM_USED || metric == METRIC_MEM_AVAILABLE || metric == METRIC_MEM_USAGE)) {
+        // Memory of the job named by JOB_NAME, relative to its limit or else to the physical memory
+        double used, limit;
+        if (!GetJobMemory(&used, &limit)) return NAN;
+        if (limit == 0.0) {
+            MEMORYSTATUSEX status = {};
+            status.dwLength = sizeof(status);
+            if (!GlobalMemoryStatusEx(&status)) return NAN;
+            limit = (double)status.ullTotalPhys;
+        }
+        if (metric == METRIC_MEM_USED) return used;
+        if (metric == METRIC_MEM_AVAILABLE) return (limit > used) ? limit - used : 0.0;
+        return floor(used * 100.0 / limit);
+    }
+
+    if (metric == METRIC_MEM_USED || metric == METRIC_MEM_AVAILABLE || metric == METRIC_MEM_USAGE) {
+        HardwareMonitor::Initialize();
+        for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+            if (hardware->HardwareType == HardwareType::Memory) {
+                HardwareMonitor::Update(hardware);
+
+                // Sizes are reported in GB
+                float value = -1;
+                if (metric == METRIC_MEM_USED) value = GetSensorValue(hardware, SensorType::Data, "Memory Used");
+                else if (metric == METRIC_MEM_AVAILABLE) value = GetSensorValue(hardware, SensorType::Data, "Memory Available");
+                else value = GetSensorValue(hardware, SensorType::Load, "Memory");
+                if (value < 0) return NAN;
+                return (metric == METRIC_MEM_USAGE) ? value : value * 1024.0 * 1024.0 * 1024.0;
+            }
+        }
+        return NAN;
+    }
+
+    if (metric == METRIC_MEM_FAULTS) return GetCounterValue(pageReadsCounter);
+
+    PERFORMANCE_INFORMATION performance = {};
+    performance.cb = sizeof(performance);
+    if (!GetPerformanceInfo(&performance, sizeof(performance))) return NAN;
+    double pageSize = (double)performance.PageSize;
+
+    if (metric == METRIC_MEM_CACHED) return performance.SystemCache * pageSize;
+
+    // The commit limit is the physical memory plus the size of all page files
+    double pageFileUsage = GetCounterValue(pageFileCounter);
+    if (metric == METRIC_MEM_SWAP_USAGE) return pageFileUsage;
+    double pageFileSize = ((double)performance.CommitLimit - (double)performance.PhysicalTotal) * pageSize;
+    if (isnan(pageFileUsage) || pageFileSize < 0) return NAN;
+    return pageFileUsage * pageFileSize / 100.0;
+}
+
+
+// Sample the I/O counters of all physical drives. Drives are opened once and kept open
+void UpdateDiskCounters() {
+    if (!disksEnumerated) {
+        disksEnumerated = true;
+        for (int i = 0; i < MAX_DISKS; i++) {
+            char path[32];
+            snprintf(path, sizeof(path), "\\\\.\\PhysicalDrive%d", i);
+            // No access rights are needed to query the performance counters
+            HANDLE handle = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+            if (handle == INVALID_HANDLE_VALUE) continue;
+            DiskCounters disk;
+            disk.number = i;
+            disk.handle = handle;
+            disks.push_back(disk);
+        }
+    }
+
+    for (size_t i = 0; i < disks.size(); i++) {
+        DiskCounters& disk = disks[i];
+        DISK_PERFORMANCE performance;
+        DWORD bytes = 0;
+        if (!DeviceIoControl(disk.handle, IOCTL_DISK_PERFORMANCE, NULL, 0, &performance, sizeof(performance), &bytes, NULL)) {
+            disk.readBytes.Reset();
+            disk.writeBytes.Reset();
+            disk.reads.Reset();
+            disk.writes.Reset();
+            disk.idleTime.Reset();
+            continue;
+        }
+
+        double now = MonotonicSeconds();
+        disk.readBytes.Update(performance.BytesRead.QuadPart, now);
+        disk.writeBytes.Update(performance.BytesWritten.QuadPart, now);
+        disk.reads.Update(performance.ReadCount, now);
+        disk.writes.Update(performance.WriteCount, now);
+        disk.idleTime.Update(performance.IdleTime.QuadPart, now);
+    }
+}
+
+
+// Close the physical drives opened for I/O counters
+void CloseDiskCounters() {
+    for (size_t i = 0; i < disks.size(); i++) CloseHandle(disks[i].handle);
+    disks.clear();
+    disksEnumerated = false;
+}
+
+
+// Sample the traffic counters of all connected physical network interfaces
+void UpdateNetworkCounters() {
+    PMIB_IF_TABLE2 table = NULL;
+    if (GetIfTable2(&table) != NO_ERROR) return;
+
+    double now = MonotonicSeconds();
+    for (size_t i = 0; i < interfaces.size(); i++) interfaces[i].up = false;
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        const MIB_IF_ROW2& row = table->Table[i];
+        // Skip loopback, virtual and filter interfaces, which would count the same traffic again
+        if (row.Type == IF_TYPE_SOFTWARE_LOOPBACK || !row.InterfaceAndOperStatusFlags.HardwareInterface ||
+            row.InterfaceAndOperStatusFlags.FilterInterface || row.OperStatus != IfOperStatusUp) {
+            continue;
+        }
+
+        size_t index = 0;
+        while (index < interfaces.size() && interfaces[index].luid != row.InterfaceLuid.Value) index++;
+        if (index == interfaces.size()) {
+            NetCounters counters;
+            counters.luid = row.InterfaceLuid.Value;
+            interfaces.push_back(counters);
+        }
+
+        NetCounters& counters = interfaces[index];
+        counters.up = true;
+        counters.received.Update(row.InOctets, now);
+        counters.sent.Update(row.OutOctets, now);
+    }
+    FreeMibTable(table);
+}
+
+
+// Drives LibreHardwareMonitor reports with their physical drive numbers, discovered once per hardware monitor
+public ref class StorageDrives abstract sealed {
+public:
+    static Computer^ owner = nullptr;
+    static System::Collections::Generic::List<IHardware^>^ drives = nullptr;
+    static System::Collections::Generic::List<int>^ numbers = nullptr;
+
+    static void Discover() {
+        HardwareMonitor::Initialize();
+        if (owner == HardwareMonitor::computer) return;
+        owner = HardwareMonitor::computer;
+        drives = gcnew System::Collections::Generic::List<IHardware^>();
+        numbers = gcnew System::Collections::Generic::List<int>();
+
+        for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
+            if (hardware->HardwareType != HardwareType::Storage) continue;
+            // Identifiers end with the physical drive number, e.g. "/nvme/1" or "/hdd/0"
+            System::String^ identifier = hardware->Identifier->ToString();
+            int number;
+            if (System::Int32::TryParse(identifier->Substring(identifier->LastIndexOf('/') + 1), number)) {
+                drives->Add(hardware);
+                numbers->Add(number);
+            }
+        }
+    }
+};
+
+
+// Get the temperature in degrees Celsius of physical drive 'number', or of the hottest drive for -1.
+// Returns NAN if no drive reports a temperature
+double GetDriveTemperature(int number) {
+    StorageDrives::Discover();
+    float hottest = -1;
+    for (int i = 0; i < StorageDrives::drives->Count; i++) {
+        if (number >= 0 && StorageDrives::numbers[i] != number) continue;
+        HardwareMonitor::Update(StorageDrives::drives[i]);
+        // NVMe drives report several probes, the first one is the composite temperature
+        float temp = GetSensorValue(StorageDrives::drives[i], SensorType::Temperature, nullptr);
+        if (temp > hottest) hottest = temp;
+    }
+    return (hottest < 0) ? NAN : hottest;
+}
+
+
+// Get a disk metric in bytes or operations per second, utilization in percent or temperature of the physical
+// drive 'number', or the total (the busiest or hottest drive) for -1. Returns NAN if unavailable
+double GetDiskMetric(int metric, int number = -1) {
+    if (metric == METRIC_DISK_TEMP) return GetDriveTemperature(number);
+
+    double total = 0.0;
+    int found = 0;
+    for (size_t i = 0; i < disks.size(); i++) {
+        const DiskCounters& disk = disks[i];
+        if (number >= 0 && disk.number != number) continue;
+
+        const RateTracker& rate = (metric == METRIC_DISK_READ) ? disk.readBytes
+            : (metric == METRIC_DISK_WRITE) ? disk.writeBytes
+            : (metric == METRIC_DISK_READ_IOPS) ? disk.reads
+            : (metric == METRIC_DISK_WRITE_IOPS) ? disk.writes
+            : disk.idleTime;
+        if (!rate.Valid()) continue;
+
+        if (metric == METRIC_DISK_UTIL) {
+            // Idle time advances by 10^7 units per second while the drive is idle
+            double util = 100.0 - rate.Rate() / 1e5;
+            if (util < 0.0) util = 0.0;
+            if (found == 0 || util > total) total = util;
+        }
+        else {
+            total += rate.Rate();
+        }
+        found++;
+    }
+    return (found > 0) ? total : NAN;
+}
+
+
+// Get the received or sent bytes per second of the connected physical interface 'index',
+// or of all of them for -1. Returns NAN if unavailable
+double GetNetMetric(int metric, int index = -1) {
+    double total = 0.0;
+    int found = 0;
+    for (size_t i = 0; i < interfaces.size(); i++) {
+        if (index >= 0 && (int)i != index) continue;
+        const RateTracker& rate = (metric == METRIC_NET_RX) ? interfaces[i].received : interfaces[i].sent;
+        if (!interfaces[i].up || !rate.Valid()) continue;
+        total += rate.Rate();
+        found++;
+    }
+    return (found > 0) ? total : NAN;
+}
+
+
+// Layout of the SystemProcessInformation entries returned by NtQuerySystemInformation
+typedef struct _SYSTEM_PROCESS_ENTRY {
+    ULONG NextEntryOffset;
+    ULONG NumberOfThreads;
+    LARGE_INTEGER WorkingSetPrivateSize;
+    ULONG HardFaultCount;
+    ULONG NumberOfThreadsHighWatermark;
+    ULONGLONG CycleTime;
+    LARGE_INTEGER CreateTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER KernelTime;
+    UNICODE_STRING ImageName;
+    LONG BasePriority;
+    HANDLE UniqueProcessId;
+} SYSTEM_PROCESS_ENTRY;
+
+static const NTSTATUS PROCESS_INFO_LENGTH_MISMATCH = (NTSTATUS)0xC0000004L;  // STATUS_INFO_LENGTH_MISMATCH, the buffer is too small
+
+
+// Scan all processes for the top CPU and memory consumers, at most once per second.
+// A single system call returns the times and memory of every process, so no process is opened
+void UpdateTopProcesses() {
+    static std::vector<BYTE> buffer(256 * 1024);
+    static double lastScan = 0.0;
+
+    double now = MonotonicSeconds();
+    if (lastScan != 0.0 && now - lastScan < 1.0) return;
+
+    ULONG length = 0;
+    NTSTATUS status;
+    while ((status = NtQuerySystemInformation(SystemProcessInformation, buffer.data(), (ULONG)buffer.size(), &length))
+        == PROCESS_INFO_LENGTH_MISMATCH) {
+        buffer.resize(length + 64 * 1024);  // Leave room for processes started meanwhile
+    }
+    if (status < 0) return;
+    lastScan = now;
+
+    topProcesses.Begin(now);
+    for (ULONG offset = 0; ; ) {
+        const SYSTEM_PROCESS_ENTRY* entry = (const SYSTEM_PROCESS_ENTRY*)(buffer.data() + offset);
+        uint32_t pid = (uint32_t)(ULONG_PTR)entry->UniqueProcessId;
+        if (pid != 0) {
+            // The idle process (pid 0) is skipped; names are only converted for new processes
+            uint64_t cpuTime = entry->UserTime.QuadPart + entry->KernelTime.QuadPart;
+            if (topProcesses.Sample(pid, entry->CreateTime.QuadPart, cpuTime, entry->WorkingSetPrivateSize.QuadPart)) {
+                char name[MAX_PATH] = "";
+                WideCharToMultiByte(CP_ACP, 0, entry->ImageName.Buffer, entry->ImageName.Length / sizeof(WCHAR),
+                    name, sizeof(name) - 1, NULL, NULL);
+                topProcesses.SetName(pid, name);
+            }
+        }
+        if (entry->NextEntryOffset == 0) break;
+        offset += entry->NextEntryOffset;
+    }
+    topProcesses.End((int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+}
+
+
+// Format a top process selector: the rank, optionally followed by "_cpu" or "_mem", e.g. "1" for
+// the name of the top process, "1_cpu" for its CPU usage. Processes are ranked by CPU usage or memory
+void FormatTopProcess(const char* selector, bool byMemory, bool showUnits, char* out, size_t outSize) {
+    char* suffix = NULL;
+    long rank = strtol(selector, &suffix, 10);
+    if (suffix == selector || rank < 1 || rank > TopProcesses::TOP_COUNT ||
+        (*suffix != '\0' && strcmp(suffix, "_cpu") != 0 && strcmp(suffix, "_mem") != 0)) {
+        snprintf(out, outSize, "Invalid parameter");
+        return;
+    }
+
+    UpdateTopProcesses();
+    if (!topProcesses.Valid()) {
+        snprintf(out, outSize, "Error reading processes");
+        return;
+    }
+    if (rank > topProcesses.Count(byMemory)) {
+        snprintf(out, outSize, " ");
+        return;
+    }
+
+    const TopEntry& entry = topProcesses.Top(rank - 1, byMemory);
+    if (strcmp(suffix, "_cpu") == 0) {
+        snprintf(out, outSize, showUnits ? "%.1f%%" : "%.1f", entry.cpu);
+    }
+    else if (strcmp(suffix, "_mem") == 0) {
+        snprintf(out, outSize, showUnits ? "%.0fMB" : "%.0f", entry.memory / (1024.0 * 1024.0));
+    }
+    else {
+        snprintf(out, outSize, "%s", entry.name.c_str());
+    }
+}
+
+
+// Layout of the ProcessorInformation entries returned by CallNtPowerInformation
+typedef struct _PROCESSOR_POWER_INFORMATION {
+    ULONG Number;
+    ULONG MaxMhz;
+    ULONG CurrentMhz;
+    ULONG MhzLimit;
+    ULONG MaxIdleState;
+    ULONG CurrentIdleState;
+} PROCESSOR_POWER_INFORMATION;
+
+
+// Sample the delivered clocks of all logical processors from APERF/MPERF.
+// Falls back to the current clocks reported by Windows when the MSRs cannot be read
+void UpdateCpuClocks() {
+    static std::vector<PROCESSOR_POWER_INFORMATION> power;
+    static std::vector<double> currentMhz;
+
+    size_t count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    power.resize(count);
+    if (CallNtPowerInformation(ProcessorInformation, NULL, 0, power.data(),
+        (ULONG)(count * sizeof(PROCESSOR_POWER_INFORMATION))) != 0) {
+        return;
+    }
+
+    // MPERF counts at the nominal (maximum non-turbo) frequency
+    if (!cpuClocks.Update(power[0].MaxMhz)) {
+        currentMhz.resize(count);
+        for (size_t i = 0; i < count; i++) currentMhz[i] = power[i].CurrentMhz;
+        cpuClocks.UpdateFromCurrentClocks(currentMhz.data(), (int)count);
+    }
+}
+
+
+// Format a delivered clock selector: "min", "avg", "max", "busy" or a logical processor number
+bool FormatCpuClock(const char* selector, bool showUnits, char* out, size_t outSize) {
+    double clock;
+    if (strcmp(selector, "min") == 0) clock = cpuClocks.Min();
+    else if (strcmp(selector, "avg") == 0) clock = cpuClocks.Average();
+    else if (strcmp(selector, "max") == 0) clock = cpuClocks.Max();
+    else if (strcmp(selector, "busy") == 0) clock = cpuClocks.BusyWeighted();
+    else if (selector[0] != '\0' && strspn(selector, "0123456789") == strlen(selector)) {
+        int processor = atoi(selector);
+        if (processor >= cpuClocks.Count()) {
+            snprintf(out, outSize, "Invalid parameter");
+            return true;
+        }
+        clock = cpuClocks.Clock(processor);
+    }
+    else {
+        return false;   // Not a clock selector, e.g. a history query like "Clock@max1h"
+    }
+
+    if (!cpuClocks.Valid()) {
+        snprintf(out, outSize, "Error reading CPU clock");
+    }
+    else {
+        snprintf(out, outSize, showUnits ? "%.2fGHz" : "%.2f", clock / 1000.0);
+    }
+    return true;
+}
+
+
+// Sample the CPU performance counters over the time since the previous sample.
+// Skipped when disabled by PERF_COUNTERS or when the CPU has no architectural PMU
+void UpdatePerfCounters() {
+    static double last = 0.0;
+    static int supported = -1;
+
+    if (supported < 0) supported = (PERF_COUNTERS && PerfCounters::Supported()) ? 1 : 0;
+    if (!supported) return;
+
+    double now = MonotonicSeconds();
+    perfCounters.Update((last == 0.0) ? 0.0 : now - last);
+    last = now;
+}
+
+
+// Detect the package and efficiency class of every logical processor
+void DetectCpuTopology() {
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, NULL, &length);
+    std::vector<char> buffer(length);
+    if (length == 0 || !GetLogicalProcessorInformationEx(RelationAll,
+        (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(), &length)) {
+        return;
+    }
+
+    // System-wide processor numbers are assigned group by group, as in Ring0MsrReader
+    WORD groupCount = GetActiveProcessorGroupCount();
+    std::vector<int> groupSizes(groupCount);
+    for (WORD group = 0; group < groupCount; group++) groupSizes[group] = (int)GetActiveProcessorCount(group);
+    cpuTopology.Build(buffer.data(), length, groupSizes);
+}
+
+
+// Get the first logical processor of each package, on which package-scoped MSRs are read
+const std::vector<int>& GetPackageProcessors() {
+    static std::vector<int> packageProcessors;
+
+    if (cpuTopology.Empty()) DetectCpuTopology();
+    if (packageProcessors.empty()) {
+        for (int package = 0; package < cpuTopology.PackageCount(); package++) {
+            const std::vector<int>& processors = cpuTopology.PackageProcessors(package);
+            if (!processors.empty()) packageProcessors.push_back(processors[0]);
+        }
+    }
+    return packageProcessors;
+}
+
+
+// Sample the C-state residency counters; package states are read on the first processor of each package
+void UpdateCStates() {
+    cStates.Update(GetPackageProcessors());
+}
+
+
+// Format a per-package or per-core-class selector: "Load", "Power", "Temp" or "Clock" followed by
+// "@pkg<N>" for one package, or "Load" or "Clock" followed by "@P" or "@E" for one core class.
+// Returns false if 'param' is not such a selector
+bool FormatCpuTopology(const char* param, bool showUnits, char* out, size_t outSize) {
+    const char* at = strchr(param, '@');
+    if (at == NULL) return false;
+    std::string field(param, at - param);
+    const char* selector = at + 1;
+    bool isPackage = strncmp(selector, "pkg", 3) == 0 && selector[3] != '\0'
+        && strspn(selector + 3, "0123456789") == strlen(selector + 3);
+    bool isClass = strcmp(selector, "P") == 0 || strcmp(selector, "E") == 0;
+    if (!isPackage && !isClass) return false;
+    if (field != "Load" && field != "Power" && field != "Temp" && field != "Clock") return false;
+
+    if (cpuTopology.Empty()) DetectCpuTopology();
+
+    if (isPackage) {
+        int package = atoi(selector + 3);
+        if (package >= cpuTopology.PackageCount()) {
+            snprintf(out, outSize, "Invalid parameter");
+            return true;
+        }
+
+        if (field == "Load") {
+            int load = GetCpuLoad(package);
+            if (load < 0) snprintf(out, outSize, "Error reading CPU Load");
+            else snprintf(out, outSize, showUnits ? "%u%%" : "%u", load);
+        }
+        else if (field == "Power") {
+            int tdp = GetCpuPower(package);
+            if (tdp < 0) snprintf(out, outSize, "Error reading CPU Power");
+            else snprintf(out, outSize, showUnits ? "%uW" : "%u", tdp);
+        }
+        else if (field == "Temp") {
+            int temp = GetCpuTemperature(package);
+            if (temp < 0) snprintf(out, outSize, "Error reading CPU Temp");
+            else snprintf(out, outSize, showUnits ? "%uC" : "%u", temp);
+        }
+        else {
+            // Prefer the delivered clock of the package, the reported clock of its first core otherwise
+            double clock = cpuClocks.Measured()
+                ? cpuClocks.BusyWeighted(cpuTopology.PackageProcessors(package))
+                : GetCpuFrequency(package);
+            if (clock < 0) snprintf(out, outSize, "Error reading CPU clock");
+            else snprintf(out, outSize, showUnits ? "%.2fGHz" : "%.2f", clock / 1000.0);
+        }
+        return true;
+    }
+
+    // Power and temperature are only reported per package
+    int coreClass = cpuTopology.FindClass(selector);
+    if (coreClass < 0 || field == "Power" || field == "Temp") {
+        snprintf(out, outSize, "Invalid parameter");
+        return true;
+    }
+
+    const std::vector<int>& processors = cpuTopology.ClassProcessors(coreClass);
+    if (field == "Load") {
+        // The busy share is only known when the clocks are measured from the counters
+        if (!cpuClocks.Measured()) snprintf(out, outSize, "Error reading CPU Load");
+        else snprintf(out, outSize, showUnits ? "%.0f%%" : "%.0f", cpuClocks.Load(processors));
+    }
+    else {
+        if (!cpuClocks.Valid()) snprintf(out, outSize, "Error reading CPU clock");
+        else snprintf(out, outSize, showUnits ? "%.2fGHz" : "%.2f", cpuClocks.BusyWeighted(processors) / 1000.0);
+    }
+    return true;
+}
+
+
+// Read the current value of a metric in the units of its getter; returns NAN if unavailable
+double SampleMetric(int metric) {
+    double value = -1;
+
+    switch (metric) {
+    case METRIC_CPU_LOAD:    value = GetCpuLoad(); break;
+    case METRIC_CPU_POWER:   value = GetCpuPower(); break;
+    case METRIC_CPU_TEMP:    value = GetCpuTemperature(); break;
+    case METRIC_CPU_FAN_RPM: value = GetCpuFanSpeedRPM(CPU_FAN, CPU_SPEED); break;
+    case METRIC_CPU_FAN:     value = GetCpuFanSpeed(CPU_FAN, CPU_SPEED); break;
+    case METRIC_CPU_CLOCK:   value = GetCpuFrequency(); break;
+    case METRIC_CPU_LIMIT:   return cpuThrottle.Valid() ? (cpuThrottle.Throttling() ? 1 : 0) : NAN;
+    case METRIC_CPU_IPC:     return perfCounters.Valid() ? perfCounters.Ipc() : NAN;
+    case METRIC_CPU_LLC_MISS: return perfCounters.Valid() ? perfCounters.LlcMissRate() : NAN;
+    case METRIC_CPU_INSTR:   return perfCounters.Valid() ? perfCounters.InstructionsPerSecond() : NAN;
+    case METRIC_MEM_USED:
+    case METRIC_MEM_AVAILABLE:
+    case METRIC_MEM_USAGE:
+    case METRIC_MEM_CACHED:
+    case METRIC_MEM_SWAP:
+    case METRIC_MEM_SWAP_USAGE:
+    case METRIC_MEM_FAULTS:  return GetMemoryMetric(metric);
+    case METRIC_DISK_READ:
+    case METRIC_DISK_WRITE:
+    case METRIC_DISK_READ_IOPS:
+    case METRIC_DISK_WRITE_IOPS:
+    case METRIC_DISK_UTIL:
+    case METRIC_DISK_TEMP:   return GetDiskMetric(metric);
+    case METRIC_NET_RX:
+    case METRIC_NET_TX:      return GetNetMetric(metric);
+    default: {
+        if (gpuBackend != GPU_NVIDIA) return GetLhmGpuMetric(metric);
+
+        // GPU metrics are read straight from NVML
+        nvmlDevice_t device;
+        if (!nvmlInitialized || nvmlDeviceGetHandleByIndex(0, &device) != NVML_SUCCESS) {
+            return NAN;
+        }
+
+        unsigned int reading = 0;
+        nvmlReturn_t result = NVML_ERROR_NOT_SUPPORTED;
+        if (metric == METRIC_GPU_LOAD) {
+            nvmlUtilization_t utilization = {};
+            result = nvmlDeviceGetUtilizationRates(device, &utilization);
+            value = utilization.gpu;
+        }
+        else if (metric == METRIC_GPU_POWER) {
+            result = nvmlDeviceGetPowerUsage(device, &reading);
+            value = reading / 1000.0;
+        }
+        else if (metric == METRIC_GPU_LIMIT) {
+            unsigned long long throttleReasons = 0;
+            result = nvmlDeviceGetCurrentClocksThrottleReasons(device, &throttleReasons);
+            value = (throttleReasons & NVML_CLK_THROTTLE_REASON_RELIABILITY) ? 1 : 0;
+        }
+        else if (metric == METRIC_GPU_TEMP) {
+            result = nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &reading);
+            value = reading;
+        }
+        else if (metric == METRIC_GPU_FAN) {
+            result = nvmlDeviceGetFanSpeed(device, &reading);
+            value = reading;
+        }
+        else if (metric == METRIC_GPU_CLOCK) {
+            result = nvmlDeviceGetClock(device, NVML_CLOCK_GRAPHICS, NVML_CLOCK_ID_CURRENT, &reading);
+            value = reading;
+        }
+        else if (metric == METRIC_GPU_MEM_CLOCK) {
+            result = nvmlDeviceGetClock(device, NVML_CLOCK_MEM, NVML_CLOCK_ID_CURRENT, &reading);
+            value = reading;
+        }
+        else if (metric == METRIC_GPU_MEM_ALLOC || metric == METRIC_GPU_MEM_USAGE) {
+            nvmlMemory_t memInfo = {};
+            result = nvmlDeviceGetMemoryInfo(device, &memInfo);
+            value = (metric == METRIC_GPU_MEM_ALLOC) ? (double)memInfo.used : (memInfo.total > 0) ? (double)((memInfo.used * 100) / memInfo.total) : NAN;
+        }
+        return (result == NVML_SUCCESS) ? value : NAN;
+    }
+    }
+    return (value < 0) ? NAN : value;
+}
+
+
+static_assert(CPUGPU_MAX_VALUES == FRAME_MAX_VALUES, "Pipe frames carry the snapshot values");
+
+
+// Start serving the values as configured: the subscription pipe, the web dashboard and the collector push
+void StartServices() {
+    servicesStarted = true;
+    if (SUBSCRIPTION_PIPE[0] != '\0') {
+        // Stream the values to local clients
+        subscriptions.Start(SUBSCRIPTION_PIPE);
+    }
+
+    if (DASHBOARD_PORT != 0) {
+        // Serve the web dashboard to local browsers
+        dashboard.Start(DASHBOARD_PORT);
+    }
+
+    if (PUSH_ADDRESS[0] != '\0' && !exporter.IsOpen()) {
+        // Push the metrics to the local collector, tagged with the computer name
+        char host[MAX_COMPUTERNAME_LENGTH + 1];
+        DWORD hostLength = sizeof(host);
+        if (!GetComputerNameA(host, &hostLength)) strcpy_s(host, "localhost");
+        exporter.Open(PUSH_ADDRESS, PUSH_FORMAT, host);
+    }
+}
+
+
+// Stop serving the values, so that a daemon can take the pipe, the dashboard port and the collector over
+void StopServices() {
+    servicesStarted = false;
+    subscriptions.Stop();
+    dashboard.Stop();
+    exporter.Close();
+}
+
+
+// True if a CPUGPUd daemon runs, whether or not it serves the pipe yet
+bool DaemonRunning() {
+    HANDLE mutex = OpenMutexA(SYNCHRONIZE, FALSE, DAEMON_MUTEX);
+    if (mutex != NULL) {
+        CloseHandle(mutex);
+        return true;
+    }
+    return GetLastError() == ERROR_ACCESS_DENIED;   // Created by a service with a stricter DACL
+}
+
+
+// Take the samples from the daemon serving the pipe; returns false if none does
+bool AttachToDaemon() {
+    if (!daemonStream.Connect(SUBSCRIPTION_PIPE, ~0ull)) return false;
+    attachedToDaemon = true;
+    StopServices();
+    perfCounters.Forget();      // The daemon has taken over the performance counters
+    return true;
+}
+
+
+// Sample and serve here again, after the daemon stopped or fell silent
+void DetachFromDaemon(time_t now) {
+    attachedToDaemon = false;
+    daemonStream.Disconnect();
+    nextAttach = now + ATTACH_RETRY;
+    StartServices();
+}
+
+
+// Attach to a daemon that started after the plugin: free the pipe for it and connect as soon as it serves it,
+// or serve again if it does not within HANDOVER_TIMEOUT
+void RetryAttach(time_t now) {
+    if (handoverUntil == 0) {
+        if (now < nextAttach) return;
+        nextAttach = now + ATTACH_RETRY;
+        if (!DaemonRunning()) return;
+        StopServices();
+        handoverUntil = now + HANDOVER_TIMEOUT;
+    }
+
+    if (AttachToDaemon()) {
+        handoverUntil = 0;
+    }
+    else if (now >= handoverUntil) {
+        handoverUntil = 0;
+        StartServices();
+    }
+}
+
+
+// Append one sample of every metric to the history, at most once per second
+void RecordHistory() {
+    time_t now = time(NULL);
+    if (now == lastHistorySample) return;
+    lastHistorySample = now;
+
+    double daemonValues[CPUGPU_MAX_VALUES];
+    int64_t daemonTime = 0;
+    bool fromDaemon = attachedToDaemon && daemonStream.Latest(&daemonTime, daemonValues);
+    if (attachedToDaemon && (!daemonStream.Connected() || daemonStream.SilentFor(now) > DAEMON_TIMEOUT)) {
+        // The daemon stopped or its frames stopped arriving (a frame comes every second, changed or not)
+        DetachFromDaemon(now);
+        fromDaemon = false;
+    }
+    else if (!attachedToDaemon && ATTACH_DAEMON && !apiOpen && SUBSCRIPTION_PIPE[0] != '\0') {
+        RetryAttach(now);
+    }
+    if (servicesStarted) {
+        // Take over the pipe and the dashboard port once a process that held them is gone
+        if (SUBSCRIPTION_PIPE[0] != '\0' && !subscriptions.Running()) subscriptions.Start(SUBSCRIPTION_PIPE);
+        if (DASHBOARD_PORT != 0 && !dashboard.Running()) dashboard.Start(DASHBOARD_PORT);
+    }
+
+    if (!attachedToDaemon) {
+        // The daemon reads the hardware while attached
+        msrBatch.BeginPass();
+        UpdateCpuClocks();
+        cpuThrottle.Update(now, GetPackageProcessors());
+        UpdatePerfCounters();
+        UpdateCStates();
+        msrBatch.EndPass();
+        UpdateMemoryCounters();
+        UpdateDiskCounters();
+        UpdateNetworkCounters();
+        UpdateJobCounters();
+    }
+
+    if (history.empty()) {
+        history.reserve(METRIC_COUNT);
+        for (int i = 0; i < METRIC_COUNT; i++) {
+            history.emplace_back(HISTORY_HOURS * 3600);
+        }
+    }
+    double values[METRIC_COUNT];
+    if (attachedToDaemon) {
+        // The daemon has read the hardware for this second already; nothing is known before its first frame
+        for (int i = 0; i < METRIC_COUNT; i++) values[i] = NAN;
+        for (int i = 0; fromDaemon && i < CPUGPU_VALUE_COUNT; i++) values[SNAPSHOT_METRICS[i]] = daemonValues[i];
+    }
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (!attachedToDaemon) values[i] = SampleMetric(i);
+        history[i].Append(now, values[i]);
+        quantiles[i].Add(now, values[i]);
+        lastValues[i] = values[i];
+    }
+
+    database.Update(now, values);
+    if (now % 60 == 0) database.Flush();
+
+    cpuThermal.Update(now, values[METRIC_CPU_TEMP], values[METRIC_CPU_POWER]);
+    gpuThermal.Update(now, values[METRIC_GPU_TEMP], values[METRIC_GPU_POWER]);
+    cpuFanMonitor.Update(values[METRIC_CPU_FAN_RPM], values[METRIC_CPU_TEMP], values[METRIC_CPU_LOAD]);
+
+    if (subscriptions.Running()) {
+        // Stream the values in the layout of the snapshot API
+        cpugpu_sample sample;
+        FillSnapshot(lastValues, lastHistorySample, &sample);
+        subscriptions.Publish(sample.timestamp, sample.values);
+    }
+
+    if (dashboard.Running()) {
+        // Live update of the browsers showing the dashboard
+        dashboard.Publish(now, values);
+    }
+
+    if (exporter.IsOpen() && now - lastPush >= PUSH_INTERVAL) {
+        // Push to the collector; a sample it cannot take at once is dropped
+        exporter.Push(now, values);
+        lastPush = now;
+    }
+}
+
+
+// Get the GPU temperature at which it starts to slow down, in degrees Celsius. NVML reports the slowdown
+// threshold; for AMD and Intel GPUs a temperature limit sensor of LibreHardwareMonitor is used if the driver
+// reports one, else GPU_TEMP_LIMIT
+int GetGpuTemperatureLimit() {
+    static unsigned int limit = 0;
+
+    if (gpuBackend == GPU_AMD || gpuBackend == GPU_INTEL) {
+        IHardware^ gpu = FindLhmGpu();
+        if (gpu == nullptr) return -1;
+        for each (ISensor ^ sensor in gpu->Sensors) {
+            if (sensor->SensorType == SensorType::Temperature && sensor->Name->Contains("Limit")
+                && sensor->Value.HasValue && sensor->Value.Value > 0) {
+                return (int)sensor->Value.Value;
+            }
+        }
+        return GPU_TEMP_LIMIT;
+    }
+
+    nvmlDevice_t device;
+    if (limit == 0 && nvmlInitialized && nvmlDeviceGetHandleByIndex(0, &device) == NVML_SUCCESS) {
+        if (nvmlDeviceGetTemperatureThreshold(device, NVML_TEMPERATURE_THRESHOLD_SLOWDOWN, &limit) != NVML_SUCCESS) {
+            limit = 0;
+        }
+    }
+    return (limit > 0) ? (int)limit : -1;
+}
+
+
+// Get the CPU temperature at which it starts to throttle (TjMax), in degrees Celsius
+int GetCpuTemperatureLimit() {
+    int limit = cpuThrottle.TemperatureTarget();
+    return (limit > 0) ? limit : CPU_TEMP_LIMIT;
+}
+
+
+// Format the predicted seconds until a thermal limit ("Temp@eta") or a warning glyph when it is close ("Temp@warn")
+void FormatThrottleEta(const ThermalPredictor& predictor, int limit, bool warn, bool showUnits, char* out, size_t outSize) {
+    int seconds = (limit > 0) ? predictor.SecondsToLimit(limit) : ThermalPredictor::UNKNOWN;
+
+    if (warn) {
+        snprintf(out, outSize, (seconds != ThermalPredictor::UNKNOWN && seconds <= THROTTLE_WARNING) ? "!" : " ");
+    }
+    else if (seconds == ThermalPredictor::UNKNOWN) {
+        snprintf(out, outSize, "-");
+    }
+    else {
+        snprintf(out, outSize, showUnits ? "%ds" : "%d", seconds);
+    }
+}
+
+
+// Open the round-robin database of this host next to the plugin DLL
+void OpenDatabase() {
+    char path[MAX_PATH];
+    HMODULE module = NULL;
+    GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+        (LPCSTR)&OpenDatabase, &module);
+    DWORD length = GetModuleFileNameA(module, path, MAX_PATH);
+    while (length > 0 && path[length - 1] != '\\') length--;
+
+    char host[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD hostLength = sizeof(host);
+    if (!GetComputerNameA(host, &hostLength)) strcpy_s(host, "localhost");
+
+    snprintf(path + length, MAX_PATH - length, "CPUGPU_%s.rrd", host);
+
+    // Columns are named by the metric keys, e.g. "cpu.temp", so history survives a change of the metric set
+    static char keys[METRIC_COUNT][RrdFile::NAME_SIZE];
+    const char* names[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        keys[i][FormatMetricKey(i, '.', keys[i])] = '\0';
+        names[i] = keys[i];
+    }
+    database.Open(path, names, METRIC_COUNT);
+}
+
+
+// Parse a history window like "30s", "5m", "1h" or "3d" into seconds; returns 0 if invalid
+long long ParseWindow(const char* text) {
+    char* end;
+    long long amount = strtoll(text, &end, 10);
+    if (end == text || amount <= 0 || end[0] == '\0' || end[1] != '\0') return 0;
+
+    switch (end[0]) {
+    case 's': return amount;
+    case 'm': return amount * 60;
+    case 'h': return amount * 3600;
+    case 'd': return amount * 86400;
+    }
+    return 0;
+}
+
+
+// Result of a history query
+enum QueryStatus {
+    QUERY_OK,
+    QUERY_INVALID,  // Malformed selector
+    QUERY_EMPTY     // No samples in the requested window
+};
+
+
+// Aggregate selector "<avg|min|max><window>", e.g. "max1h"
+QueryStatus QueryAggregate(int metric, const char* selector, double* value) {
+    long long window = (strlen(selector) > 3) ? ParseWindow(selector + 3) : 0;
+    bool isAvg = strncmp(selector, "avg", 3) == 0;
+    bool isMin = strncmp(selector, "min", 3) == 0;
+    bool isMax = strncmp(selector, "max", 3) == 0;
+    if (window == 0 || !(isAvg || isMin || isMax)) return QUERY_INVALID;
+
+    // Use the full-resolution memory history while it covers the window, the database otherwise
+    HistoryAggregate aggregate;
+    time_t now = time(NULL);
+    bool inMemory = !database.IsOpen() ||
+        (history[metric].NewestTimestamp() != 0 && history[metric].OldestTimestamp() <= now - window + 1);
+    bool found = inMemory
+        ? history[metric].Aggregate(now - window + 1, now, &aggregate)
+        : database.Aggregate(metric, now - window + 1, now, &aggregate);
+    if (!found) return QUERY_EMPTY;
+
+    *value = isAvg ? aggregate.sum / aggregate.count : (isMin ? aggregate.min : aggregate.max);
+    return QUERY_OK;
+}
+
+
+// Parse the digits of a percentile selector into a quantile: the first two digits are the percent and any
+// further ones its decimals (p5 -> 0.05, p50 -> 0.5, p999 -> 0.999), p100 is the maximum. Returns -1 if invalid
+double ParsePercentile(const char* digits, size_t digitCount) {
+    if (digitCount >= 3 && strncmp(digits, "100", 3) == 0) {
+        return (strspn(digits + 3, "0") == digitCount - 3) ? 1.0 : -1.0;
+    }
+    double percent = 0.0;
+    double scale = (digitCount == 1) ? 1.0 : 10.0;
+    for (size_t i = 0; i < digitCount; i++) {
+        percent += (digits[i] - '0') * scale;
+        scale /= 10.0;
+    }
+    return percent / 100.0;
+}
+
+
+// Percentile selector "p<digits>[_<window>]", e.g. "p99" since load or "p95_8h" over whole hours
+QueryStatus QueryPercentile(int metric, const char* selector, double* value) {
+    const char* digits = selector + 1;
+    size_t digitCount = strspn(digits, "0123456789");
+    if (digitCount == 0) return QUERY_INVALID;
 
-            for each (ISensor ^ sensor in hardware->Sensors) {
-                if (sensor->SensorType == SensorType::Temperature && sensor->Name == "CPU Package") {
-                    //     
-                    return static_cast<int>(sensor->Value.GetValueOrDefault(0.0f));
-                }
-            }
-        }
+    double q = ParsePercentile(digits, digitCount);
+    if (q < 0.0) return QUERY_INVALID;
+    const char* window = digits + digitCount;
+    bool found;
+    if (window[0] == '\0') {
+        found = quantiles[metric].LifetimeQuantile(q, value);
     }
-    return -1; // Return -1 if the sensor is not found or the value is unavailable
+    else {
+        long long seconds = (window[0] == '_') ? ParseWindow(window + 1) : 0;
+        if (seconds == 0) return QUERY_INVALID;
+        // Hours before the ring were dropped, so a longer window cannot be answered
+        if (seconds > WindowedSketch::WINDOW_HOURS * 3600LL) return QUERY_INVALID;
+        int hours = (int)((seconds + 3599) / 3600);
+        found = quantiles[metric].WindowQuantile(q, time(NULL), hours, value);
+    }
+    return found ? QUERY_OK : QUERY_EMPTY;
 }
 
 
-// Get the current CPU fan speed as a percentage of the maximum speed
-int GetCpuFanSpeed(int fanIndex, int maxFanSpeed) {
-    HardwareMonitor::Initialize();
-    int currentFanIndex = 0;
+// Format a history selector "<param>@<selector>", e.g. "Temp@max1h" or "Power@p99_8h"
+void FormatHistory(MetricGroup group, const char* param1, bool showUnits, char* out, size_t outSize) {
+    const char* selector = strchr(param1, '@');
+    int metric = FindMetric(group, param1, selector - param1);
+    if (metric == METRIC_COUNT) {
+        snprintf(out, outSize, "Invalid parameter");
+        return;
+    }
 
-    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
-        hardware->Update();
-        // Check subcomponents (e.g., additional sensors on the motherboard)
-        for each (IHardware ^ subHardware in hardware->SubHardware) {
-            subHardware->Update();
+    double value = 0;
+    QueryStatus status = (selector[1] == 'p')
+        ? QueryPercentile(metric, selector + 1, &value)
+        : QueryAggregate(metric, selector + 1, &value);
+    if (status == QUERY_INVALID) {
+        snprintf(out, outSize, "Invalid parameter");
+        return;
+    }
+    if (status == QUERY_EMPTY) {
+        snprintf(out, outSize, "No history");
+        return;
+    }
 
-            for each (ISensor ^ subSensor in subHardware->Sensors) {
-                if (subSensor->SensorType == SensorType::Fan) {
-                    if (currentFanIndex == fanIndex) {
-                        float currentSpeed = subSensor->Value.GetValueOrDefault(0.0f);
-                        if (currentSpeed == 0.0f) return 0; // Return 0 if the fan is not spinning.
-                        // Convert speed to percentage
-                        return static_cast<int>((currentSpeed / maxFanSpeed) * 100.0f);
-                    }
-                    currentFanIndex++;
-                }
-            }
-        }
+    const MetricInfo& info = METRICS[metric];
+    snprintf(out, outSize, "%.*f%s", info.decimals, value * info.scale, showUnits ? info.unit : "");
+}
+
+
+// True for CPU params computed from state that only the sampling process keeps: delivered clocks, the
+// busy share of core classes, throttling reasons and time shares, and C-state residency
+bool NeedsLocalSampling(const char* param) {
+    const char* at = strchr(param, '@');
+    if (at == NULL) return false;
+    const char* selector = at + 1;
+    size_t digits = strspn(selector, "0123456789");
+
+    if (strncmp(param, "Clock@", 6) == 0) {
+        return strcmp(selector, "min") == 0 || strcmp(selector, "avg") == 0 || strcmp(selector, "max") == 0 ||
+            strcmp(selector, "busy") == 0 || (digits > 0 && selector[digits] == '\0') ||
+            strcmp(selector, "P") == 0 || strcmp(selector, "E") == 0 ||
+            (strncmp(selector, "pkg", 3) == 0 && selector[3] != '\0' && strspn(selector + 3, "0123456789") == strlen(selector + 3));
     }
-    return -1; // Return -1 if the sensor is not found or the value is unavailable
+    if (strncmp(param, "Load@", 5) == 0) return strcmp(selector, "P") == 0 || strcmp(selector, "E") == 0;
+    if (strcmp(param, "Limit@reason") == 0) return true;
+    if (strncmp(param, "Limit@pct", 9) == 0) return param[9] == '\0' || param[9] == '_';
+    return strncmp(param, "CState@", 7) == 0;
 }
 
 
-// Get the current CPU fan speed in RPM
-int GetCpuFanSpeedRPM(int fanIndex, int maxFanSpeed) {
-    HardwareMonitor::Initialize();
-    int currentFanIndex = 0;
+// Format a param from the values of the daemon while attached to it. Returns false for params answered the
+// same way attached or not: history, predictions, fan health, voltages, top processes and per-package readings
+bool FormatAttached(MetricGroup group, const char* param, bool showUnits, char* out, size_t outSize) {
+    static const char* const DEVICES[] = { "", "CPU", "GPU", "Memory", "Disk", "Network" };
 
-    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
-        hardware->Update();
-        // Check subcomponents (e.g., additional sensors on the motherboard)
-        for each (IHardware ^ subHardware in hardware->SubHardware) {
-            subHardware->Update();
+    const char* at = strchr(param, '@');
+    bool perDevice = (group == GROUP_DISK || group == GROUP_NET) && at != NULL && at[1] != '\0'
+        && strspn(at + 1, "0123456789") == strlen(at + 1);
+    if ((group == GROUP_CPU && NeedsLocalSampling(param)) || perDevice) {
+        // The daemon only streams the values of the snapshot layout
+        snprintf(out, outSize, "N/A");
+        return true;
+    }
+    if (at != NULL) return false;
 
-            for each (ISensor ^ subSensor in subHardware->Sensors) {
-                if (subSensor->SensorType == SensorType::Fan) {
-                    if (currentFanIndex == fanIndex) {
-                        return static_cast<int>(subSensor->Value.GetValueOrDefault(0.0f));
-                    }
-                    currentFanIndex++;
-                }
-            }
-        }
+    int metric = FindMetric(group, param, strlen(param));
+    if (metric == METRIC_COUNT) return false;
+
+    double value = lastValues[metric];
+    if (metric == METRIC_CPU_LIMIT || metric == METRIC_GPU_LIMIT) {
+        // Retrieve symbol '!' if a thermal or power limit is reached
+        if (isnan(value)) snprintf(out, outSize, "Error reading %s Limit", DEVICES[group]);
+        else snprintf(out, outSize, (value != 0) ? "!" : " ");
     }
-    return -1; // Return -1 if the sensor is not found or the value is unavailable
+    else {
+        FormatSample(metric, value, DEVICES[group], showUnits, out, outSize);
+    }
+    return true;
 }
 
 
-// Get the current CPU clock frequency in MHz
-float GetCpuFrequency() {
-    HardwareMonitor::Initialize();
+// Format a param of function 4 or 5: a value of the whole group, of one device ("<name>@<N>") or
+// an aggregate of the history ("<name>@avg1h")
+void FormatIoParam(MetricGroup group, const char* param, bool showUnits, char* out, size_t outSize) {
+    if (attachedToDaemon && FormatAttached(group, param, showUnits, out, outSize)) return;
 
-    for each (IHardware ^ hardware in HardwareMonitor::computer->Hardware) {
-        if (hardware->HardwareType == HardwareType::Cpu) {
-            hardware->Update();
+    const char* device = (group == GROUP_DISK) ? "Disk" : "Network";
+    const char* at = strchr(param, '@');
+    if (at != NULL && (at[1] == '\0' || strspn(at + 1, "0123456789") != strlen(at + 1))) {
+        FormatHistory(group, param, showUnits, out, outSize);
+        return;
+    }
 
-            for each (ISensor ^ sensor in hardware->Sensors) {
-                if (sensor->SensorType == SensorType::Clock && sensor->Name == "CPU Core #1") {
-                    return sensor->Value.GetValueOrDefault(0.0f);
-                }
-            }
-        }
+    int metric = FindMetric(group, param, (at != NULL) ? (size_t)(at - param) : strlen(param));
+    if (metric == METRIC_COUNT) {
+        snprintf(out, outSize, "Invalid parameter");
+        return;
     }
-    return -1;  // Return -1 if the sensor is not found or the value is unavailable
-}
 
+    int number = (at != NULL) ? atoi(at + 1) : -1;
+    double value = (group == GROUP_DISK) ? GetDiskMetric(metric, number) : GetNetMetric(metric, number);
+    FormatSample(metric, value, device, showUnits, out, outSize);
+}
 
 
 /*********************************************************
@@ -224,25 +1805,41 @@ extern "C" DLLEXPORT void __stdcall SmartieInit() {
         MessageBoxA(0, "Administrative privileges required for this plugin", "Error", MB_OK);
     }
 
+    nvmlReturn_t nvmlResult = NVML_SUCCESS;
     if (!nvmlInitialized) {
         // Attempt to initialize NVML (NVIDIA Management Library) for GPU monitoring
-        nvmlReturn_t result = nvmlInit();
-        if (result == NVML_SUCCESS) {
+        nvmlResult = nvmlInit();
+        if (nvmlResult == NVML_SUCCESS) {
             nvmlInitialized = true;
         }
-        else {
-            MessageBoxA(0, nvmlErrorString(result), "NVML Init Failed", MB_OK);
-        }
+    }
+
+    if (!database.IsOpen()) {
+        // Open the persistent sensor history
+        OpenDatabase();
     }
 
     try {
         // Initialize the CPU hardware monitor
         HardwareMonitor::Initialize();
+
+        // Use NVML for the GPU, or LibreHardwareMonitor for other GPUs
+        SelectGpuBackend();
     }
     catch (System::Exception^ ex) {
         MessageBoxA(0, (const char*)(System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(ex->Message)).ToPointer(),
             "Initialization Error", MB_OK);
     }
+
+    if (!ATTACH_DAEMON || SUBSCRIPTION_PIPE[0] == '\0' || !AttachToDaemon()) {
+        // No CPUGPUd daemon samples the hardware and serves the values already
+        StartServices();
+    }
+
+    if (gpuBackend == GPU_NONE && nvmlResult != NVML_SUCCESS) {
+        // Only report the NVML failure when there is no other GPU to show
+        MessageBoxA(0, nvmlErrorString(nvmlResult), "NVML Init Failed", MB_OK);
+    }
 }
 
 /*********************************************************
@@ -255,9 +1852,40 @@ extern "C" DLLEXPORT void __stdcall SmartieFini() {
         // Shut down NVML
         nvmlShutdown();
         nvmlInitialized = false;
-        
-        // Close the hardware monitor
-        HardwareMonitor::Close();
+    }
+
+    // Disconnect from the daemon, the pipe clients, the browsers and the collector
+    bool attached = attachedToDaemon;
+    daemonStream.Disconnect();
+    attachedToDaemon = false;
+    handoverUntil = 0;
+    nextAttach = 0;
+    StopServices();
+    if (daemonMutex != NULL) {
+        CloseHandle(daemonMutex);
+        daemonMutex = NULL;
+    }
+
+    // Flush and close the persistent sensor history
+    database.Close();
+
+    // Release the CPU performance counters for other tools, unless the daemon took them over
+    if (!attached) perfCounters.Stop();
+
+    // Close the hardware monitor, whatever the GPU backend; this also releases the MSR driver
+    HardwareMonitor::Close();
+
+    if (memoryQuery != NULL) {
+        // Close the paging performance counters
+        PdhCloseQuery(memoryQuery);
+        memoryQuery = NULL;
+    }
+
+    // Close the physical drives and the job object
+    CloseDiskCounters();
+    if (jobHandle != NULL) {
+        CloseHandle(jobHandle);
+        jobHandle = NULL;
     }
 }
 
@@ -284,6 +1912,107 @@ extern "C" __declspec(dllexport) char* __stdcall function1(char* param1, char* p
 
     bool showUnits = (strcmp(param2, "1") == 0);
 
+    RecordHistory();
+
+    if (attachedToDaemon && FormatAttached(GROUP_CPU, param1, showUnits, tempStr, sizeof(tempStr))) {
+        // Retrieve the value the daemon sampled
+        return tempStr;
+    }
+
+    if (strcmp(param1, "Temp@eta") == 0 || strcmp(param1, "Temp@warn") == 0) {
+        // Retrieve seconds until the CPU reaches its thermal limit, or a warning glyph
+        FormatThrottleEta(cpuThermal, GetCpuTemperatureLimit(), param1[5] == 'w', showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
+    if (strcmp(param1, "Fan@health") == 0) {
+        // Retrieve CPU fan health compared to its learned normal speed
+        snprintf(tempStr, sizeof(tempStr), "%s", FanMonitor::HealthName(cpuFanMonitor.Health()));
+        return tempStr;
+    }
+
+    if (strcmp(param1, "Fan@expected") == 0) {
+        // Retrieve the normal CPU fan speed in RPM for the current temperature and load
+        double expectedRpm;
+        if (!cpuFanMonitor.ExpectedRpm(&expectedRpm)) {
+            snprintf(tempStr, sizeof(tempStr), "-");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), showUnits ? "%.0fRPM" : "%.0f", expectedRpm);
+        }
+        return tempStr;
+    }
+
+    if (FormatCpuTopology(param1, showUnits, tempStr, sizeof(tempStr))) {
+        // Retrieve load, power, temperature or clock of one package, or load and clock of P- or E-cores
+        return tempStr;
+    }
+
+    if (strncmp(param1, "Clock@", 6) == 0 && FormatCpuClock(param1 + 6, showUnits, tempStr, sizeof(tempStr))) {
+        // Retrieve delivered CPU clocks: minimum, average, maximum, busy-weighted or per logical processor
+        return tempStr;
+    }
+
+    if (strcmp(param1, "Limit@reason") == 0) {
+        // Retrieve the most severe active CPU throttling reason: PROCHOT, Thermal, PL2, PL1 or EDP
+        snprintf(tempStr, sizeof(tempStr), "%s", cpuThrottle.Valid() ? cpuThrottle.ActiveReason() : "N/A");
+        return tempStr;
+    }
+
+    if (strncmp(param1, "Limit@pct", 9) == 0 && (param1[9] == '\0' || param1[9] == '_')) {
+        // Retrieve the share of time the CPU was throttled, for any reason or for one, e.g. "Limit@pct_PL1"
+        int reason = CpuThrottle::FindReason(param1[9] == '_' ? param1 + 10 : "");
+        if (reason == THROTTLE_REASON_COUNT) {
+            snprintf(tempStr, sizeof(tempStr), "Invalid parameter");
+        }
+        else if (!cpuThrottle.Valid()) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading CPU Limit");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), showUnits ? "%.1f%%" : "%.1f", cpuThrottle.Percent(reason));
+        }
+        return tempStr;
+    }
+
+    if (strncmp(param1, "Top@", 4) == 0) {
+        // Retrieve the name, CPU usage or memory of a top CPU consumer, e.g. "Top@1" or "Top@1_cpu"
+        FormatTopProcess(param1 + 4, false, showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
+    if (strncmp(param1, "Volt@", 5) == 0) {
+        // Retrieve a motherboard or CPU voltage by canonical name or chip label, e.g. "Volt@VCore" or "Volt@12V"
+        double volts = GetVoltage(param1 + 5);
+        if (isnan(volts)) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading %s", param1);
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), showUnits ? "%.3fV" : "%.3f", volts);
+        }
+        return tempStr;
+    }
+
+    if (strncmp(param1, "CState@", 7) == 0) {
+        // Retrieve the residency in % of a core (C3, C6, C7) or package (PC2 to PC10) idle state
+        int state = CStateResidency::FindState(param1 + 7);
+        if (state < 0) {
+            snprintf(tempStr, sizeof(tempStr), "Invalid parameter");
+        }
+        else if (!cStates.Valid() || !cStates.Available(state)) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading C-states");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), showUnits ? "%.1f%%" : "%.1f", cStates.Residency(state));
+        }
+        return tempStr;
+    }
+
+    if (strchr(param1, '@') != NULL) {
+        // Retrieve an aggregate of the CPU sensor history
+        FormatHistory(GROUP_CPU, param1, showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
     if (strcmp(param1, "Load") == 0) {
         // Retrieve CPU load percentage
         int load = GetCpuLoad();
@@ -357,6 +2086,50 @@ extern "C" __declspec(dllexport) char* __stdcall function1(char* param1, char* p
         return tempStr;
     }
 
+    else if (strcmp(param1, "IPC") == 0) {
+        // Retrieve instructions per cycle over all logical processors
+        if (!perfCounters.Valid()) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading CPU counters");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), "%.2f", perfCounters.Ipc());
+        }
+        return tempStr;
+    }
+
+    else if (strcmp(param1, "LLC_Miss") == 0) {
+        // Retrieve the share of last-level cache references that missed
+        if (!perfCounters.Valid()) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading CPU counters");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), showUnits ? "%.1f%%" : "%.1f", perfCounters.LlcMissRate());
+        }
+        return tempStr;
+    }
+
+    else if (strcmp(param1, "Instr") == 0) {
+        // Retrieve billions of instructions retired per second over all logical processors
+        if (!perfCounters.Valid()) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading CPU counters");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), showUnits ? "%.2fG/s" : "%.2f", perfCounters.InstructionsPerSecond() / 1e9);
+        }
+        return tempStr;
+    }
+
+    else if (strcmp(param1, "Limit") == 0) {
+        // Retrieve symbol '!' if the CPU is throttled by a thermal or power limit
+        if (!cpuThrottle.Valid()) {
+            snprintf(tempStr, sizeof(tempStr), "Error reading CPU Limit");
+        }
+        else {
+            snprintf(tempStr, sizeof(tempStr), cpuThrottle.Throttling() ? "!" : " ");
+        }
+        return tempStr;
+    }
+
     snprintf(tempStr, sizeof(tempStr), "Invalid parameter");
     return tempStr;
 }
@@ -374,6 +2147,28 @@ extern "C" DLLEXPORT char* __stdcall function2(char* param1, char* param2) {
     static char tempStr[256];
     memset(tempStr, 0, sizeof(tempStr));
 
+    RecordHistory();
+
+    if (attachedToDaemon && FormatAttached(GROUP_GPU, param1, strcmp(param2, "1") == 0, tempStr, sizeof(tempStr))) {
+        // Retrieve the value the daemon sampled
+        return tempStr;
+    }
+
+    if (gpuBackend == GPU_AMD || gpuBackend == GPU_INTEL) {
+        // GPUs without NVML are read through LibreHardwareMonitor
+        bool showUnits = (strcmp(param2, "1") == 0);
+        if (strcmp(param1, "Temp@eta") == 0 || strcmp(param1, "Temp@warn") == 0) {
+            FormatThrottleEta(gpuThermal, GetGpuTemperatureLimit(), param1[5] == 'w', showUnits, tempStr, sizeof(tempStr));
+        }
+        else if (strchr(param1, '@') != NULL) {
+            FormatHistory(GROUP_GPU, param1, showUnits, tempStr, sizeof(tempStr));
+        }
+        else {
+            FormatLhmGpu(param1, showUnits, tempStr, sizeof(tempStr));
+        }
+        return tempStr;
+    }
+
     if (!checkNvmlInitialized(tempStr, sizeof(tempStr))) {
         // Return an error message if NVML is not initialized
         return tempStr;
@@ -389,6 +2184,18 @@ extern "C" DLLEXPORT char* __stdcall function2(char* param1, char* param2) {
 
     bool showUnits = (strcmp(param2, "1") == 0);
 
+    if (strcmp(param1, "Temp@eta") == 0 || strcmp(param1, "Temp@warn") == 0) {
+        // Retrieve seconds until the GPU reaches its slowdown temperature, or a warning glyph
+        FormatThrottleEta(gpuThermal, GetGpuTemperatureLimit(), param1[5] == 'w', showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
+    if (strchr(param1, '@') != NULL) {
+        // Retrieve an aggregate of the GPU sensor history
+        FormatHistory(GROUP_GPU, param1, showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
     if (strcmp(param1, "Temp") == 0) {
         // Retrieve GPU temperature
         unsigned int temp;
@@ -513,3 +2320,142 @@ extern "C" DLLEXPORT char* __stdcall function2(char* param1, char* param2) {
     snprintf(tempStr, sizeof(tempStr), "Invalid parameter");
     return tempStr;
 }
+
+
+/*********************************************************
+ *         Function 3                                    *
+ *  Returns system memory data                           *
+ *********************************************************/
+ // Function to retrieve host RAM, page file and page fault data
+ // based on the parameter provided by the user
+
+extern "C" DLLEXPORT char* __stdcall function3(char* param1, char* param2) {
+    static char tempStr[256];
+    memset(tempStr, 0, sizeof(tempStr));
+
+    bool showUnits = (strcmp(param2, "1") == 0);
+
+    RecordHistory();
+
+    if (strncmp(param1, "Top@", 4) == 0) {
+        // Retrieve the name, memory or CPU usage of a top memory consumer, e.g. "Top@1" or "Top@1_mem"
+        FormatTopProcess(param1 + 4, true, showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
+    if (strchr(param1, '@') != NULL) {
+        // Retrieve an aggregate of the memory history
+        FormatHistory(GROUP_MEM, param1, showUnits, tempStr, sizeof(tempStr));
+        return tempStr;
+    }
+
+    int metric = FindMetric(GROUP_MEM, param1, strlen(param1));
+    if (metric == METRIC_COUNT) {
+        snprintf(tempStr, sizeof(tempStr), "Invalid parameter");
+        return tempStr;
+    }
+
+    // Retrieve RAM used, available, usage or cache, page file use, or hard page faults per second,
+    // as the daemon sampled them while attached
+    double value = attachedToDaemon ? lastValues[metric] : SampleMetric(metric);
+    FormatSample(metric, value, "Memory", showUnits, tempStr, sizeof(tempStr));
+    return tempStr;
+}
+
+
+/*********************************************************
+ *         Function 4                                    *
+ *  Returns disk I/O data                                *
+ *********************************************************/
+ // Function to retrieve read/write throughput, operations and utilization of all physical drives
+ // or of one drive ("Read@1" for \\.\PhysicalDrive1) based on the parameter provided by the user
+
+extern "C" DLLEXPORT char* __stdcall function4(char* param1, char* param2) {
+    static char tempStr[256];
+    memset(tempStr, 0, sizeof(tempStr));
+
+    bool showUnits = (strcmp(param2, "1") == 0);
+
+    RecordHistory();
+
+    FormatIoParam(GROUP_DISK, param1, showUnits, tempStr, sizeof(tempStr));
+    return tempStr;
+}
+
+
+/*********************************************************
+ *         Function 5                                    *
+ *  Returns network data                                 *
+ *********************************************************/
+ // Function to retrieve received/sent throughput of all connected network interfaces
+ // or of one interface ("Rx@0") based on the parameter provided by the user
+
+extern "C" DLLEXPORT char* __stdcall function5(char* param1, char* param2) {
+    static char tempStr[256];
+    memset(tempStr, 0, sizeof(tempStr));
+
+    bool showUnits = (strcmp(param2, "1") == 0);
+
+    RecordHistory();
+
+    FormatIoParam(GROUP_NET, param1, showUnits, tempStr, sizeof(tempStr));
+    return tempStr;
+}
+
+
+/*********************************************************
+ *         Snapshot API                                  *
+ *  Returns raw readings to other programs               *
+ *********************************************************/
+ // C interface declared in SnapshotApi.h. The readings are the history samples, taken at most once per second
+
+extern "C" DLLEXPORT int __stdcall cpugpu_open(uint32_t version) {
+    if (version != CPUGPU_API_VERSION) return CPUGPU_ERROR_VERSION;
+
+    // Same backends as SmartieInit, without its message boxes and without the persistent history
+    if (!nvmlInitialized && nvmlInit() == NVML_SUCCESS) {
+        nvmlInitialized = true;
+    }
+    try {
+        HardwareMonitor::Initialize();
+        SelectGpuBackend();
+    }
+    catch (System::Exception^) {
+        // Leave nothing running for a caller that gives up or retries
+        HardwareMonitor::Close();
+        if (nvmlInitialized) {
+            nvmlShutdown();
+            nvmlInitialized = false;
+        }
+        return CPUGPU_ERROR_INIT;
+    }
+    apiOpen = true;
+    return CPUGPU_OK;
+}
+
+
+extern "C" DLLEXPORT int __stdcall cpugpu_snapshot(cpugpu_sample* sample) {
+    if (!apiOpen) return CPUGPU_ERROR_CLOSED;
+    if (sample == NULL || sample->size < sizeof(cpugpu_sample)) return CPUGPU_ERROR_SIZE;
+
+    RecordHistory();
+
+    FillSnapshot(lastValues, lastHistorySample, sample);
+    return CPUGPU_OK;
+}
+
+
+extern "C" DLLEXPORT int __stdcall cpugpu_serve() {
+    if (!apiOpen) return CPUGPU_ERROR_CLOSED;
+    // Tell a running plugin to hand the pipe over; services that are still held are taken over by later snapshots
+    if (daemonMutex == NULL) daemonMutex = CreateMutexA(NULL, FALSE, DAEMON_MUTEX);
+    StartServices();
+    return CPUGPU_OK;
+}
+
+
+extern "C" DLLEXPORT void __stdcall cpugpu_close() {
+    if (!apiOpen) return;
+    apiOpen = false;
+    SmartieFini();
+}
@@ -0,0 +1,137 @@
+// CPUGPUd: headless daemon of the CPUGPU plugin.
+// It loads CPUGPU.dll from its own directory and runs the sampler without LCDSmartie: the values are
+// read once per second and served through the subscription pipe, web dashboard and collector push
+// configured in CPUGPU.cpp. A CPUGPU plugin loaded by LCDSmartie finds the pipe and takes its samples
+// from the daemon instead of reading the hardware a second time.
+//
+// Usage: CPUGPUd             Run in the console until Ctrl+C
+//        CPUGPUd --service   Run as a Windows service, registered e.g. with
+//                            sc create CPUGPUd binPath= "C:\CPUGPU\CPUGPUd.exe --service" start= auto
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SnapshotApi.h"
+
+
+typedef int (__stdcall *OpenFunction)(uint32_t version);
+typedef int (__stdcall *SnapshotFunction)(cpugpu_sample* sample);
+typedef int (__stdcall *ServeFunction)();
+typedef void (__stdcall *CloseFunction)();
+
+static const char SERVICE_NAME[] = "CPUGPUd";
+
+static HANDLE stopEvent = NULL;
+static HANDLE doneEvent = NULL;         // Set once Run has closed the sampler
+static SERVICE_STATUS_HANDLE serviceHandle = NULL;
+static SERVICE_STATUS serviceStatus = {};
+
+
+// Sample and serve until 'stopEvent' is set; returns the process exit code
+int Run() {
+    // CPUGPU.dll and LibreHardwareMonitorLib.dll are expected next to the executable
+    char path[MAX_PATH];
+    DWORD length = GetModuleFileNameA(NULL, path, MAX_PATH);
+    while (length > 0 && path[length - 1] != '\\') length--;
+    snprintf(path + length, MAX_PATH - length, "CPUGPU.dll");
+
+    HMODULE core = LoadLibraryA(path);
+    if (core == NULL) {
+        fprintf(stderr, "Cannot load %s (error %lu)\n", path, GetLastError());
+        return 1;
+    }
+    OpenFunction open = (OpenFunction)GetProcAddress(core, "cpugpu_open");
+    SnapshotFunction snapshot = (SnapshotFunction)GetProcAddress(core, "cpugpu_snapshot");
+    ServeFunction serve = (ServeFunction)GetProcAddress(core, "cpugpu_serve");
+    CloseFunction close = (CloseFunction)GetProcAddress(core, "cpugpu_close");
+    if (open == NULL || snapshot == NULL || serve == NULL || close == NULL) {
+        fprintf(stderr, "%s does not export the snapshot API\n", path);
+        FreeLibrary(core);
+        return 1;
+    }
+
+    int result = open(CPUGPU_API_VERSION);
+    if (result == CPUGPU_OK) result = serve();
+    if (result != CPUGPU_OK) {
+        fprintf(stderr, "Cannot start the sampler (error %d)\n", result);
+        close();
+        FreeLibrary(core);
+        return 1;
+    }
+
+    // Sample shortly after every second boundary, the sampler takes one sample per second of Unix time
+    cpugpu_sample sample;
+    sample.size = sizeof(sample);
+    DWORD wait = 0;
+    while (WaitForSingleObject(stopEvent, wait) == WAIT_TIMEOUT) {
+        snapshot(&sample);
+        SYSTEMTIME now;
+        GetSystemTime(&now);
+        wait = 1010 - now.wMilliseconds;
+    }
+
+    close();
+    FreeLibrary(core);
+    return 0;
+}
+
+
+BOOL WINAPI ConsoleHandler(DWORD type) {
+    SetEvent(stopEvent);
+    if (type == CTRL_CLOSE_EVENT || type == CTRL_LOGOFF_EVENT || type == CTRL_SHUTDOWN_EVENT) {
+        // The process is terminated as soon as the handler returns, so the sampler has to be closed first
+        WaitForSingleObject(doneEvent, INFINITE);
+    }
+    return TRUE;
+}
+
+
+void ReportServiceState(DWORD state, DWORD exitCode, DWORD serviceExitCode = 0) {
+    serviceStatus.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
+    serviceStatus.dwCurrentState = state;
+    serviceStatus.dwControlsAccepted = (state == SERVICE_RUNNING) ? SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN : 0;
+    serviceStatus.dwWin32ExitCode = exitCode;
+    serviceStatus.dwServiceSpecificExitCode = serviceExitCode;   // Read when exitCode is ERROR_SERVICE_SPECIFIC_ERROR
+    serviceStatus.dwWaitHint = (state == SERVICE_RUNNING || state == SERVICE_STOPPED) ? 0 : 3000;
+    SetServiceStatus(serviceHandle, &serviceStatus);
+}
+
+
+DWORD WINAPI ServiceHandler(DWORD control, DWORD type, LPVOID data, LPVOID context) {
+    (void)type; (void)data; (void)context;
+    if (control == SERVICE_CONTROL_STOP || control == SERVICE_CONTROL_SHUTDOWN) {
+        ReportServiceState(SERVICE_STOP_PENDING, NO_ERROR);
+        SetEvent(stopEvent);
+        return NO_ERROR;
+    }
+    return (control == SERVICE_CONTROL_INTERROGATE) ? NO_ERROR : ERROR_CALL_NOT_IMPLEMENTED;
+}
+
+
+void WINAPI ServiceMain(DWORD argc, LPSTR* argv) {
+    (void)argc; (void)argv;
+    serviceHandle = RegisterServiceCtrlHandlerExA(SERVICE_NAME, ServiceHandler, NULL);
+    if (serviceHandle == NULL) return;
+    ReportServiceState(SERVICE_RUNNING, NO_ERROR);
+    int exitCode = Run();
+    ReportServiceState(SERVICE_STOPPED, exitCode == 0 ? NO_ERROR : ERROR_SERVICE_SPECIFIC_ERROR, exitCode);
+}
+
+
+int main(int argc, char** argv) {
+    stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    doneEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    if (argc > 1 && strcmp(argv[1], "--service") == 0) {
+        SERVICE_TABLE_ENTRYA services[] = { { (LPSTR)SERVICE_NAME, ServiceMain }, { NULL, NULL } };
+        return StartServiceCtrlDispatcherA(services) ? 0 : 1;
+    }
+
+    SetConsoleCtrlHandler(ConsoleHandler, TRUE);
+    printf("CPUGPUd is sampling, press Ctrl+C to stop\n");
+    int exitCode = Run();
+    SetEvent(doneEvent);
+    return exitCode;
+}
@@ -0,0 +1,101 @@
+// C-state residency, see CState.h
+
+#include "CState.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+// Residency counter of each CState, core states first
+static const uint32_t RESIDENCY_MSRS[CSTATE_COUNT] = {
+    0x3FC, 0x3FD, 0x3FE,                        // MSR_CORE_C3/C6/C7_RESIDENCY
+    0x60D, 0x3F8, 0x3F9, 0x3FA, 0x630, 0x631, 0x632 // MSR_PKG_C2/C3/C6/C7/C8/C9/C10_RESIDENCY
+};
+
+static const char* const STATE_NAMES[CSTATE_COUNT] = { "C3", "C6", "C7", "PC2", "PC3", "PC6", "PC7", "PC8", "PC9", "PC10" };
+
+
+const char* CStateResidency::StateName(int state) {
+    return (state >= 0 && state < CSTATE_COUNT) ? STATE_NAMES[state] : "";
+}
+
+
+int CStateResidency::FindState(const char* name) {
+    for (int i = 0; i < CSTATE_COUNT; i++) {
+        if (strcmp(STATE_NAMES[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+
+// Find out which residency counters exist by reading each one on the first processor
+bool CStateResidency::Probe() {
+    probed = true;
+    coreIndices.assign(1, MSR_TIME_STAMP_COUNTER);
+    coreStates.clear();
+    packageStates.clear();
+    for (int i = 0; i < CSTATE_COUNT; i++) {
+        uint64_t value;
+        available[i] = reader->Read(0, &RESIDENCY_MSRS[i], 1, &value);
+        if (!available[i]) continue;
+        if (i < CSTATE_PC2) coreStates.push_back(i);
+        else packageStates.push_back(i);
+    }
+
+    for (size_t i = 0; i < coreStates.size(); i++) coreIndices.push_back(RESIDENCY_MSRS[coreStates[i]]);
+    packageIndices = coreIndices;
+    for (size_t i = 0; i < packageStates.size(); i++) packageIndices.push_back(RESIDENCY_MSRS[packageStates[i]]);
+    return !coreStates.empty() || !packageStates.empty();
+}
+
+
+bool CStateResidency::Update(const std::vector<int>& packageProcessors) {
+    int count = reader ? reader->ProcessorCount() : 0;
+    if (count <= 0 || (!probed && !Probe()) || (coreStates.empty() && packageStates.empty())) {
+        valid = false;
+        return false;
+    }
+    if (static_cast<int>(previous.size()) != count || packageProcessors != lastPackages) {
+        previous.assign(count, std::vector<uint64_t>());
+        lastPackages = packageProcessors;
+        primed = false;
+    }
+
+    double coreTsc = 0.0;
+    double packageTsc = 0.0;
+    double sums[CSTATE_COUNT] = {};
+    std::vector<uint64_t> values(packageIndices.size());
+    for (int i = 0; i < count; i++) {
+        bool isPackage = std::find(packageProcessors.begin(), packageProcessors.end(), i) != packageProcessors.end();
+        const std::vector<uint32_t>& indices = isPackage ? packageIndices : coreIndices;
+        if (!reader->Read(i, indices.data(), static_cast<int>(indices.size()), values.data())) {
+            valid = false;
+            primed = false;
+            return false;
+        }
+
+        std::vector<uint64_t>& last = previous[i];
+        if (primed && last.size() == indices.size() && values[0] > last[0]) {
+            double tsc = static_cast<double>(values[0] - last[0]);
+            coreTsc += tsc;
+            if (isPackage) packageTsc += tsc;
+            // Counters that went backwards were reset, e.g. on resume; count the interval as not resident
+            for (size_t j = 1; j < indices.size(); j++) {
+                int state = (j <= coreStates.size()) ? coreStates[j - 1] : packageStates[j - 1 - coreStates.size()];
+                if (values[j] >= last[j]) sums[state] += static_cast<double>(values[j] - last[j]);
+            }
+        }
+        last.assign(values.begin(), values.begin() + indices.size());
+    }
+
+    if (primed) {
+        for (int state = 0; state < CSTATE_COUNT; state++) {
+            double tsc = (state < CSTATE_PC2) ? coreTsc : packageTsc;
+            double percent = (tsc > 0.0) ? 100.0 * sums[state] / tsc : 0.0;
+            residency[state] = std::min(percent, 100.0);
+        }
+    }
+    valid = primed;
+    primed = true;
+    return true;
+}
@@ -0,0 +1,61 @@
+// Core and package C-state residency: the share of time processors spent in each idle state.
+// Residency counters tick at the TSC rate while in their state, so the residency over an interval
+// is the counter delta divided by the TSC delta. Core states are averaged over all logical
+// processors, package states over one processor of each package. States whose register does not
+// exist on the CPU are probed once and then skipped.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Msr.h"
+
+
+enum CState {
+    CSTATE_C3,
+    CSTATE_C6,
+    CSTATE_C7,
+    CSTATE_PC2,
+    CSTATE_PC3,
+    CSTATE_PC6,
+    CSTATE_PC7,
+    CSTATE_PC8,
+    CSTATE_PC9,
+    CSTATE_PC10,
+    CSTATE_COUNT
+};
+
+
+class CStateResidency {
+public:
+    explicit CStateResidency(MsrReader* reader) : reader(reader) {}
+
+    // Sample the core counters of all logical processors and the package counters of 'packageProcessors'
+    // (one logical processor per package); returns false if no residency counter can be read
+    bool Update(const std::vector<int>& packageProcessors);
+
+    bool Valid() const { return valid; }
+    bool Available(int state) const { return available[state]; }
+    double Residency(int state) const { return residency[state]; }     // Percent of the interval
+
+    static const char* StateName(int state);
+    // Find a state by name, e.g. "C6" or "PC6"; returns -1 if unknown
+    static int FindState(const char* name);
+
+private:
+    bool Probe();
+
+    MsrReader* reader;
+    bool probed = false;
+    bool valid = false;
+    bool primed = false;
+    bool available[CSTATE_COUNT] = {};
+    double residency[CSTATE_COUNT] = {};
+    std::vector<uint32_t> coreIndices;          // TSC followed by the available core state counters
+    std::vector<uint32_t> packageIndices;       // ... followed by the available package state counters
+    std::vector<int> coreStates;                // CState of each counter after the TSC
+    std::vector<int> packageStates;
+    std::vector<std::vector<uint64_t>> previous;    // Last values per logical processor
+    std::vector<int> lastPackages;
+};
@@ -0,0 +1,274 @@
+// cpugpu-top: console viewer of the CPUGPU values for computers without an LCD.
+// It subscribes to the stream of the plugin or of the CPUGPUd daemon (see SubscriptionServer.h) and shows
+// every metric of the registry in Metrics.h with its current value and a sparkline of the last seconds.
+// Once per second the screen is compared with what is already shown and only the changed characters are
+// rewritten, so a refresh usually costs a few dozen bytes and stays cheap over SSH. A terminal too low for
+// one column gets two, and one too small for that scrolls. When frames stop arriving, the last values are
+// shown in parentheses and the header tells for how long.
+//
+// Usage: cpugpu-top [name]   Subscribe to the pipe (Windows) or Unix socket 'name', CPUGPU by default.
+//                            Arrows, PageUp/PageDown, Home and End scroll; q or Ctrl+C quits.
+
+#include <ctype.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include "Metrics.h"
+#include "SubscriptionServer.h"
+#include "TopScreen.h"
+
+
+static const char DEFAULT_NAME[] = "CPUGPU";
+static const int TICK_WAIT = 200;       // Milliseconds between checks for a new second or a key
+static const int STALE_AFTER = 2;       // Seconds without a frame after which the values are shown as stale
+
+// Keys other than characters returned by WaitKey
+enum Key {
+    KEY_NONE = 0,
+    KEY_UP = 256,
+    KEY_DOWN,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+    KEY_HOME,
+    KEY_END
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+
+#ifdef _WIN32
+
+static HANDLE input = NULL;
+static DWORD inputMode = 0;
+static DWORD outputMode = 0;
+
+
+BOOL WINAPI ConsoleHandler(DWORD type) {
+    (void)type;
+    stopRequested = 1;
+    return TRUE;
+}
+
+
+bool OpenTerminal() {
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    input = GetStdHandle(STD_INPUT_HANDLE);
+    // Escape sequences need a console with virtual terminal processing (Windows 10 and later)
+    if (!GetConsoleMode(output, &outputMode) ||
+        !SetConsoleMode(output, outputMode | ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+        return false;
+    }
+    GetConsoleMode(input, &inputMode);
+    SetConsoleMode(input, inputMode & ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT));
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCtrlHandler(ConsoleHandler, TRUE);
+    return true;
+}
+
+
+void CloseTerminal() {
+    SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), outputMode);
+    SetConsoleMode(input, inputMode);
+}
+
+
+void TerminalSize(int* width, int* height) {
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        *width = info.srWindow.Right - info.srWindow.Left + 1;
+        *height = info.srWindow.Bottom - info.srWindow.Top + 1;
+    }
+}
+
+
+// Wait up to 'milliseconds' for a key; returns its character or Key, or KEY_NONE if none was pressed
+int WaitKey(int milliseconds) {
+    INPUT_RECORD record;
+    DWORD count;
+    if (WaitForSingleObject(input, milliseconds) != WAIT_OBJECT_0 || !ReadConsoleInputA(input, &record, 1, &count) ||
+        count != 1 || record.EventType != KEY_EVENT || !record.Event.KeyEvent.bKeyDown) {
+        return KEY_NONE;
+    }
+    if (record.Event.KeyEvent.uChar.AsciiChar != 0) return static_cast<unsigned char>(record.Event.KeyEvent.uChar.AsciiChar);
+    switch (record.Event.KeyEvent.wVirtualKeyCode) {
+    case VK_UP:    return KEY_UP;
+    case VK_DOWN:  return KEY_DOWN;
+    case VK_PRIOR: return KEY_PAGE_UP;
+    case VK_NEXT:  return KEY_PAGE_DOWN;
+    case VK_HOME:  return KEY_HOME;
+    case VK_END:   return KEY_END;
+    default:       return KEY_NONE;
+    }
+}
+
+#else
+
+static struct termios savedTerminal;
+static bool terminalSaved = false;
+
+
+void SignalHandler(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+
+bool OpenTerminal() {
+    if (!isatty(STDOUT_FILENO)) return false;
+    if (tcgetattr(STDIN_FILENO, &savedTerminal) == 0) {
+        // Keys are read one by one without echo
+        struct termios raw = savedTerminal;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        terminalSaved = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+    signal(SIGINT, SignalHandler);
+    signal(SIGTERM, SignalHandler);
+    signal(SIGHUP, SignalHandler);
+    return true;
+}
+
+
+void CloseTerminal() {
+    if (terminalSaved) tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+}
+
+
+void TerminalSize(int* width, int* height) {
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0) {
+        *width = size.ws_col;
+        *height = size.ws_row;
+    }
+}
+
+
+// Wait up to 'milliseconds' for a key; returns its character or Key, or KEY_NONE if none was pressed
+int WaitKey(int milliseconds) {
+    struct pollfd descriptor = { STDIN_FILENO, POLLIN, 0 };
+    char key = 0;
+    if (poll(&descriptor, 1, milliseconds) != 1 || read(STDIN_FILENO, &key, 1) != 1) return KEY_NONE;
+    if (key != '\x1b') return static_cast<unsigned char>(key);
+
+    // Cursor keys arrive as escape sequences: ESC [ A (or ESC O A) for the arrows, Home and End, ESC [ 5 ~ for the pages
+    char sequence[4] = {};
+    int length = 0;
+    while (length < 3 && poll(&descriptor, 1, 10) == 1 && read(STDIN_FILENO, &sequence[length], 1) == 1) {
+        if (length++ > 0 && !isdigit(static_cast<unsigned char>(sequence[length - 1]))) break;
+    }
+    if (length < 2 || (sequence[0] != '[' && sequence[0] != 'O')) return KEY_NONE;
+    switch (sequence[1]) {
+    case 'A': return KEY_UP;
+    case 'B': return KEY_DOWN;
+    case 'H': return KEY_HOME;
+    case 'F': return KEY_END;
+    case '1': case '7': return (sequence[2] == '~') ? KEY_HOME : KEY_NONE;
+    case '4': case '8': return (sequence[2] == '~') ? KEY_END : KEY_NONE;
+    case '5': return (sequence[2] == '~') ? KEY_PAGE_UP : KEY_NONE;
+    case '6': return (sequence[2] == '~') ? KEY_PAGE_DOWN : KEY_NONE;
+    default:  return KEY_NONE;
+    }
+}
+
+#endif
+
+
+int main(int argc, char** argv) {
+    const char* name = (argc > 1) ? argv[1] : DEFAULT_NAME;
+
+    SubscriptionClient stream;
+    if (!stream.Connect(name, ~0ull)) {
+        fprintf(stderr, "Cannot connect to %s: neither LCDSmartie with the CPUGPU plugin nor CPUGPUd serves it\n", name);
+        return 1;
+    }
+    if (!OpenTerminal()) {
+        fprintf(stderr, "cpugpu-top needs a terminal that understands escape sequences\n");
+        return 1;
+    }
+
+    std::string out;
+    out.reserve(64 * 1024);
+    out.append("\x1b[?1049h\x1b[?25l");     // Alternate screen, hidden cursor
+
+    Screen screen;
+    MetricHistory history;
+    time_t lastTick = 0;
+    int staleSeconds = 0;
+    int scroll = 0;
+    int height = 24;
+    bool redraw = false;
+    int64_t timestamp = 0;
+    double streamValues[FRAME_MAX_VALUES];
+    double values[METRIC_COUNT];
+    double shown[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) shown[i] = NAN;
+
+    while (!stopRequested && stream.Connected()) {
+        time_t now = time(NULL);
+        if (now != lastTick) {
+            // Unchanged values are not sent, so the latest frame holds the readings of this second. Every tick
+            // brings a frame, so a frame older than STALE_AFTER means the sampler stopped or hangs
+            lastTick = now;
+            if (stream.Latest(&timestamp, streamValues)) {
+                for (int i = 0; i < SNAPSHOT_VALUE_COUNT; i++) shown[SNAPSHOT_METRICS[i]] = streamValues[i];
+            }
+            int64_t age = stream.SilentFor(now);
+            staleSeconds = (age > STALE_AFTER) ? static_cast<int>(age) : 0;
+            for (int i = 0; i < METRIC_COUNT; i++) values[i] = (staleSeconds > 0) ? NAN : shown[i];
+            history.Append(values);
+            redraw = true;
+        }
+
+        if (redraw) {
+            int width = 80;
+            height = 24;
+            TerminalSize(&width, &height);
+            if (!screen.SameSize(width, height)) screen.Reset(width, height, &out);
+            screen.Draw(Layout(name, now, staleSeconds, history, shown, width, height, &scroll), &out);
+            if (!out.empty()) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                fflush(stdout);
+                out.clear();
+            }
+            redraw = false;
+        }
+
+        int key = WaitKey(TICK_WAIT);
+        if (key == 'q' || key == 'Q') break;
+        int page = (height > 2) ? height - 2 : 1;
+        switch (key) {
+        case KEY_UP:        scroll--; break;
+        case KEY_DOWN:      scroll++; break;
+        case KEY_PAGE_UP:   scroll -= page; break;
+        case KEY_PAGE_DOWN: scroll += page; break;
+        case KEY_HOME:      scroll = 0; break;
+        case KEY_END:       scroll = METRIC_COUNT * 2; break;   // Clamped to the last page by Layout
+        default:            continue;
+        }
+        redraw = true;
+    }
+
+    out.append("\x1b[?25h\x1b[?1049l");     // Back to the normal screen
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    CloseTerminal();
+
+    if (!stopRequested && !stream.Connected()) {
+        fprintf(stderr, "%s stopped serving\n", name);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// CPU throttling status, see CpuThrottle.h
+
+#include "CpuThrottle.h"
+
+#include <string.h>
+
+
+static const uint32_t MSR_PACKAGE_THERM_STATUS = 0x1B1;
+static const uint32_t MSR_CORE_PERF_LIMIT_REASONS = 0x64F;
+static const uint32_t MSR_TEMPERATURE_TARGET = 0x1A2;
+
+// IA32_PACKAGE_THERM_STATUS status bits
+static const uint64_t PACKAGE_THERMAL_STATUS = 1ull << 0;
+static const uint64_t PACKAGE_PROCHOT = 1ull << 2;
+static const uint64_t PACKAGE_POWER_LIMIT = 1ull << 10;
+
+// MSR_CORE_PERF_LIMIT_REASONS status bits
+static const uint64_t LIMIT_PROCHOT = 1ull << 0;
+static const uint64_t LIMIT_THERMAL = 1ull << 1;
+static const uint64_t LIMIT_VR_THERMAL = 1ull << 6;
+static const uint64_t LIMIT_VR_CURRENT = 1ull << 7;
+static const uint64_t LIMIT_EDP = 1ull << 8;
+static const uint64_t LIMIT_PL1 = 1ull << 10;
+static const uint64_t LIMIT_PL2 = 1ull << 11;
+
+// IA32_TEMPERATURE_TARGET: TjMax in bits 23:16
+static const int TEMPERATURE_TARGET_SHIFT = 16;
+static const uint64_t TEMPERATURE_TARGET_MASK = 0xFF;
+
+static const int64_t MAX_INTERVAL = 5;  // Longer gaps between updates are not counted
+static const int LIMIT_RETRIES = 3;     // Consecutive failed reads of the perf limit reasons before giving up on them
+
+static const char* const REASON_NAMES[THROTTLE_REASON_COUNT] = { "PROCHOT", "Thermal", "PL2", "PL1", "EDP" };
+
+
+const char* CpuThrottle::ReasonName(int reason) {
+    return (reason >= 0 && reason < THROTTLE_REASON_COUNT) ? REASON_NAMES[reason] : "";
+}
+
+
+int CpuThrottle::FindReason(const char* name) {
+    if (name[0] == '\0') return -1;
+    for (int i = 0; i < THROTTLE_REASON_COUNT; i++) {
+        if (strcmp(REASON_NAMES[i], name) == 0) return i;
+    }
+    return THROTTLE_REASON_COUNT;
+}
+
+
+bool CpuThrottle::Update(int64_t timestamp, const std::vector<int>& packageProcessors) {
+    static const std::vector<int> FIRST_PROCESSOR(1, 0);
+    const std::vector<int>& processors = packageProcessors.empty() ? FIRST_PROCESSOR : packageProcessors;
+
+    uint32_t reasons = 0;
+    bool anyPackage = false;
+    bool limitFailed = false;
+    for (size_t i = 0; reader != NULL && i < processors.size(); i++) {
+        uint64_t thermStatus = 0;
+        uint32_t index = MSR_PACKAGE_THERM_STATUS;
+        if (!reader->Read(processors[i], &index, 1, &thermStatus)) continue;
+        anyPackage = true;
+
+        uint64_t limitReasons = 0;
+        index = MSR_CORE_PERF_LIMIT_REASONS;
+        if (hasLimitReasons && reader->Read(processors[i], &index, 1, &limitReasons)) {
+            if (limitReasons & LIMIT_PROCHOT) reasons |= 1u << THROTTLE_PROCHOT;
+            if (limitReasons & LIMIT_THERMAL) reasons |= 1u << THROTTLE_THERMAL;
+            if (limitReasons & LIMIT_PL2) reasons |= 1u << THROTTLE_PL2;
+            if (limitReasons & LIMIT_PL1) reasons |= 1u << THROTTLE_PL1;
+            if (limitReasons & (LIMIT_EDP | LIMIT_VR_CURRENT | LIMIT_VR_THERMAL)) reasons |= 1u << THROTTLE_EDP;
+        }
+        else {
+            // Older CPUs only report the package status; a power limit is reported as PL1
+            limitFailed = limitFailed || hasLimitReasons;
+            if (thermStatus & PACKAGE_PROCHOT) reasons |= 1u << THROTTLE_PROCHOT;
+            if (thermStatus & PACKAGE_THERMAL_STATUS) reasons |= 1u << THROTTLE_THERMAL;
+            if (thermStatus & PACKAGE_POWER_LIMIT) reasons |= 1u << THROTTLE_PL1;
+        }
+    }
+    if (!anyPackage) {
+        valid = false;
+        return false;
+    }
+
+    // A transient failure falls back to the package status; only repeated failures mean there is no register
+    limitFailures = limitFailed ? limitFailures + 1 : 0;
+    if (limitFailures >= LIMIT_RETRIES) hasLimitReasons = false;
+
+    // Attribute the time since the last update to the state seen now
+    int64_t interval = timestamp - lastTimestamp;
+    if (valid && interval > 0 && interval <= MAX_INTERVAL) {
+        totalSeconds += interval;
+        if (reasons != 0) anySeconds += interval;
+        for (int i = 0; i < THROTTLE_REASON_COUNT; i++) {
+            if (reasons & (1u << i)) reasonSeconds[i] += interval;
+        }
+    }
+
+    active = reasons;
+    lastTimestamp = timestamp;
+    valid = true;
+    return true;
+}
+
+
+int CpuThrottle::TemperatureTarget() {
+    if (temperatureTarget < 0) {
+        uint64_t value = 0;
+        uint32_t index = MSR_TEMPERATURE_TARGET;
+        temperatureTarget = 0;
+        if (reader != NULL && reader->Read(0, &index, 1, &value)) {
+            temperatureTarget = static_cast<int>((value >> TEMPERATURE_TARGET_SHIFT) & TEMPERATURE_TARGET_MASK);
+        }
+    }
+    return temperatureTarget;
+}
+
+
+const char* CpuThrottle::ActiveReason() const {
+    for (int i = 0; i < THROTTLE_REASON_COUNT; i++) {
+        if (Active(i)) return REASON_NAMES[i];
+    }
+    return "";
+}
+
+
+double CpuThrottle::Percent(int reason) const {
+    if (totalSeconds <= 0.0) return 0.0;
+    double seconds = (reason < 0) ? anySeconds : reasonSeconds[reason];
+    return seconds * 100.0 / totalSeconds;
+}
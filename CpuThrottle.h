@@ -0,0 +1,61 @@
+// CPU throttling and power-limit status, the CPU counterpart of the GPU Limit field.
+// Reads the package thermal status (IA32_PACKAGE_THERM_STATUS) and, where available, the
+// perf limit reasons register (MSR_CORE_PERF_LIMIT_REASONS) which tells PL1/PL2, PROCHOT,
+// thermal and electrical limits apart. Both registers are package scoped; on multi-socket systems
+// they are read on one processor of each package and a reason is active if any package reports it.
+// Time in each state is accumulated between updates.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Msr.h"
+
+
+enum ThrottleReason {
+    THROTTLE_PROCHOT,   // PROCHOT# asserted, e.g. by the VRM or an external sensor
+    THROTTLE_THERMAL,   // Package reached its thermal limit
+    THROTTLE_PL2,       // Short-term package power limit
+    THROTTLE_PL1,       // Long-term package power limit
+    THROTTLE_EDP,       // Electrical design point or VR current limit
+    THROTTLE_REASON_COUNT
+};
+
+
+class CpuThrottle {
+public:
+    explicit CpuThrottle(MsrReader* reader) : reader(reader) {}
+
+    // Sample the status registers of the packages of 'packageProcessors' (one logical processor per package,
+    // processor 0 if empty); returns false if no package can be read
+    bool Update(int64_t timestamp, const std::vector<int>& packageProcessors);
+
+    bool Valid() const { return valid; }
+    bool Active(int reason) const { return (active & (1u << reason)) != 0; }
+    bool Throttling() const { return active != 0; }
+    // Name of the most severe active reason, or "" if the CPU is not throttled
+    const char* ActiveReason() const;
+    // Share of the sampled time spent in 'reason' (or any reason for -1), in percent
+    double Percent(int reason) const;
+
+    // Temperature at which the CPU starts to throttle (TjMax) from IA32_TEMPERATURE_TARGET in degrees Celsius,
+    // or 0 if the register cannot be read; read once
+    int TemperatureTarget();
+
+    static const char* ReasonName(int reason);
+    // Find a reason by name; returns -1 for "" (any reason) and THROTTLE_REASON_COUNT if unknown
+    static int FindReason(const char* name);
+
+private:
+    MsrReader* reader;
+    bool valid = false;
+    bool hasLimitReasons = true;        // Cleared when the CPU has no perf limit reasons register
+    int limitFailures = 0;              // Consecutive updates in which the perf limit reasons could not be read
+    uint32_t active = 0;                // Bit mask of active ThrottleReason values
+    int64_t lastTimestamp = 0;
+    double totalSeconds = 0.0;
+    double anySeconds = 0.0;
+    double reasonSeconds[THROTTLE_REASON_COUNT] = {};
+    int temperatureTarget = -1;         // Cached TjMax, -1 until read
+};
@@ -0,0 +1,96 @@
+// Processor topology, see CpuTopology.h
+
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static_assert(sizeof(ProcessorGroupMask) == sizeof(GROUP_AFFINITY), "GROUP_AFFINITY layout");
+static_assert(offsetof(ProcessorRecord, flags) == offsetof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, Processor),
+    "SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX layout");
+static_assert(offsetof(ProcessorRecord, groupMask) - offsetof(ProcessorRecord, flags) ==
+    offsetof(PROCESSOR_RELATIONSHIP, GroupMask), "PROCESSOR_RELATIONSHIP layout");
+static_assert(RELATION_PROCESSOR_CORE == RelationProcessorCore && RELATION_PROCESSOR_PACKAGE == RelationProcessorPackage,
+    "LOGICAL_PROCESSOR_RELATIONSHIP values");
+#endif
+
+
+void CpuTopology::Build(const std::vector<LogicalProcessor>& processors) {
+    packages.clear();
+    classes.clear();
+
+    // Efficiency classes are not necessarily contiguous, so map them to ascending class indices
+    std::vector<int> efficiencies;
+    for (size_t i = 0; i < processors.size(); i++) {
+        if (processors[i].package >= 0) efficiencies.push_back(processors[i].efficiency);
+    }
+    std::sort(efficiencies.begin(), efficiencies.end());
+    efficiencies.erase(std::unique(efficiencies.begin(), efficiencies.end()), efficiencies.end());
+    classes.resize(efficiencies.size());
+
+    for (size_t i = 0; i < processors.size(); i++) {
+        int package = processors[i].package;
+        if (package < 0) continue;
+        if (package >= PackageCount()) packages.resize(package + 1);
+        packages[package].push_back(static_cast<int>(i));
+
+        int coreClass = static_cast<int>(std::lower_bound(efficiencies.begin(), efficiencies.end(),
+            processors[i].efficiency) - efficiencies.begin());
+        classes[coreClass].push_back(static_cast<int>(i));
+    }
+}
+
+
+void CpuTopology::Build(const void* records, size_t length, const std::vector<int>& groupSizes) {
+    std::vector<int> groupStart(groupSizes.size() + 1, 0);
+    for (size_t group = 0; group < groupSizes.size(); group++) {
+        groupStart[group + 1] = groupStart[group] + groupSizes[group];
+    }
+    LogicalProcessor unknown = { -1, 0 };
+    std::vector<LogicalProcessor> processors(groupStart.back(), unknown);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(records);
+    const size_t headerSize = offsetof(ProcessorRecord, groupMask);
+    int package = 0;
+    for (size_t offset = 0; offset + 2 * sizeof(uint32_t) <= length; ) {
+        ProcessorRecord record = {};
+        memcpy(&record, bytes + offset, std::min(sizeof(record), length - offset));
+        if (record.size < 2 * sizeof(uint32_t) || record.size > length - offset) break;     // Damaged list
+
+        bool isPackage = record.relationship == RELATION_PROCESSOR_PACKAGE;
+        if ((isPackage || record.relationship == RELATION_PROCESSOR_CORE) && record.size >= headerSize) {
+            for (int i = 0; i < record.groupCount; i++) {
+                size_t maskOffset = headerSize + i * sizeof(ProcessorGroupMask);
+                if (maskOffset + sizeof(ProcessorGroupMask) > record.size) break;
+                ProcessorGroupMask affinity;
+                memcpy(&affinity, bytes + offset + maskOffset, sizeof(affinity));
+                if (affinity.group >= groupSizes.size()) continue;
+
+                for (int bit = 0; bit < static_cast<int>(sizeof(affinity.mask) * 8); bit++) {
+                    int processor = groupStart[affinity.group] + bit;
+                    if ((affinity.mask & (static_cast<uintptr_t>(1) << bit)) == 0 ||
+                        processor >= groupStart[affinity.group + 1]) {
+                        continue;
+                    }
+                    if (isPackage) processors[processor].package = package;
+                    else processors[processor].efficiency = record.efficiencyClass;
+                }
+            }
+            if (isPackage) package++;
+        }
+        offset += record.size;
+    }
+
+    Build(processors);
+}
+
+
+int CpuTopology::FindClass(const char* name) const {
+    if (classes.empty()) return -1;
+    if (strcmp(name, "P") == 0) return ClassCount() - 1;
+    if (strcmp(name, "E") == 0 && Hybrid()) return 0;
+    return -1;
+}
@@ -0,0 +1,69 @@
+// Processor topology: which package (socket) and core class every logical processor belongs to.
+// Core classes follow the Windows efficiency class, where a higher class means faster cores; on
+// hybrid CPUs the highest class are the P-cores and the lowest the E-cores. The topology is built
+// from a plain list, or from the records Windows returns for it, which are parsed here so that any
+// platform can check the parsing against made-up records.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+struct LogicalProcessor {
+    int package;        // Physical package (socket) index
+    int efficiency;     // Efficiency class of the core, 0 on CPUs with a single core type
+};
+
+
+// Layout of the SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX records that GetLogicalProcessorInformationEx returns
+// for cores and packages (PROCESSOR_RELATIONSHIP); records of other relationships are skipped by their size
+enum ProcessorRelationship : uint32_t {
+    RELATION_PROCESSOR_CORE = 0,
+    RELATION_PROCESSOR_PACKAGE = 3
+};
+
+struct ProcessorGroupMask {
+    uintptr_t mask;         // KAFFINITY, one bit per processor of the group
+    uint16_t group;
+    uint16_t reserved[3];
+};
+
+struct ProcessorRecord {
+    uint32_t relationship;
+    uint32_t size;          // Of the whole record, the offset of the next one
+    uint8_t flags;
+    uint8_t efficiencyClass;
+    uint8_t reserved[20];
+    uint16_t groupCount;
+    ProcessorGroupMask groupMask[1];    // 'groupCount' entries
+};
+
+
+class CpuTopology {
+public:
+    // Build the topology from one entry per logical processor, indexed by system-wide processor number
+    void Build(const std::vector<LogicalProcessor>& processors);
+    // Build the topology from 'length' bytes of records of GetLogicalProcessorInformationEx(RelationAll).
+    // System-wide processor numbers are assigned group by group; 'groupSizes' holds the number of active
+    // processors of every group. Processors no package record covers are left out
+    void Build(const void* records, size_t length, const std::vector<int>& groupSizes);
+
+    bool Empty() const { return packages.empty(); }
+    bool Hybrid() const { return classes.size() > 1; }
+    int PackageCount() const { return static_cast<int>(packages.size()); }
+    int ClassCount() const { return static_cast<int>(classes.size()); }
+
+    // Logical processors of a package or of a core class (0 = lowest efficiency class)
+    const std::vector<int>& PackageProcessors(int package) const { return packages[package]; }
+    const std::vector<int>& ClassProcessors(int coreClass) const { return classes[coreClass]; }
+
+    // Find a core class by name: "P" for performance and "E" for efficiency cores; returns -1 if unknown.
+    // Without hybrid cores "P" selects all cores and "E" is unknown
+    int FindClass(const char* name) const;
+
+private:
+    std::vector<std::vector<int>> packages;
+    std::vector<std::vector<int>> classes;
+};
@@ -0,0 +1,370 @@
+// Web dashboard with Server-Sent Events, see DashboardServer.h
+
+#include "DashboardServer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Metrics.h"
+
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+static const Socket NO_SOCKET = INVALID_SOCKET;
+#define SHUT_RDWR SD_BOTH
+#else
+typedef int Socket;
+static const Socket NO_SOCKET = -1;
+#define closesocket close
+#endif
+
+
+static const int IO_TIMEOUT = 5;    // Seconds a viewer may stall a send or take to send its request
+
+
+static const char PAGE[] = R"(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>CPUGPU</title>
+<style>
+body { font: 14px monospace; background: #111; color: #ddd; margin: 2em; }
+h2 { color: #8cf; margin: 1em 0 .3em; } table { border-collapse: collapse; }
+td { padding: 1px 1.5em 1px 0; } td.v { text-align: right; color: #fff; } #time { color: #888; }
+</style></head><body>
+<div id="time">Connecting...</div><div id="groups"></div>
+<script>
+const values = {};
+function render(time) {
+  const groups = {};
+  for (const key of Object.keys(values).sort()) {
+    const group = key.split("_")[0];
+    (groups[group] = groups[group] || []).push(key);
+  }
+  let html = "";
+  for (const group of ["cpu", "gpu", "mem", "disk", "net"]) {
+    if (!groups[group]) continue;
+    html += "<h2>" + group.toUpperCase() + "</h2><table>";
+    for (const key of groups[group]) {
+      const value = values[key];
+      const text = value === null ? "-" : (Math.abs(value) >= 1e6 ? value.toExponential(2) : +value.toFixed(2));
+      html += "<tr><td>" + key.substring(group.length + 1) + "</td><td class='v'>" + text + "</td></tr>";
+    }
+    html += "</table>";
+  }
+  document.getElementById("groups").innerHTML = html;
+  document.getElementById("time").textContent = new Date(time * 1000).toLocaleTimeString();
+}
+const events = new EventSource("events");
+events.onmessage = function (event) {
+  const update = JSON.parse(event.data);
+  for (const key in update.values) values[key] = update.values[key];
+  render(update.time);
+};
+events.onerror = function () { document.getElementById("time").textContent = "Disconnected, retrying..."; };
+</script></body></html>
+)";
+
+
+struct Viewer {
+    Socket socket = NO_SOCKET;      // Closed by the viewer thread, under the server lock
+    std::thread thread;
+    std::atomic<bool> done{ false };
+};
+
+
+struct DashboardServer::Impl {
+    Socket listener = NO_SOCKET;
+    std::thread acceptor;
+    std::atomic<bool> stopping{ false };
+
+    std::mutex lock;                            // Guards the members below
+    std::condition_variable published;
+    uint64_t sequence = 0;                      // Number of ticks published
+    std::shared_ptr<const std::string> full;    // SSE event with all values of the last tick
+    std::shared_ptr<const std::string> delta;   // SSE event with the values changed by the last tick
+    double last[METRIC_COUNT];
+    std::list<std::unique_ptr<Viewer>> viewers;
+
+    bool Start(int port);
+    void Stop();
+    void Publish(int64_t timestamp, const double* values);
+    void Accept();
+    void Serve(Viewer* viewer);
+    void Reap();
+};
+
+
+static bool SendAll(Socket socket, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        int sent = send(socket, data, static_cast<int>(size), 0);
+#else
+        ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+#endif
+        if (sent <= 0) return false;
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+
+// Bound blocking calls on a viewer socket, so a stalled viewer is dropped and Stop never waits for long
+static void SetTimeouts(Socket socket) {
+#ifdef _WIN32
+    DWORD timeout = IO_TIMEOUT * 1000;
+#else
+    timeval timeout = { IO_TIMEOUT, 0 };
+#endif
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+
+// Serialize one SSE event with the values selected by 'changed', or all values if it is NULL
+static std::shared_ptr<const std::string> SerializeEvent(int64_t timestamp, const double* values, const bool* changed) {
+    std::string event;
+    event.reserve(METRIC_COUNT * 32 + 64);
+    char text[64];
+    snprintf(text, sizeof(text), "data: {\"time\":%lld,\"values\":{", static_cast<long long>(timestamp));
+    event += text;
+    bool first = true;
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (changed != NULL && !changed[i]) continue;
+        if (!first) event += ',';
+        first = false;
+        size_t length = 0;
+        text[length++] = '"';
+        length += FormatMetricKey(i, '_', text + length);
+        text[length++] = '"';
+        text[length++] = ':';
+        // JSON has no NAN, unavailable readings are null
+        if (isnan(values[i])) snprintf(text + length, sizeof(text) - length, "null");
+        else snprintf(text + length, sizeof(text) - length, "%.10g", values[i]);
+        event += text;
+    }
+    event += "}}\n\n";
+    return std::make_shared<const std::string>(std::move(event));
+}
+
+
+DashboardServer::DashboardServer() : impl(new Impl()) {
+}
+
+
+DashboardServer::~DashboardServer() {
+    Stop();
+    delete impl;
+}
+
+
+bool DashboardServer::Running() const {
+    return impl->acceptor.joinable();
+}
+
+
+bool DashboardServer::Start(int port) {
+    return Running() || impl->Start(port);
+}
+
+
+void DashboardServer::Stop() {
+    if (Running()) impl->Stop();
+}
+
+
+void DashboardServer::Publish(int64_t timestamp, const double* values) {
+    impl->Publish(timestamp, values);
+}
+
+
+bool DashboardServer::Impl::Start(int port) {
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return false;
+#endif
+    // Only local viewers, the dashboard has no authentication
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (listener == NO_SOCKET ||
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse)) != 0 ||
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, MAX_VIEWERS) != 0) {
+        if (listener != NO_SOCKET) closesocket(listener);
+        listener = NO_SOCKET;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    stopping = false;
+    acceptor = std::thread(&Impl::Accept, this);
+    return true;
+}
+
+
+void DashboardServer::Impl::Stop() {
+    stopping = true;
+    published.notify_all();
+
+    // Closing the listener ends a blocking accept on Windows, shutting it down does elsewhere
+#ifdef _WIN32
+    closesocket(listener);
+#else
+    shutdown(listener, SHUT_RDWR);
+#endif
+    acceptor.join();
+#ifndef _WIN32
+    close(listener);
+#endif
+    listener = NO_SOCKET;
+
+    // The viewer threads take the lock when they finish, so they are joined without it; a viewer
+    // blocked in a send returns within IO_TIMEOUT if shutting the socket down does not end the call
+    std::list<std::unique_ptr<Viewer>> finished;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& viewer : viewers) {
+            if (viewer->socket != NO_SOCKET) shutdown(viewer->socket, SHUT_RDWR);
+        }
+        finished.swap(viewers);
+    }
+    for (auto& viewer : finished) viewer->thread.join();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+
+void DashboardServer::Impl::Publish(int64_t timestamp, const double* values) {
+    // Serialized here once per tick, outside the lock, and shared by every viewer
+    bool changed[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        changed[i] = (sequence == 0) || memcmp(&last[i], &values[i], sizeof(double)) != 0;
+        last[i] = values[i];
+    }
+    std::shared_ptr<const std::string> fullEvent = SerializeEvent(timestamp, values, NULL);
+    std::shared_ptr<const std::string> deltaEvent = SerializeEvent(timestamp, values, changed);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        full = fullEvent;
+        delta = deltaEvent;
+        sequence++;
+    }
+    published.notify_all();
+}
+
+
+void DashboardServer::Impl::Accept() {
+    while (!stopping) {
+        Socket socket = accept(listener, NULL, NULL);
+        if (socket == NO_SOCKET) {
+            if (stopping) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));   // Out of sockets, try again later
+            continue;
+        }
+
+        SetTimeouts(socket);
+        Reap();
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping || viewers.size() >= MAX_VIEWERS) {
+            static const char BUSY[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            SendAll(socket, BUSY, sizeof(BUSY) - 1);
+            closesocket(socket);
+            continue;
+        }
+        viewers.emplace_back(new Viewer());
+        Viewer* viewer = viewers.back().get();
+        viewer->socket = socket;
+        viewer->thread = std::thread(&Impl::Serve, this, viewer);
+    }
+}
+
+
+// Join the threads of viewers that disconnected
+void DashboardServer::Impl::Reap() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = viewers.begin(); it != viewers.end();) {
+        if ((*it)->done) {
+            (*it)->thread.join();
+            it = viewers.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+
+void DashboardServer::Impl::Serve(Viewer* viewer) {
+    // Read the request head; only the request line is used
+    char request[2048];
+    size_t size = 0;
+    while (size < sizeof(request) - 1) {
+        int received = static_cast<int>(recv(viewer->socket, request + size, static_cast<int>(sizeof(request) - 1 - size), 0));
+        if (received <= 0) break;
+        size += received;
+        request[size] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL) break;
+    }
+    request[size] = '\0';
+
+    char header[256];
+    if (strncmp(request, "GET / ", 6) == 0) {
+        int length = snprintf(header, sizeof(header),
+            "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+            static_cast<unsigned>(sizeof(PAGE) - 1));
+        if (SendAll(viewer->socket, header, length)) SendAll(viewer->socket, PAGE, sizeof(PAGE) - 1);
+    }
+    else if (strncmp(request, "GET /events ", 12) == 0) {
+        static const char STREAM[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+            "Connection: keep-alive\r\n\r\nretry: 2000\n\n";
+        uint64_t seen = 0;
+        bool ok = SendAll(viewer->socket, STREAM, sizeof(STREAM) - 1);
+        while (ok && !stopping) {
+            std::shared_ptr<const std::string> event;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                published.wait(guard, [&] { return stopping || sequence != seen; });
+                if (stopping) break;
+                // The delta only applies on top of the previous tick
+                event = (seen != 0 && sequence == seen + 1) ? delta : full;
+                seen = sequence;
+            }
+            ok = SendAll(viewer->socket, event->data(), event->size());
+        }
+    }
+    else {
+        static const char NOT_FOUND[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        SendAll(viewer->socket, NOT_FOUND, sizeof(NOT_FOUND) - 1);
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    shutdown(viewer->socket, SHUT_RDWR);
+    closesocket(viewer->socket);
+    viewer->socket = NO_SOCKET;
+    viewer->done = true;
+}
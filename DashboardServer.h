@@ -0,0 +1,35 @@
+// Local web dashboard of the sampled metrics.
+// An HTTP server on 127.0.0.1 serves a static page at "/" and a Server-Sent Events stream at "/events".
+// Each tick is serialized once into two JSON events shared by all viewers: the full set of values and
+// the values that changed since the previous tick. A viewer gets the full event when it connects or
+// when it skipped ticks because it read slowly, and the delta otherwise. Publish only swaps the shared
+// events and wakes the viewer threads, so the sampler never waits for a browser.
+
+#pragma once
+
+#include <stdint.h>
+
+
+class DashboardServer {
+public:
+    static const int MAX_VIEWERS = 32;
+
+    DashboardServer();
+    ~DashboardServer();
+
+    // Start listening on 127.0.0.1:'port'; returns false if the port cannot be bound
+    bool Start(int port);
+    void Stop();
+    bool Running() const;
+
+    // Hand over the METRIC_COUNT values of a new tick taken at Unix time 'timestamp'
+    void Publish(int64_t timestamp, const double* values);
+
+private:
+    // Threads and locks stay in the native translation unit, <thread> and <mutex> cannot be used under /clr
+    struct Impl;
+    Impl* impl;
+
+    DashboardServer(const DashboardServer&) = delete;
+    DashboardServer& operator=(const DashboardServer&) = delete;
+};
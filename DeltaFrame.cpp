@@ -0,0 +1,48 @@
+// Delta frames of snapshot values, see DeltaFrame.h
+
+#include "DeltaFrame.h"
+
+#include <string.h>
+
+
+size_t DeltaEncoder::Encode(int64_t timestamp, const double* values, uint8_t* out) {
+    uint64_t changed = 0;
+    size_t size = FRAME_HEADER_SIZE;
+    for (int i = 0; i < FRAME_MAX_VALUES; i++) {
+        if (!(subscription & (1ull << i))) continue;
+        if (primed && memcmp(&last[i], &values[i], sizeof(double)) == 0) continue;
+        changed |= 1ull << i;
+        memcpy(out + size, &values[i], sizeof(double));
+        size += sizeof(double);
+        last[i] = values[i];
+    }
+    primed = true;
+
+    uint32_t frameSize = static_cast<uint32_t>(size);
+    memcpy(out, &frameSize, 4);
+    memcpy(out + 4, &FRAME_VERSION, 4);
+    memcpy(out + 8, &timestamp, 8);
+    memcpy(out + 16, &changed, 8);
+    return size;
+}
+
+
+bool ApplyDeltaFrame(const uint8_t* frame, size_t size, int64_t* timestamp, double* values) {
+    if (size < FRAME_HEADER_SIZE) return false;
+    uint32_t frameSize, version;
+    uint64_t changed;
+    memcpy(&frameSize, frame, 4);
+    memcpy(&version, frame + 4, 4);
+    memcpy(timestamp, frame + 8, 8);
+    memcpy(&changed, frame + 16, 8);
+    if (version != FRAME_VERSION || frameSize != size) return false;
+
+    size_t offset = FRAME_HEADER_SIZE;
+    for (int i = 0; i < FRAME_MAX_VALUES; i++) {
+        if (!(changed & (1ull << i))) continue;
+        if (offset + sizeof(double) > size) return false;
+        memcpy(&values[i], frame + offset, sizeof(double));
+        offset += sizeof(double);
+    }
+    return offset == size;
+}
@@ -0,0 +1,36 @@
+// Compact binary frames carrying the snapshot values that changed since the last frame sent to a subscriber.
+// A frame is: uint32 frame size in bytes, uint32 FRAME_VERSION, int64 Unix time, uint64 mask of the values
+// that follow, then one double per set bit in ascending index order, all in native (little-endian) byte order.
+// Values are compared bit for bit, so a reading that stays unavailable (NAN) is not resent. A frame without
+// values only carries the time, so subscribers can tell a quiet tick from a stream that stopped.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+static const uint32_t FRAME_VERSION = 1;
+static const int FRAME_MAX_VALUES = 64;
+static const size_t FRAME_HEADER_SIZE = 24;
+static const size_t FRAME_MAX_SIZE = FRAME_HEADER_SIZE + FRAME_MAX_VALUES * sizeof(double);
+
+
+class DeltaEncoder {
+public:
+    // Bit i of 'subscription' selects value i
+    explicit DeltaEncoder(uint64_t subscription) : subscription(subscription) {}
+
+    // Encode the subscribed values that differ from the last encoded ones (all of them the first time) into
+    // 'out' of FRAME_MAX_SIZE bytes. Returns the frame size, FRAME_HEADER_SIZE if no subscribed value changed
+    size_t Encode(int64_t timestamp, const double* values, uint8_t* out);
+
+private:
+    uint64_t subscription;
+    bool primed = false;
+    double last[FRAME_MAX_VALUES];
+};
+
+
+// Apply a frame to the values a client keeps; returns false if the frame is malformed
+bool ApplyDeltaFrame(const uint8_t* frame, size_t size, int64_t* timestamp, double* values);
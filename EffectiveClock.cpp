@@ -0,0 +1,119 @@
+// Effective CPU clocks from APERF/MPERF, see EffectiveClock.h
+
+#include "EffectiveClock.h"
+
+
+bool EffectiveClock::Update(double baseMhz) {
+    int count = reader ? reader->ProcessorCount() : 0;
+    if (count <= 0 || baseMhz <= 0) return false;
+    if (static_cast<int>(previous.size()) != count) {
+        previous.assign(count, Counters());
+        clocks.assign(count, 0.0);
+        busy.assign(count, 0.0);
+        primed = false;
+    }
+
+    static const uint32_t indices[3] = { MSR_TIME_STAMP_COUNTER, MSR_MPERF, MSR_APERF };
+    for (int i = 0; i < count; i++) {
+        uint64_t values[3];
+        if (!reader->Read(i, indices, 3, values)) {
+            valid = false;
+            primed = false;
+            return false;
+        }
+
+        Counters current = { values[0], values[1], values[2] };
+        if (primed) {
+            uint64_t tsc = current.tsc - previous[i].tsc;
+            uint64_t mperf = current.mperf - previous[i].mperf;
+            uint64_t aperf = current.aperf - previous[i].aperf;
+            // Counters can be reset by firmware on resume; keep the last value for such an interval
+            if (tsc > 0 && mperf > 0 && mperf <= tsc && current.mperf >= previous[i].mperf) {
+                clocks[i] = baseMhz * static_cast<double>(aperf) / static_cast<double>(mperf);
+                busy[i] = static_cast<double>(mperf) / static_cast<double>(tsc);
+            }
+        }
+        previous[i] = current;
+    }
+
+    valid = primed;
+    primed = true;
+    return true;
+}
+
+
+void EffectiveClock::UpdateFromCurrentClocks(const double* mhz, int count) {
+    clocks.assign(mhz, mhz + count);
+    busy.assign(count, 1.0);
+    previous.clear();
+    primed = false;
+    valid = count > 0;
+}
+
+
+double EffectiveClock::Min() const {
+    double result = 0.0;
+    for (size_t i = 0; i < clocks.size(); i++) {
+        if (i == 0 || clocks[i] < result) result = clocks[i];
+    }
+    return result;
+}
+
+
+double EffectiveClock::Max() const {
+    double result = 0.0;
+    for (size_t i = 0; i < clocks.size(); i++) {
+        if (clocks[i] > result) result = clocks[i];
+    }
+    return result;
+}
+
+
+double EffectiveClock::Average() const {
+    if (clocks.empty()) return 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < clocks.size(); i++) sum += clocks[i];
+    return sum / clocks.size();
+}
+
+
+double EffectiveClock::BusyWeighted() const {
+    double sum = 0.0;
+    double weight = 0.0;
+    for (size_t i = 0; i < clocks.size(); i++) {
+        sum += clocks[i] * busy[i];
+        weight += busy[i];
+    }
+    return (weight > 0.0) ? sum / weight : Average();
+}
+
+
+double EffectiveClock::BusyWeighted(const std::vector<int>& processors) const {
+    double sum = 0.0;
+    double weight = 0.0;
+    double plain = 0.0;
+    int count = 0;
+    for (size_t i = 0; i < processors.size(); i++) {
+        int processor = processors[i];
+        if (processor < 0 || processor >= Count()) continue;
+        sum += clocks[processor] * busy[processor];
+        weight += busy[processor];
+        plain += clocks[processor];
+        count++;
+    }
+    if (weight > 0.0) return sum / weight;
+    return (count > 0) ? plain / count : 0.0;
+}
+
+
+double EffectiveClock::Load(const std::vector<int>& processors) const {
+    double sum = 0.0;
+    int count = 0;
+    for (size_t i = 0; i < processors.size(); i++) {
+        int processor = processors[i];
+        if (processor < 0 || processor >= Count()) continue;
+        sum += busy[processor];
+        count++;
+    }
+    return (count > 0) ? 100.0 * sum / count : 0.0;
+}
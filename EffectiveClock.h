@@ -0,0 +1,47 @@
+// Delivered (effective) CPU clocks of every logical processor.
+// Over a sampling interval the clock while busy is base * dAPERF / dMPERF and the busy share is
+// dMPERF / dTSC. All registers of a processor are read in one batch per tick.
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include "Msr.h"
+
+
+class EffectiveClock {
+public:
+    explicit EffectiveClock(MsrReader* reader) : reader(reader) {}
+
+    // Sample the counters, 'baseMhz' being the frequency MPERF counts at; returns false if the registers cannot be read
+    bool Update(double baseMhz);
+    // Use reported current clocks instead of counters, e.g. when MSRs are unavailable
+    void UpdateFromCurrentClocks(const double* mhz, int count);
+
+    bool Valid() const { return valid; }
+    bool Measured() const { return valid && primed; }     // Clocks and busy shares come from the counters
+    int Count() const { return static_cast<int>(clocks.size()); }
+    double Clock(int processor) const { return clocks[processor]; }
+    double Min() const;
+    double Max() const;
+    double Average() const;
+    double BusyWeighted() const;    // Average weighted by the busy share, the clock the work ran at
+    // Busy-weighted clock and busy share in percent of a subset of processors, e.g. one package or core class
+    double BusyWeighted(const std::vector<int>& processors) const;
+    double Load(const std::vector<int>& processors) const;
+
+private:
+    struct Counters {
+        uint64_t tsc;
+        uint64_t mperf;
+        uint64_t aperf;
+    };
+
+    MsrReader* reader;
+    bool valid = false;
+    bool primed = false;
+    std::vector<Counters> previous;
+    std::vector<double> clocks;     // MHz while busy
+    std::vector<double> busy;       // Share of the interval spent in C0, 0..1
+};
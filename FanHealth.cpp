@@ -0,0 +1,128 @@
+// Fan anomaly detection, see FanHealth.h
+
+#include "FanHealth.h"
+
+#include <math.h>
+#include <string.h>
+
+
+static const uint32_t MIN_LEARNED = 60;     // Samples before a cell's statistics are trusted
+static const double LEARN_RATE = 0.01;      // Weight of a new sample once a cell is learned
+static const double SPINNING_RPM = 200.0;   // Normal speeds above this mean the fan should spin
+static const double STALL_TEMPERATURE = 80.0; // A stopped fan is suspicious here even without history
+static const int STALLED_SAMPLES = 10;      // Consecutive anomalous samples before a fault is reported
+static const int DEGRADED_SAMPLES = 60;
+static const int STUCK_SAMPLES = 120;
+
+
+FanMonitor::FanMonitor() {
+    memset(cells, 0, sizeof(cells));
+    memset(rows, 0, sizeof(rows));
+}
+
+
+const char* FanMonitor::HealthName(FanHealth health) {
+    switch (health) {
+    case FAN_OK:        return "OK";
+    case FAN_STALLED:   return "Stalled";
+    case FAN_DEGRADED:  return "Degraded";
+    case FAN_STUCK_MAX: return "Stuck";
+    default:            return "Learning";
+    }
+}
+
+
+// Exponentially weighted mean and variance; plain running statistics until the cell is learned
+void FanMonitor::Learn(Statistics* statistics, double rpm) {
+    statistics->count++;
+    double rate = (statistics->count < MIN_LEARNED) ? 1.0 / statistics->count : LEARN_RATE;
+    double delta = rpm - statistics->mean;
+    statistics->mean += rate * delta;
+    statistics->variance = (1.0 - rate) * (statistics->variance + rate * delta * delta);
+}
+
+
+const FanMonitor::Statistics* FanMonitor::Expected(int temp, int load) const {
+    if (load >= 0 && cells[temp][load].count >= MIN_LEARNED) return &cells[temp][load];
+    if (rows[temp].count >= MIN_LEARNED) return &rows[temp];
+    return NULL;
+}
+
+
+// Highest learned normal speed over all temperatures, robust against single noisy readings
+double FanMonitor::FullSpeed() const {
+    double fullSpeed = 0.0;
+    for (int i = 0; i < TEMP_BINS; i++) {
+        if (rows[i].count >= MIN_LEARNED && rows[i].mean > fullSpeed) fullSpeed = rows[i].mean;
+    }
+    return fullSpeed;
+}
+
+
+bool FanMonitor::ExpectedRpm(double* rpm) const {
+    const Statistics* expected = Expected(tempBin, loadBin);
+    if (expected == NULL) return false;
+    *rpm = expected->mean;
+    return true;
+}
+
+
+void FanMonitor::Update(double rpm, double temperature, double load) {
+    if (rpm != rpm || temperature != temperature) return;   // Skip unavailable samples
+
+    tempBin = static_cast<int>((temperature - 20.0) / 5.0);
+    if (tempBin < 0) tempBin = 0;
+    if (tempBin >= TEMP_BINS) tempBin = TEMP_BINS - 1;
+    loadBin = (load == load) ? static_cast<int>(load / 25.0) : -1;
+    if (loadBin >= LOAD_BINS) loadBin = LOAD_BINS - 1;
+
+    // Classify the sample against the learned normal speed
+    const Statistics* expected = Expected(tempBin, loadBin);
+    FanHealth anomaly = FAN_OK;
+    int required = 1;
+    if (expected == NULL) {
+        if (rpm < 1.0 && temperature >= STALL_TEMPERATURE) {
+            anomaly = FAN_STALLED;
+            required = STALLED_SAMPLES;
+        }
+    }
+    else {
+        double deviation = sqrt(expected->variance);
+        if (deviation < 0.05 * expected->mean) deviation = 0.05 * expected->mean;
+        if (deviation < 50.0) deviation = 50.0;
+
+        if (rpm < 1.0 && expected->mean >= SPINNING_RPM) {
+            anomaly = FAN_STALLED;
+            required = STALLED_SAMPLES;
+        }
+        else if (rpm >= 1.0 && rpm < expected->mean - 4.0 * deviation && rpm < 0.7 * expected->mean) {
+            anomaly = FAN_DEGRADED;
+            required = DEGRADED_SAMPLES;
+        }
+        else if (rpm >= 0.9 * FullSpeed() && expected->mean < 0.6 * FullSpeed()) {
+            anomaly = FAN_STUCK_MAX;
+            required = STUCK_SAMPLES;
+        }
+    }
+
+    // Report a fault only when it persists
+    if (anomaly == candidate) {
+        anomalyRun++;
+    }
+    else {
+        candidate = anomaly;
+        anomalyRun = 1;
+    }
+    if (anomaly == FAN_OK) {
+        health = (expected != NULL) ? FAN_OK : FAN_LEARNING;
+    }
+    else if (anomalyRun >= required) {
+        health = anomaly;
+    }
+
+    // Only normal samples are learned, so a developing fault does not become the new normal
+    if (anomaly == FAN_OK) {
+        if (loadBin >= 0) Learn(&cells[tempBin][loadBin], rpm);
+        Learn(&rows[tempBin], rpm);
+    }
+}
@@ -0,0 +1,54 @@
+// Fan failure and anomaly detection.
+// The monitor learns the normal fan speed as a function of temperature and load from streaming
+// statistics (exponentially weighted mean and variance of RPM per temperature/load cell) and flags
+// samples that persistently deviate from it. A stopped fan is only reported as stalled when the
+// fan normally spins in the current conditions, so zero-RPM fan modes are not mistaken for failures.
+
+#pragma once
+
+#include <stdint.h>
+
+
+enum FanHealth {
+    FAN_LEARNING,   // Not enough samples for the current conditions yet
+    FAN_OK,
+    FAN_STALLED,    // Not spinning although it normally does at this temperature and load
+    FAN_DEGRADED,   // Spinning well below its normal speed, e.g. a failing bearing
+    FAN_STUCK_MAX   // Running at full speed although the conditions call for much less
+};
+
+
+class FanMonitor {
+public:
+    FanMonitor();
+
+    // Feed one sample of fan speed, temperature in degrees Celsius and load in percent
+    void Update(double rpm, double temperature, double load);
+    FanHealth Health() const { return health; }
+    // Learned normal speed for the last conditions; returns false while still learning
+    bool ExpectedRpm(double* rpm) const;
+
+    static const char* HealthName(FanHealth health);
+
+private:
+    struct Statistics {
+        double mean;
+        double variance;
+        uint32_t count;
+    };
+
+    static const int TEMP_BINS = 16;    // 5 degrees each, from 20 to 100 degrees Celsius
+    static const int LOAD_BINS = 4;     // 25% each
+
+    const Statistics* Expected(int tempBin, int loadBin) const;
+    double FullSpeed() const;
+    static void Learn(Statistics* statistics, double rpm);
+
+    Statistics cells[TEMP_BINS][LOAD_BINS];     // Normal speed per temperature and load
+    Statistics rows[TEMP_BINS];                 // Normal speed per temperature, used until a cell is learned
+    int tempBin = 0;
+    int loadBin = 0;
+    int anomalyRun = 0;                         // Consecutive samples with the same anomaly
+    FanHealth candidate = FAN_OK;
+    FanHealth health = FAN_LEARNING;
+};
@@ -0,0 +1,314 @@
+// Gorilla-style compressed sensor history, see History.h
+
+#include "History.h"
+
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+// Count leading zero bits of a non-zero 64-bit value
+static int LeadingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(value);
+#endif
+}
+
+
+// Count trailing zero bits of a non-zero 64-bit value
+static int TrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+
+static uint64_t DoubleBits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+
+static double BitsDouble(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+static void ResetAggregate(HistoryAggregate* out) {
+    out->min = DBL_MAX;
+    out->max = -DBL_MAX;
+    out->sum = 0.0;
+    out->count = 0;
+}
+
+
+static void AddToAggregate(HistoryAggregate* out, double value) {
+    if (value < out->min) out->min = value;
+    if (value > out->max) out->max = value;
+    out->sum += value;
+    out->count++;
+}
+
+
+/*********************************************************
+ *         BitWriter / BitReader                         *
+ *********************************************************/
+
+void BitWriter::Write(uint64_t bits, int count) {
+    // Emit the lowest 'count' bits of 'bits', most significant first
+    while (count > 0) {
+        size_t bitInByte = bitCount & 7;
+        if (bitInByte == 0) bytes.push_back(0);
+
+        int free = 8 - static_cast<int>(bitInByte);
+        int take = count < free ? count : free;
+        uint8_t chunk = static_cast<uint8_t>((bits >> (count - take)) & ((1u << take) - 1));
+        bytes.back() |= static_cast<uint8_t>(chunk << (free - take));
+
+        count -= take;
+        bitCount += take;
+    }
+}
+
+
+uint64_t BitReader::Read(int count) {
+    uint64_t result = 0;
+    while (count > 0) {
+        if (position >= bitCount) return result << count;  // Truncated stream, pad with zeros
+
+        size_t bitInByte = position & 7;
+        int available = 8 - static_cast<int>(bitInByte);
+        int take = count < available ? count : available;
+        uint8_t byte = data[position >> 3];
+        uint64_t chunk = (byte >> (available - take)) & ((1u << take) - 1);
+        result = (result << take) | chunk;
+
+        count -= take;
+        position += take;
+    }
+    return result;
+}
+
+
+/*********************************************************
+ *         HistoryBlock                                  *
+ *********************************************************/
+
+void HistoryBlock::Append(int64_t timestamp, double value) {
+    uint64_t bits = DoubleBits(value);
+
+    if (count == 0) {
+        // The first sample is kept raw in the block header
+        firstTimestamp = timestamp;
+        firstBits = bits;
+        lastBits = bits;
+        lastLeading = 64;   // No meaningful-bit window yet
+        lastTrailing = 0;
+        min = max = sum = value;
+    }
+    else {
+        // Timestamp: delta-of-delta with variable-length buckets
+        int64_t delta = timestamp - lastTimestamp;
+        int64_t dod = delta - lastDelta;
+        if (dod == 0) {
+            stream.Write(0x0, 1);
+        }
+        else if (dod >= -63 && dod <= 64) {
+            stream.Write(0x2, 2);
+            stream.Write(static_cast<uint64_t>(dod + 63), 7);
+        }
+        else if (dod >= -255 && dod <= 256) {
+            stream.Write(0x6, 3);
+            stream.Write(static_cast<uint64_t>(dod + 255), 9);
+        }
+        else if (dod >= -2047 && dod <= 2048) {
+            stream.Write(0xE, 4);
+            stream.Write(static_cast<uint64_t>(dod + 2047), 12);
+        }
+        else {
+            stream.Write(0xF, 4);
+            stream.Write(static_cast<uint64_t>(delta), 64);
+        }
+        lastDelta = delta;
+
+        // Value: XOR with the previous value, reusing the previous meaningful-bit window when possible
+        uint64_t xorBits = bits ^ lastBits;
+        if (xorBits == 0) {
+            stream.Write(0x0, 1);
+        }
+        else {
+            int leading = LeadingZeros(xorBits);
+            int trailing = TrailingZeros(xorBits);
+            if (leading > 31) leading = 31;     // Leading zero count is stored in 5 bits
+
+            if (leading >= lastLeading && trailing >= lastTrailing) {
+                int meaningful = 64 - lastLeading - lastTrailing;
+                stream.Write(0x2, 2);
+                stream.Write(xorBits >> lastTrailing, meaningful);
+            }
+            else {
+                int meaningful = 64 - leading - trailing;
+                stream.Write(0x3, 2);
+                stream.Write(static_cast<uint64_t>(leading), 5);
+                stream.Write(static_cast<uint64_t>(meaningful - 1), 6);
+                stream.Write(xorBits >> trailing, meaningful);
+                lastLeading = leading;
+                lastTrailing = trailing;
+            }
+        }
+        lastBits = bits;
+
+        if (value < min) min = value;
+        if (value > max) max = value;
+        sum += value;
+    }
+
+    lastTimestamp = timestamp;
+    count++;
+}
+
+
+void HistoryBlock::Seal() {
+    stream.Shrink();
+}
+
+
+size_t HistoryBlock::Decode(int64_t from, int64_t to, int64_t* timestamps, double* values, size_t maxCount) const {
+    if (count == 0 || lastTimestamp < from || firstTimestamp > to) return 0;
+
+    size_t written = 0;
+    BitReader reader(stream.Bytes().data(), stream.BitCount());
+    int64_t timestamp = firstTimestamp;
+    int64_t delta = 0;
+    uint64_t bits = firstBits;
+    int leading = 0;
+    int trailing = 0;
+
+    for (uint32_t i = 0; i < count && written < maxCount; i++) {
+        if (i > 0) {
+            int64_t dod;
+            if (reader.Read(1) == 0) dod = 0;
+            else if (reader.Read(1) == 0) dod = static_cast<int64_t>(reader.Read(7)) - 63;
+            else if (reader.Read(1) == 0) dod = static_cast<int64_t>(reader.Read(9)) - 255;
+            else if (reader.Read(1) == 0) dod = static_cast<int64_t>(reader.Read(12)) - 2047;
+            else {
+                delta = static_cast<int64_t>(reader.Read(64));
+                dod = 0;
+            }
+            delta += dod;
+            timestamp += delta;
+
+            if (reader.Read(1) != 0) {
+                if (reader.Read(1) != 0) {
+                    leading = static_cast<int>(reader.Read(5));
+                    int meaningful = static_cast<int>(reader.Read(6)) + 1;
+                    trailing = 64 - leading - meaningful;
+                }
+                int meaningful = 64 - leading - trailing;
+                bits ^= reader.Read(meaningful) << trailing;
+            }
+        }
+
+        if (timestamp > to) break;
+        if (timestamp >= from) {
+            timestamps[written] = timestamp;
+            values[written] = BitsDouble(bits);
+            written++;
+        }
+    }
+    return written;
+}
+
+
+void HistoryBlock::Aggregate(int64_t from, int64_t to, HistoryAggregate* out) const {
+    if (count == 0 || lastTimestamp < from || firstTimestamp > to) return;
+
+    if (from <= firstTimestamp && lastTimestamp <= to) {
+        // Fully covered: use the block summary without decoding
+        if (min < out->min) out->min = min;
+        if (max > out->max) out->max = max;
+        out->sum += sum;
+        out->count += count;
+        return;
+    }
+
+    int64_t timestamps[SAMPLES_PER_BLOCK];
+    double values[SAMPLES_PER_BLOCK];
+    size_t decoded = Decode(from, to, timestamps, values, SAMPLES_PER_BLOCK);
+    for (size_t i = 0; i < decoded; i++) {
+        AddToAggregate(out, values[i]);
+    }
+}
+
+
+/*********************************************************
+ *         HistorySeries                                 *
+ *********************************************************/
+
+void HistorySeries::Append(int64_t timestamp, double value) {
+    if (value != value) return;     // NaN marks an unavailable sensor, leave a gap
+    if (!blocks.empty() && timestamp <= blocks.back().LastTimestamp()) return;
+
+    if (blocks.empty() || blocks.back().Full()) {
+        if (!blocks.empty()) blocks.back().Seal();
+        blocks.emplace_back();
+    }
+    blocks.back().Append(timestamp, value);
+
+    // Drop whole blocks that fell out of the retention window
+    while (blocks.size() > 1 && blocks.front().LastTimestamp() < timestamp - retention) {
+        blocks.pop_front();
+    }
+}
+
+
+bool HistorySeries::Aggregate(int64_t from, int64_t to, HistoryAggregate* out) const {
+    ResetAggregate(out);
+
+    std::deque<HistoryBlock>::const_iterator it = std::lower_bound(blocks.begin(), blocks.end(), from,
+        [](const HistoryBlock& block, int64_t time) { return block.LastTimestamp() < time; });
+    for (; it != blocks.end() && it->FirstTimestamp() <= to; ++it) {
+        it->Aggregate(from, to, out);
+    }
+    return out->count > 0;
+}
+
+
+size_t HistorySeries::Read(int64_t from, int64_t to, int64_t* timestamps, double* values, size_t maxCount) const {
+    size_t written = 0;
+
+    std::deque<HistoryBlock>::const_iterator it = std::lower_bound(blocks.begin(), blocks.end(), from,
+        [](const HistoryBlock& block, int64_t time) { return block.LastTimestamp() < time; });
+    for (; it != blocks.end() && it->FirstTimestamp() <= to && written < maxCount; ++it) {
+        written += it->Decode(from, to, timestamps + written, values + written, maxCount - written);
+    }
+    return written;
+}
+
+
+size_t HistorySeries::SampleCount() const {
+    size_t total = 0;
+    for (const HistoryBlock& block : blocks) total += block.Count();
+    return total;
+}
+
+
+size_t HistorySeries::ByteSize() const {
+    size_t total = sizeof(*this);
+    for (const HistoryBlock& block : blocks) total += block.ByteSize();
+    return total;
+}
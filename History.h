@@ -0,0 +1,106 @@
+// Compressed in-memory history of sensor samples.
+// Timestamps are stored as delta-of-delta and values as XOR against the previous value
+// (the "Gorilla" encoding). Samples are packed into fixed-size blocks; every block keeps
+// min/max/sum of its samples so range aggregates only decode blocks cut by the range.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+
+
+// Result of a range aggregate query
+struct HistoryAggregate {
+    double min;
+    double max;
+    double sum;
+    uint32_t count;
+};
+
+
+// Append-only bit stream used by the block encoder
+class BitWriter {
+public:
+    void Write(uint64_t bits, int count);
+    size_t BitCount() const { return bitCount; }
+    const std::vector<uint8_t>& Bytes() const { return bytes; }
+    void Shrink() { bytes.shrink_to_fit(); }
+
+private:
+    std::vector<uint8_t> bytes;
+    size_t bitCount = 0;
+};
+
+
+// Reader for a bit stream produced by BitWriter
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t bitCount) : data(data), bitCount(bitCount) {}
+    uint64_t Read(int count);
+    bool Empty() const { return position >= bitCount; }
+
+private:
+    const uint8_t* data;
+    size_t bitCount;
+    size_t position = 0;
+};
+
+
+// One block of up to SAMPLES_PER_BLOCK compressed samples with its summary
+class HistoryBlock {
+public:
+    static const int SAMPLES_PER_BLOCK = 120;   // 2 minutes of 1-second samples
+
+    void Append(int64_t timestamp, double value);
+    bool Full() const { return count >= SAMPLES_PER_BLOCK; }
+    void Seal();    // Release the encoder slack once the block is full
+
+    int64_t FirstTimestamp() const { return firstTimestamp; }
+    int64_t LastTimestamp() const { return lastTimestamp; }
+    uint32_t Count() const { return count; }
+    size_t ByteSize() const { return stream.Bytes().capacity() + sizeof(*this); }
+
+    // Aggregate samples with from <= timestamp <= to, using the summary when the block is fully covered
+    void Aggregate(int64_t from, int64_t to, HistoryAggregate* out) const;
+    // Decode samples with from <= timestamp <= to; returns the number of samples written
+    size_t Decode(int64_t from, int64_t to, int64_t* timestamps, double* values, size_t maxCount) const;
+
+private:
+    BitWriter stream;
+    uint32_t count = 0;
+    int64_t firstTimestamp = 0;
+    int64_t lastTimestamp = 0;
+    int64_t lastDelta = 0;
+    uint64_t firstBits = 0;
+    uint64_t lastBits = 0;
+    int lastLeading = 0;
+    int lastTrailing = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double sum = 0.0;
+};
+
+
+// Time series of one metric, keeping samples newer than the retention window
+class HistorySeries {
+public:
+    explicit HistorySeries(int64_t retentionSeconds) : retention(retentionSeconds) {}
+
+    // Append a sample; samples not newer than the last one and NaN values are ignored
+    void Append(int64_t timestamp, double value);
+    // Aggregate all samples in [from, to]; returns false if there are none
+    bool Aggregate(int64_t from, int64_t to, HistoryAggregate* out) const;
+    // Decode raw samples in [from, to] into caller buffers; returns the number of samples written
+    size_t Read(int64_t from, int64_t to, int64_t* timestamps, double* values, size_t maxCount) const;
+
+    int64_t OldestTimestamp() const { return blocks.empty() ? 0 : blocks.front().FirstTimestamp(); }
+    int64_t NewestTimestamp() const { return blocks.empty() ? 0 : blocks.back().LastTimestamp(); }
+    size_t SampleCount() const;
+    size_t ByteSize() const;
+
+private:
+    int64_t retention;
+    std::deque<HistoryBlock> blocks;    // Oldest first; only the last block is open for appends
+};
@@ -0,0 +1,233 @@
+// Push of the sampled metrics to a collector, see MetricExporter.h
+
+#include "MetricExporter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Metrics.h"
+
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+#else
+typedef int Socket;
+#endif
+
+static const size_t LINE_SIZE = 64;     // Longest formatted metric, name and value
+
+
+static void CloseSocket(Socket s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+
+static bool WouldBlock() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN || errno == EINPROGRESS;
+#endif
+}
+
+
+bool MetricExporter::Open(const char* target, ExportFormat exportFormat, const char* hostName) {
+    Close();
+    format = exportFormat;
+    host = hostName;
+    tcp = (strncmp(target, "tcp://", 6) == 0);
+    if (tcp) target += 6;
+    else if (strncmp(target, "udp://", 6) == 0) target += 6;
+
+    const char* colon = strrchr(target, ':');
+    if (colon == NULL) return false;
+    std::string node(target, colon - target);
+
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return false;
+#endif
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = tcp ? SOCK_STREAM : SOCK_DGRAM;
+    addrinfo* result = NULL;
+    if (getaddrinfo(node.c_str(), colon + 1, &hints, &result) != 0 || result == NULL) {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(result->ai_addr);
+    address.assign(raw, raw + result->ai_addrlen);
+    freeaddrinfo(result);
+
+    // Every metric fits in one line, plus the Influx tags and timestamp
+    buffer.assign(METRIC_COUNT * LINE_SIZE + host.size() + 64, '\0');
+    opened = true;
+    Connect(0);
+    return true;
+}
+
+
+void MetricExporter::Close() {
+    if (!opened) return;
+    Disconnect();
+    opened = false;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+
+bool MetricExporter::Connect(int64_t now) {
+    if (connected) return true;
+    if (connection == -1) {
+        intptr_t s = static_cast<intptr_t>(socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0));
+        if (s == -1) return false;
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        ioctlsocket(static_cast<Socket>(s), FIONBIO, &nonBlocking);
+#else
+        fcntl(static_cast<Socket>(s), F_SETFL, fcntl(static_cast<Socket>(s), F_GETFL) | O_NONBLOCK);
+#endif
+        connection = s;
+        connectStarted = 0;
+        // Datagrams are sent to the collector without a connection
+        if (!tcp) {
+            connected = true;
+            return true;
+        }
+        if (connect(static_cast<Socket>(connection), reinterpret_cast<const sockaddr*>(address.data()),
+            static_cast<int>(address.size())) == 0) {
+            connected = true;
+            return true;
+        }
+        if (!WouldBlock()) {
+            Disconnect();
+            return false;
+        }
+    }
+
+    // A connection in progress is usable once the socket is writable; Windows reports a failed one
+    // in the exception set instead
+    fd_set writable, failed;
+    FD_ZERO(&writable);
+    FD_ZERO(&failed);
+    FD_SET(static_cast<Socket>(connection), &writable);
+    FD_SET(static_cast<Socket>(connection), &failed);
+    timeval immediately = { 0, 0 };
+    int ready = select(static_cast<int>(connection) + 1, NULL, &writable, &failed, &immediately);
+    if (ready > 0 && FD_ISSET(static_cast<Socket>(connection), &failed)) {
+        Disconnect();
+        return false;
+    }
+    if (ready <= 0) {
+        // A handshake the collector host never answers is only retried by TCP for minutes
+        if (connectStarted == 0) connectStarted = now;
+        else if (now - connectStarted >= CONNECT_TIMEOUT) Disconnect();
+        return false;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(static_cast<Socket>(connection), SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length);
+    if (error != 0) {
+        Disconnect();
+        return false;
+    }
+    connected = true;
+    return true;
+}
+
+
+void MetricExporter::Disconnect() {
+    if (connection != -1) CloseSocket(static_cast<Socket>(connection));
+    connection = -1;
+    connected = false;
+}
+
+
+size_t MetricExporter::Format(int64_t timestamp, const double* values) {
+    char* out = buffer.data();
+    size_t length = 0;
+    bool first = true;
+
+    if (format == EXPORT_INFLUX) {
+        length += snprintf(out, buffer.size(), "cpugpu,host=%s ", host.c_str());
+    }
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (isnan(values[i])) continue;
+        if (format == EXPORT_STATSD) {
+            memcpy(out + length, "cpugpu.", 7);
+            length += 7;
+            length += FormatMetricKey(i, '.', out + length);
+            length += snprintf(out + length, LINE_SIZE, ":%.10g|g\n", values[i]);
+        }
+        else {
+            if (!first) out[length++] = ',';
+            length += FormatMetricKey(i, '_', out + length);
+            length += snprintf(out + length, LINE_SIZE, "=%.10g", values[i]);
+        }
+        first = false;
+    }
+    if (format == EXPORT_INFLUX) {
+        if (first) return 0;    // A line needs at least one field
+        length += snprintf(out + length, 32, " %lld000000000\n", static_cast<long long>(timestamp));
+    }
+    return length;
+}
+
+
+bool MetricExporter::Push(int64_t timestamp, const double* values) {
+    if (!opened || !Connect(timestamp)) return false;
+    size_t length = Format(timestamp, values);
+    const char* data = buffer.data();
+
+    if (tcp) {
+        // A partial write would cut a line, so the connection is started over and the rest dropped
+#ifdef _WIN32
+        long sent = static_cast<long>(send(static_cast<Socket>(connection), data, static_cast<int>(length), 0));
+#else
+        // A collector that closed the connection must not raise SIGPIPE in the sampling process
+        long sent = static_cast<long>(send(static_cast<Socket>(connection), data, length, MSG_NOSIGNAL));
+#endif
+        if (sent != static_cast<long>(length)) {
+            Disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    // Datagrams end at line ends so the collector never sees a split metric
+    bool complete = true;
+    size_t start = 0;
+    while (start < length) {
+        size_t end = start;
+        for (size_t next = start; next < length && next - start < PACKET_SIZE; next++) {
+            if (data[next] == '\n') end = next + 1;
+        }
+        if (end == start) end = length;     // A single line longer than a packet
+        if (sendto(static_cast<Socket>(connection), data + start, static_cast<int>(end - start), 0,
+            reinterpret_cast<const sockaddr*>(address.data()), static_cast<int>(address.size())) < 0) {
+            complete = false;
+        }
+        start = end;
+    }
+    return complete;
+}
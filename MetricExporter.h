@@ -0,0 +1,58 @@
+// Push of the sampled metrics to a local collector such as Telegraf or a StatsD daemon.
+// Every push formats all available metrics into a buffer allocated when the exporter is opened,
+// as StatsD gauges ("cpugpu.cpu.load:42|g") or one InfluxDB line ("cpugpu,host=PC cpu_load=42,...")
+// and sends it over UDP in datagrams split at line ends, or over TCP. Sockets are non-blocking:
+// a sample that cannot be sent at once is dropped, and a broken TCP connection, or one still not
+// established CONNECT_TIMEOUT seconds of samples after the first push that waited for it, is
+// reopened by a later push, so the caller never waits for the collector.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+enum ExportFormat {
+    EXPORT_STATSD,
+    EXPORT_INFLUX
+};
+
+
+class MetricExporter {
+public:
+    static const size_t PACKET_SIZE = 1400;     // Datagram payload that fits common MTUs
+    static const int CONNECT_TIMEOUT = 3;       // Seconds a TCP connection may stay in progress
+
+    MetricExporter() {}
+    ~MetricExporter() { Close(); }
+
+    // Open "udp://host:port" or "tcp://host:port" (udp if the scheme is left out); 'host' tags the Influx lines
+    bool Open(const char* address, ExportFormat format, const char* host);
+    void Close();
+    bool IsOpen() const { return opened; }
+
+    // Send the METRIC_COUNT values of a sample taken at Unix time 'timestamp'; unavailable (NAN)
+    // values are skipped. Returns false if the sample was dropped
+    bool Push(int64_t timestamp, const double* values);
+
+    // Format a sample into the buffer; returns the number of bytes
+    size_t Format(int64_t timestamp, const double* values);
+    const char* Buffer() const { return buffer.data(); }
+
+private:
+    // 'now' is the Unix time of the pushed sample, 0 when opening
+    bool Connect(int64_t now);
+    void Disconnect();
+
+    bool opened = false;
+    bool tcp = false;
+    bool connected = false;
+    ExportFormat format = EXPORT_STATSD;
+    std::string host;
+    std::vector<char> buffer;
+    std::vector<uint8_t> address;   // sockaddr of the collector
+    intptr_t connection = -1;      // Socket, -1 while closed
+    int64_t connectStarted = 0;     // Time of the first push that found the connection in progress
+};
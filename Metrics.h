@@ -0,0 +1,149 @@
+// Registry of the metrics sampled into the plugin history.
+// The order of the enumeration is the order of the series in the history store.
+
+#pragma once
+
+#include <ctype.h>
+#include <string.h>
+
+
+enum Metric {
+    METRIC_CPU_LOAD,
+    METRIC_CPU_POWER,
+    METRIC_CPU_TEMP,
+    METRIC_CPU_FAN_RPM,
+    METRIC_CPU_FAN,
+    METRIC_CPU_CLOCK,
+    METRIC_CPU_LIMIT,
+    METRIC_CPU_IPC,
+    METRIC_CPU_LLC_MISS,
+    METRIC_CPU_INSTR,
+    METRIC_GPU_LOAD,
+    METRIC_GPU_POWER,
+    METRIC_GPU_LIMIT,
+    METRIC_GPU_TEMP,
+    METRIC_GPU_FAN,
+    METRIC_GPU_CLOCK,
+    METRIC_GPU_MEM_CLOCK,
+    METRIC_GPU_MEM_ALLOC,
+    METRIC_GPU_MEM_USAGE,
+    METRIC_MEM_USED,
+    METRIC_MEM_AVAILABLE,
+    METRIC_MEM_USAGE,
+    METRIC_MEM_CACHED,
+    METRIC_MEM_SWAP,
+    METRIC_MEM_SWAP_USAGE,
+    METRIC_MEM_FAULTS,
+    METRIC_DISK_READ,
+    METRIC_DISK_WRITE,
+    METRIC_DISK_READ_IOPS,
+    METRIC_DISK_WRITE_IOPS,
+    METRIC_DISK_UTIL,
+    METRIC_DISK_TEMP,
+    METRIC_NET_RX,
+    METRIC_NET_TX,
+    METRIC_COUNT
+};
+
+
+// Plugin function group a metric belongs to
+enum MetricGroup {
+    GROUP_CPU = 1,  // function1
+    GROUP_GPU = 2,  // function2
+    GROUP_MEM = 3,  // function3
+    GROUP_DISK = 4, // function4
+    GROUP_NET = 5   // function5
+};
+
+
+// Lowercase prefix of the metrics of each MetricGroup in exported names
+static const char* const GROUP_KEYS[] = { "", "cpu", "gpu", "mem", "disk", "net" };
+
+
+struct MetricInfo {
+    MetricGroup group;
+    const char* name;       // param1 name in the plugin function
+    const char* unit;       // Unit suffix shown when param2=1
+    double scale;           // Display value = sampled value * scale
+    int decimals;           // Digits after the decimal point when displayed
+};
+
+
+// Sampled values are kept in the units of the getters (MHz, W, bytes, ...)
+static const MetricInfo METRICS[METRIC_COUNT] = {
+    { GROUP_CPU, "Load",      "%",    1.0,    0 },
+    { GROUP_CPU, "Power",     "W",    1.0,    0 },
+    { GROUP_CPU, "Temp",      "\xB0" "C", 1.0, 0 },
+    { GROUP_CPU, "Fan_RPM",   "RPM",  1.0,    0 },
+    { GROUP_CPU, "Fan",       "%",    1.0,    0 },
+    { GROUP_CPU, "Clock",     "GHz",  0.001,  2 },
+    { GROUP_CPU, "Limit",     "",     1.0,    2 },
+    { GROUP_CPU, "IPC",       "",     1.0,    2 },
+    { GROUP_CPU, "LLC_Miss",  "%",    1.0,    1 },
+    { GROUP_CPU, "Instr",     "G/s",  1e-9,   2 },
+    { GROUP_GPU, "Load",      "%",    1.0,    0 },
+    { GROUP_GPU, "Power",     "W",    1.0,    0 },
+    { GROUP_GPU, "Limit",     "",     1.0,    2 },
+    { GROUP_GPU, "Temp",      "\xB0" "C", 1.0, 0 },
+    { GROUP_GPU, "Fan",       "%",    1.0,    0 },
+    { GROUP_GPU, "Clock",     "GHz",  0.001,  2 },
+    { GROUP_GPU, "Mem_Clock", "GHz",  0.001,  2 },
+    { GROUP_GPU, "Mem_Alloc", "Gb",   1.0 / (1024 * 1024 * 1024), 1 },
+    { GROUP_GPU, "Mem_Usage", "%",    1.0,    0 },
+    { GROUP_MEM, "Used",      "Gb",   1.0 / (1024 * 1024 * 1024), 1 },
+    { GROUP_MEM, "Available", "Gb",   1.0 / (1024 * 1024 * 1024), 1 },
+    { GROUP_MEM, "Usage",     "%",    1.0,    0 },
+    { GROUP_MEM, "Cached",    "Gb",   1.0 / (1024 * 1024 * 1024), 1 },
+    { GROUP_MEM, "Swap",      "Gb",   1.0 / (1024 * 1024 * 1024), 1 },
+    { GROUP_MEM, "Swap_Usage", "%",   1.0,    0 },
+    { GROUP_MEM, "Faults",    "/s",   1.0,    0 },
+    { GROUP_DISK, "Read",     "MB/s", 1.0 / (1024 * 1024), 1 },
+    { GROUP_DISK, "Write",    "MB/s", 1.0 / (1024 * 1024), 1 },
+    { GROUP_DISK, "Read_IOPS", "/s",  1.0,    0 },
+    { GROUP_DISK, "Write_IOPS", "/s", 1.0,    0 },
+    { GROUP_DISK, "Util",     "%",    1.0,    0 },
+    { GROUP_DISK, "Temp",     "\xB0" "C", 1.0, 0 },
+    { GROUP_NET, "Rx",        "MB/s", 1.0 / (1024 * 1024), 2 },
+    { GROUP_NET, "Tx",        "MB/s", 1.0 / (1024 * 1024), 2 },
+};
+
+
+// Find a metric by group and param1 name; returns METRIC_COUNT if there is none
+inline int FindMetric(MetricGroup group, const char* name, size_t nameLength) {
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (METRICS[i].group == group && strncmp(METRICS[i].name, name, nameLength) == 0 &&
+            METRICS[i].name[nameLength] == '\0') {
+            return i;
+        }
+    }
+    return METRIC_COUNT;
+}
+
+
+// Metric behind each value of the snapshot API and subscription stream (SnapshotApi.h);
+// the layout only grows, while the Metric enumeration may be reordered
+static const int SNAPSHOT_METRICS[] = {
+    METRIC_CPU_LOAD, METRIC_CPU_POWER, METRIC_CPU_TEMP, METRIC_CPU_FAN_RPM, METRIC_CPU_FAN, METRIC_CPU_CLOCK,
+    METRIC_CPU_LIMIT, METRIC_CPU_IPC, METRIC_CPU_LLC_MISS, METRIC_CPU_INSTR,
+    METRIC_GPU_LOAD, METRIC_GPU_POWER, METRIC_GPU_LIMIT, METRIC_GPU_TEMP, METRIC_GPU_FAN, METRIC_GPU_CLOCK,
+    METRIC_GPU_MEM_CLOCK, METRIC_GPU_MEM_ALLOC, METRIC_GPU_MEM_USAGE,
+    METRIC_MEM_USED, METRIC_MEM_AVAILABLE, METRIC_MEM_USAGE, METRIC_MEM_CACHED, METRIC_MEM_SWAP,
+    METRIC_MEM_SWAP_USAGE, METRIC_MEM_FAULTS,
+    METRIC_DISK_READ, METRIC_DISK_WRITE, METRIC_DISK_READ_IOPS, METRIC_DISK_WRITE_IOPS, METRIC_DISK_UTIL,
+    METRIC_DISK_TEMP,
+    METRIC_NET_RX, METRIC_NET_TX,
+};
+static const int SNAPSHOT_VALUE_COUNT = sizeof(SNAPSHOT_METRICS) / sizeof(SNAPSHOT_METRICS[0]);
+
+
+// Write the lowercase "<group><separator><name>" of a metric for exporters, e.g. "gpu_mem_clock"; returns its length
+inline size_t FormatMetricKey(int metric, char separator, char* out) {
+    const MetricInfo& info = METRICS[metric];
+    size_t length = strlen(GROUP_KEYS[info.group]);
+    memcpy(out, GROUP_KEYS[info.group], length);
+    out[length++] = separator;
+    for (const char* p = info.name; *p != '\0'; p++) {
+        out[length++] = static_cast<char>(tolower(static_cast<unsigned char>(*p)));
+    }
+    return length;
+}
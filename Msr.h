@@ -0,0 +1,26 @@
+// Access to model-specific registers of individual logical processors.
+// The plugin reads MSRs through the WinRing0 driver already loaded by LibreHardwareMonitor;
+// the engines that consume MSRs only see this interface.
+
+#pragma once
+
+#include <stdint.h>
+
+
+// Well-known MSR indices
+static const uint32_t MSR_TIME_STAMP_COUNTER = 0x10;
+static const uint32_t MSR_MPERF = 0xE7;     // Counts at the base frequency while in C0
+static const uint32_t MSR_APERF = 0xE8;     // Counts at the actual frequency while in C0
+
+
+class MsrReader {
+public:
+    virtual ~MsrReader() {}
+
+    // Number of logical processors that can be addressed
+    virtual int ProcessorCount() const = 0;
+    // Read 'count' registers of one logical processor in a single batch; returns false if any read fails
+    virtual bool Read(int processor, const uint32_t* indices, int count, uint64_t* values) = 0;
+    // Write one register of one logical processor; returns false if writing is unsupported or fails
+    virtual bool Write(int /*processor*/, uint32_t /*index*/, uint64_t /*value*/) { return false; }
+};
@@ -0,0 +1,68 @@
+// One pinned MSR pass per logical processor and tick, see MsrBatch.h
+
+#include "MsrBatch.h"
+
+#include <algorithm>
+
+
+void BatchedMsrReader::Learn(std::vector<uint32_t>* set, uint32_t index) {
+    if (std::find(set->begin(), set->end(), index) == set->end()) set->push_back(index);
+}
+
+
+void BatchedMsrReader::BeginPass() {
+    int count = (reader != NULL) ? reader->ProcessorCount() : 0;
+    if (static_cast<int>(processors.size()) != count) processors.assign(count, Processor());
+
+    for (int i = 0; i < count; i++) {
+        Processor& processor = processors[i];
+        processor.indices.swap(processor.used);
+        processor.used.clear();
+        processor.values.resize(processor.indices.size());
+        processor.fetched = !processor.indices.empty()
+            && reader->Read(i, processor.indices.data(), static_cast<int>(processor.indices.size()), processor.values.data());
+        if (!processor.fetched) processor.indices.clear();   // Relearn from the reads of this pass
+    }
+    active = true;
+}
+
+
+void BatchedMsrReader::EndPass() {
+    active = false;
+}
+
+
+int BatchedMsrReader::ProcessorCount() const {
+    return (reader != NULL) ? reader->ProcessorCount() : 0;
+}
+
+
+bool BatchedMsrReader::Read(int processor, const uint32_t* indices, int count, uint64_t* values) {
+    if (reader == NULL) return false;
+    if (!active || processor < 0 || processor >= static_cast<int>(processors.size())) {
+        return reader->Read(processor, indices, count, values);
+    }
+
+    Processor& state = processors[processor];
+    bool cached = state.fetched;
+    for (int i = 0; i < count && cached; i++) {
+        std::vector<uint32_t>::const_iterator found = std::find(state.indices.begin(), state.indices.end(), indices[i]);
+        if (found == state.indices.end()) {
+            cached = false;
+        }
+        else {
+            values[i] = state.values[found - state.indices.begin()];
+        }
+    }
+    if (!cached && !reader->Read(processor, indices, count, values)) return false;
+
+    for (int i = 0; i < count; i++) Learn(&state.used, indices[i]);
+    return true;
+}
+
+
+bool BatchedMsrReader::Write(int processor, uint32_t index, uint64_t value) {
+    if (reader == NULL) return false;
+    if (processor >= 0 && processor < static_cast<int>(processors.size())) processors[processor].fetched = false;
+    return reader->Write(processor, index, value);
+}
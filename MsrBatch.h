@@ -0,0 +1,45 @@
+// One pinned MSR pass per logical processor and tick.
+// The clock, throttle, performance counter and C-state engines each read their registers of every
+// processor in their own batch, so a tick used to pin the thread to each processor several times.
+// BatchedMsrReader sits between the engines and the real reader: during a pass it serves reads from
+// values fetched at the start of the pass, one batch per processor holding every register that was
+// read successfully in the previous pass. Registers not fetched yet are read through and learned
+// for the next pass, so the engines need no changes and an engine that stops reading a register
+// drops it from the next pass.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Msr.h"
+
+
+class BatchedMsrReader : public MsrReader {
+public:
+    explicit BatchedMsrReader(MsrReader* reader) : reader(reader) {}
+
+    // Start a pass: read the registers learned in the previous pass on every processor
+    void BeginPass();
+    // End the pass; later reads go straight to the underlying reader
+    void EndPass();
+
+    int ProcessorCount() const override;
+    bool Read(int processor, const uint32_t* indices, int count, uint64_t* values) override;
+    // Writes go through and drop the fetched values of the processor
+    bool Write(int processor, uint32_t index, uint64_t value) override;
+
+private:
+    struct Processor {
+        std::vector<uint32_t> indices;      // Fetched at the start of the pass
+        std::vector<uint64_t> values;
+        std::vector<uint32_t> used;         // Read successfully during the pass, fetched in the next one
+        bool fetched = false;
+    };
+
+    static void Learn(std::vector<uint32_t>* set, uint32_t index);
+
+    MsrReader* reader;
+    bool active = false;
+    std::vector<Processor> processors;
+};
@@ -0,0 +1,176 @@
+// Hardware performance counters, see PerfCounters.h
+
+#include "PerfCounters.h"
+
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+
+static const uint32_t MSR_PMC0 = 0xC1;
+static const uint32_t MSR_PMC1 = 0xC2;
+static const uint32_t MSR_PERFEVTSEL0 = 0x186;
+static const uint32_t MSR_PERFEVTSEL1 = 0x187;
+static const uint32_t MSR_FIXED_CTR0 = 0x309;     // Instructions retired
+static const uint32_t MSR_FIXED_CTR1 = 0x30A;     // Unhalted core cycles
+static const uint32_t MSR_FIXED_CTR_CTRL = 0x38D;
+static const uint32_t MSR_PERF_GLOBAL_CTRL = 0x38F;
+
+// Architectural events: LLC references (0x2E/0x4F) and misses (0x2E/0x41), counted in user and
+// kernel mode with the enable bit set
+static const uint64_t EVENT_LLC_REFERENCES = 0x2E | (0x4F << 8) | (1 << 16) | (1 << 17) | (1 << 22);
+static const uint64_t EVENT_LLC_MISSES = 0x2E | (0x41 << 8) | (1 << 16) | (1 << 17) | (1 << 22);
+static const uint64_t EVENT_ENABLE = 1ull << 22;
+static const uint64_t FIXED_ENABLE = 0x33;                  // Fixed counters 0 and 1 in user and kernel mode
+static const uint64_t FIXED_CONTROL_MASK = 0xFF;            // Control bits of fixed counters 0 and 1
+static const uint64_t GLOBAL_ENABLE = 0x3 | (0x3ull << 32); // PMC0, PMC1, fixed counters 0 and 1
+static const int DEFAULT_WIDTH = 40;                        // Narrowest width of any PMU version 2, if CPUID reports none
+
+
+// Mask of the bits of a counter 'width' bits wide
+static uint64_t WidthMask(int width) {
+    if (width <= 0) width = DEFAULT_WIDTH;
+    return (width >= 64) ? ~0ull : (1ull << width) - 1;
+}
+
+
+int PerfCounters::ReadPmuInfo(int* generalCounters, int* generalWidth, int* fixedCounters, int* fixedWidth) {
+    int regs[4] = { 0, 0, 0, 0 };
+    char vendor[13];
+#ifdef _MSC_VER
+    __cpuid(regs, 0);
+#else
+    __cpuid(0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    memcpy(vendor, &regs[1], 4);
+    memcpy(vendor + 4, &regs[3], 4);
+    memcpy(vendor + 8, &regs[2], 4);
+    vendor[12] = '\0';
+    if (strcmp(vendor, "GenuineIntel") != 0 || regs[0] < 0xA) return 0;
+
+#ifdef _MSC_VER
+    __cpuid(regs, 0xA);
+#else
+    __cpuid(0xA, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    *generalCounters = (regs[0] >> 8) & 0xFF;
+    *generalWidth = (regs[0] >> 16) & 0xFF;
+    *fixedCounters = regs[3] & 0x1F;
+    *fixedWidth = (regs[3] >> 5) & 0xFF;
+    return regs[0] & 0xFF;
+}
+
+
+bool PerfCounters::Supported() {
+    int generalCounters = 0, generalWidth = 0, fixedCounters = 0, fixedWidth = 0;
+    int version = ReadPmuInfo(&generalCounters, &generalWidth, &fixedCounters, &fixedWidth);
+    return version >= 2 && generalCounters >= 2 && fixedCounters >= 2;
+}
+
+
+bool PerfCounters::Start() {
+    if (started) return true;
+    if (failed || reader == NULL) return false;
+
+    int generalCounters = 0, generalWidth = 0, fixedCounters = 0, fixedWidth = 0;
+    ReadPmuInfo(&generalCounters, &generalWidth, &fixedCounters, &fixedWidth);
+    generalMask = WidthMask(generalWidth);
+    fixedMask = WidthMask(fixedWidth);
+
+    int count = reader->ProcessorCount();
+    static const uint32_t controls[4] = { MSR_PERFEVTSEL0, MSR_PERFEVTSEL1, MSR_FIXED_CTR_CTRL, MSR_PERF_GLOBAL_CTRL };
+    savedGlobal.assign(count, 0);
+    for (int i = 0; i < count; i++) {
+        uint64_t values[4];
+        if (!reader->Read(i, controls, 4, values)) {
+            failed = true;
+            return false;
+        }
+        // Take over counters carrying our own event selection, leave alone those another tool has enabled
+        bool ours = values[0] == EVENT_LLC_REFERENCES && values[1] == EVENT_LLC_MISSES
+            && (values[2] & FIXED_CONTROL_MASK) == FIXED_ENABLE;
+        if (!ours && ((values[0] & EVENT_ENABLE) || (values[1] & EVENT_ENABLE) || (values[2] & FIXED_CONTROL_MASK))) {
+            failed = true;
+            return false;
+        }
+        // Counters taken over were enabled by us, so Stop leaves them disabled
+        savedGlobal[i] = ours ? values[3] & ~GLOBAL_ENABLE : values[3];
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!reader->Write(i, MSR_PERFEVTSEL0, EVENT_LLC_REFERENCES)
+            || !reader->Write(i, MSR_PERFEVTSEL1, EVENT_LLC_MISSES)
+            || !reader->Write(i, MSR_FIXED_CTR_CTRL, FIXED_ENABLE)
+            || !reader->Write(i, MSR_PERF_GLOBAL_CTRL, savedGlobal[i] | GLOBAL_ENABLE)) {
+            started = true;     // Undo whatever was programmed so far
+            Stop();
+            failed = true;
+            return false;
+        }
+    }
+
+    previous.assign(count, Counters());
+    started = true;
+    primed = false;
+    return true;
+}
+
+
+void PerfCounters::Stop() {
+    if (!started) return;
+    for (size_t i = 0; i < savedGlobal.size(); i++) {
+        int processor = static_cast<int>(i);
+        reader->Write(processor, MSR_PERFEVTSEL0, 0);
+        reader->Write(processor, MSR_PERFEVTSEL1, 0);
+        reader->Write(processor, MSR_FIXED_CTR_CTRL, 0);
+        reader->Write(processor, MSR_PERF_GLOBAL_CTRL, savedGlobal[i]);
+    }
+    started = false;
+    primed = false;
+    valid = false;
+}
+
+
+void PerfCounters::Forget() {
+    started = false;
+    primed = false;
+    valid = false;
+}
+
+
+bool PerfCounters::Update(double seconds) {
+    if (!Start()) {
+        valid = false;
+        return false;
+    }
+
+    static const uint32_t indices[4] = { MSR_FIXED_CTR0, MSR_FIXED_CTR1, MSR_PMC0, MSR_PMC1 };
+    Counters total = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < previous.size(); i++) {
+        uint64_t values[4];
+        if (!reader->Read(static_cast<int>(i), indices, 4, values)) {
+            valid = false;
+            primed = false;
+            return false;
+        }
+
+        Counters current = { values[0], values[1], values[2], values[3] };
+        total.instructions += (current.instructions - previous[i].instructions) & fixedMask;
+        total.cycles += (current.cycles - previous[i].cycles) & fixedMask;
+        total.llcReferences += (current.llcReferences - previous[i].llcReferences) & generalMask;
+        total.llcMisses += (current.llcMisses - previous[i].llcMisses) & generalMask;
+        previous[i] = current;
+    }
+
+    if (primed && seconds > 0.0) {
+        ipc = (total.cycles > 0) ? static_cast<double>(total.instructions) / total.cycles : 0.0;
+        llcMissRate = (total.llcReferences > 0) ? 100.0 * total.llcMisses / total.llcReferences : 0.0;
+        instructionsPerSecond = total.instructions / seconds;
+        valid = true;
+    }
+    primed = true;
+    return true;
+}
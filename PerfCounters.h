@@ -0,0 +1,63 @@
+// Hardware performance counters: instructions per cycle, last-level cache miss rate and instruction
+// throughput, to tell compute-bound from memory-bound load.
+// Uses the architectural PMU of Intel CPUs: fixed counters for instructions retired and unhalted
+// core cycles, and two general-purpose counters for LLC references and misses. Counters that are
+// already programmed by another tool (a profiler, another monitor) are left alone and the metrics
+// stay unavailable; counters carrying exactly this module's own event selection (left behind by a
+// killed instance, or shared between the plugin and the daemon) are taken over. IA32_PERF_GLOBAL_CTRL
+// is restored on Stop, less the enable bits of counters taken over. Counter widths come from CPUID leaf 0AH. All counters of a processor are read
+// in one batch per tick.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Msr.h"
+
+
+class PerfCounters {
+public:
+    explicit PerfCounters(MsrReader* reader) : reader(reader) {}
+
+    // Check for an Intel CPU with architectural performance monitoring version 2 or later
+    static bool Supported();
+
+    // Program the counters on all logical processors; returns false if they are unavailable or in use
+    bool Start();
+    // Disable the counters programmed by Start and restore the global control register
+    void Stop();
+    // Drop the counters without touching them, when another instance (the daemon) has taken them over
+    void Forget();
+    // Sample the counters, 'seconds' being the time since the previous call; returns false on failure
+    bool Update(double seconds);
+
+    bool Valid() const { return valid; }
+    double Ipc() const { return ipc; }
+    double LlcMissRate() const { return llcMissRate; }          // Percent of LLC references
+    double InstructionsPerSecond() const { return instructionsPerSecond; }
+
+private:
+    struct Counters {
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t llcReferences;
+        uint64_t llcMisses;
+    };
+
+    // Read the number and width of the counters from CPUID leaf 0AH; returns the PMU version
+    static int ReadPmuInfo(int* generalCounters, int* generalWidth, int* fixedCounters, int* fixedWidth);
+
+    MsrReader* reader;
+    bool started = false;
+    bool failed = false;        // Counters unavailable or owned by another tool, do not retry
+    bool primed = false;
+    bool valid = false;
+    std::vector<Counters> previous;
+    std::vector<uint64_t> savedGlobal;          // IA32_PERF_GLOBAL_CTRL per processor before Start
+    uint64_t generalMask = 0;                   // Counters wrap at their width
+    uint64_t fixedMask = 0;
+    double ipc = 0.0;
+    double llcMissRate = 0.0;
+    double instructionsPerSecond = 0.0;
+};
@@ -0,0 +1,98 @@
+// Time-to-throttle prediction, see Predict.h
+
+#include "Predict.h"
+
+#include <math.h>
+#include <string.h>
+
+
+static const double FORGETTING = 0.998;         // Weight of past samples per update, ~500 sample memory
+static const double INITIAL_COVARIANCE = 1000.0;
+static const double MAX_COVARIANCE_TRACE = 1e6;
+static const int MIN_SAMPLES = 60;              // Samples before predictions are trusted
+
+
+ThermalPredictor::ThermalPredictor() {
+    memset(theta, 0, sizeof(theta));
+    memset(covariance, 0, sizeof(covariance));
+    for (int i = 0; i < FEATURES; i++) covariance[i][i] = INITIAL_COVARIANCE;
+}
+
+
+void ThermalPredictor::Update(int64_t timestamp, double temperature, double power) {
+    if (temperature != temperature || power != power) return;   // Skip unavailable samples
+
+    if (samples == 0 || timestamp <= lastTimestamp || timestamp - lastTimestamp > 60) {
+        // First sample or a gap in the data: restart the derivative, keep the model
+        lastTimestamp = timestamp;
+        lastTemperature = temperature;
+        lastPower = power;
+        if (samples == 0) samples = 1;
+        return;
+    }
+
+    // Regress the temperature slope on the state at the start of the interval
+    double dt = static_cast<double>(timestamp - lastTimestamp);
+    double x[FEATURES] = { 1.0, lastPower, lastTemperature };
+    double y = (temperature - lastTemperature) / dt;
+
+    // Gain k = P x / (lambda + x' P x)
+    double px[FEATURES];
+    double denominator = FORGETTING;
+    for (int i = 0; i < FEATURES; i++) {
+        px[i] = 0.0;
+        for (int j = 0; j < FEATURES; j++) px[i] += covariance[i][j] * x[j];
+        denominator += x[i] * px[i];
+    }
+
+    double error = y;
+    for (int i = 0; i < FEATURES; i++) error -= theta[i] * x[i];
+
+    double gain[FEATURES];
+    for (int i = 0; i < FEATURES; i++) {
+        gain[i] = px[i] / denominator;
+        theta[i] += gain[i] * error;
+    }
+
+    // P = (P - k x' P) / lambda; forgetting is suspended while the covariance is large so that
+    // it does not wind up during long steady phases that carry no new information
+    double trace = 0.0;
+    for (int i = 0; i < FEATURES; i++) trace += covariance[i][i];
+    double forgetting = (trace < MAX_COVARIANCE_TRACE) ? FORGETTING : 1.0;
+    for (int i = 0; i < FEATURES; i++) {
+        for (int j = 0; j < FEATURES; j++) {
+            covariance[i][j] = (covariance[i][j] - gain[i] * px[j]) / forgetting;
+        }
+    }
+
+    lastTimestamp = timestamp;
+    lastTemperature = temperature;
+    lastPower = power;
+    samples++;
+}
+
+
+int ThermalPredictor::SecondsToLimit(double limit) const {
+    if (samples < MIN_SAMPLES) return UNKNOWN;
+    if (lastTemperature >= limit) return 0;
+
+    double drive = theta[0] + theta[1] * lastPower;     // Heating at the current power
+    double cooling = theta[2];                          // Should be negative for a cooled device
+    double seconds;
+
+    if (cooling < -1e-6) {
+        // Exponential approach to the steady state T_inf = -drive / cooling
+        double steady = -drive / cooling;
+        if (steady <= limit) return UNKNOWN;
+        seconds = log((limit - steady) / (lastTemperature - steady)) / cooling;
+    }
+    else {
+        // No cooling identified (yet): extrapolate the current slope
+        double slope = drive + cooling * lastTemperature;
+        if (slope <= 0.0) return UNKNOWN;
+        seconds = (limit - lastTemperature) / slope;
+    }
+
+    if (seconds != seconds || seconds > HORIZON) return UNKNOWN;
+    return static_cast<int>(seconds + 0.5);
+}
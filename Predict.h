@@ -0,0 +1,34 @@
+// Online prediction of the time left until a device reaches its thermal limit.
+// The heating of a device is modeled as a first-order system
+//     dT/dt = a + b * P + c * T
+// (heat in proportional to power P, heat out proportional to temperature T). The coefficients
+// are fitted by recursive least squares with exponential forgetting, which costs O(1) per sample
+// and follows changes of fan curves and ambient temperature.
+
+#pragma once
+
+#include <stdint.h>
+
+
+class ThermalPredictor {
+public:
+    static const int UNKNOWN = -1;      // Not enough samples yet, or the limit is not approached
+    static const int HORIZON = 3600;    // Predictions further ahead are reported as UNKNOWN
+
+    ThermalPredictor();
+
+    // Feed one sample; samples must be at least one second apart
+    void Update(int64_t timestamp, double temperature, double power);
+    // Seconds until temperature reaches 'limit' if power stays at its current level
+    int SecondsToLimit(double limit) const;
+
+private:
+    static const int FEATURES = 3;
+
+    double theta[FEATURES];             // Model coefficients a, b, c
+    double covariance[FEATURES][FEATURES];
+    int64_t lastTimestamp = 0;
+    double lastTemperature = 0.0;
+    double lastPower = 0.0;
+    int samples = 0;
+};
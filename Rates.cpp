@@ -0,0 +1,27 @@
+// Counter rates, see Rates.h
+
+#include "Rates.h"
+
+
+bool RateTracker::Update(uint64_t value, double seconds) {
+    value &= mask;
+    bool updated = false;
+    if (primed && seconds > lastSeconds) {
+        if (wide && value < lastValue) {
+            valid = false;  // Counter reset, start over from this reading
+        }
+        else {
+            uint64_t delta = (value - lastValue) & mask;
+            rate = static_cast<double>(delta) / (seconds - lastSeconds);
+            valid = true;
+            updated = true;
+        }
+    }
+
+    if (!primed || seconds > lastSeconds) {
+        lastValue = value;
+        lastSeconds = seconds;
+        primed = true;
+    }
+    return updated;
+}
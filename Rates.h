@@ -0,0 +1,30 @@
+// Rates of cumulative counters (bytes transferred, operations completed) over exact sample intervals.
+// The tracker keeps the last reading and its timestamp; narrow counters that wrap around are
+// unwrapped modulo their width, while a 64-bit counter going backwards is treated as a reset
+// (device re-enumerated, driver reloaded) and the interval is skipped.
+
+#pragma once
+
+#include <stdint.h>
+
+
+class RateTracker {
+public:
+    explicit RateTracker(int bits = 64) : mask(bits >= 64 ? ~0ull : (1ull << bits) - 1), wide(bits >= 64) {}
+
+    // Feed the counter value read at 'seconds' on a monotonic clock; returns true if a new rate is known
+    bool Update(uint64_t value, double seconds);
+    void Reset() { primed = false; valid = false; }
+
+    bool Valid() const { return valid; }
+    double Rate() const { return rate; }    // Counter units per second
+
+private:
+    uint64_t mask;
+    bool wide;
+    bool primed = false;
+    bool valid = false;
+    uint64_t lastValue = 0;
+    double lastSeconds = 0.0;
+    double rate = 0.0;
+};
@@ -0,0 +1,365 @@
+// Memory-mapped round-robin history database, see Rrd.h
+
+#include "Rrd.h"
+
+#include <atomic>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// 1 s for 1 hour, 10 s for 1 day, 1 min for 30 days
+const RrdTier RrdFile::TIERS[RrdFile::TIER_COUNT] = {
+    { 1,  3600 },
+    { 10, 8640 },
+    { 60, 43200 },
+};
+
+static const char RRD_MAGIC[8] = { 'C', 'P', 'U', 'G', 'P', 'R', 'R', 'D' };
+static const uint32_t RRD_VERSION = 2;           // Version 1 had no metric names
+static const size_t HEADER_SIZE = 4096;
+
+// File header, followed by the tiers starting at HEADER_SIZE
+struct RrdHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t metricCount;
+    uint32_t slotSize;
+    uint32_t tierCount;
+    RrdTier tiers[RrdFile::TIER_COUNT];
+    char names[RrdFile::MAX_METRICS][RrdFile::NAME_SIZE];   // Metric of each column, since version 2
+};
+
+static_assert(sizeof(RrdHeader) <= HEADER_SIZE, "The header fits in its page");
+
+// Per-metric record inside a slot, after the 8-byte sequence number
+struct RrdRecord {
+    float avg;
+    float min;
+    float max;
+    uint32_t count;
+};
+
+
+static uint64_t LoadSequence(const uint8_t* slot) {
+    return reinterpret_cast<const std::atomic<uint64_t>*>(slot)->load(std::memory_order_acquire);
+}
+
+
+static void StoreSequence(uint8_t* slot, uint64_t sequence) {
+    reinterpret_cast<std::atomic<uint64_t>*>(slot)->store(sequence, std::memory_order_release);
+}
+
+
+// Sequence number of a completely written slot for a bucket; bucket * 2 + 1 marks a write in progress
+static uint64_t CompleteSequence(int64_t bucket) {
+    return static_cast<uint64_t>(bucket) * 2 + 2;
+}
+
+
+bool RrdFile::Map(const char* path, size_t mapSize, bool* created) {
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER currentSize;
+    *created = !GetFileSizeEx(fileHandle, &currentSize) || static_cast<size_t>(currentSize.QuadPart) != mapSize;
+    if (*created) {
+        LARGE_INTEGER newSize;
+        newSize.QuadPart = static_cast<LONGLONG>(mapSize);
+        if (!SetFilePointerEx(fileHandle, newSize, NULL, FILE_BEGIN) || !SetEndOfFile(fileHandle)) {
+            CloseHandle(fileHandle);
+            return false;
+        }
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE,
+        static_cast<DWORD>(static_cast<uint64_t>(mapSize) >> 32), static_cast<DWORD>(mapSize), NULL);
+    void* view = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, mapSize) : NULL;
+    if (view == NULL) {
+        if (mappingHandle) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+    file = fileHandle;
+    mapping = mappingHandle;
+#else
+    int descriptor = open(path, O_RDWR | O_CREAT, 0644);
+    if (descriptor < 0) return false;
+
+    struct stat info;
+    *created = fstat(descriptor, &info) != 0 || static_cast<size_t>(info.st_size) != mapSize;
+    if (*created && ftruncate(descriptor, static_cast<off_t>(mapSize)) != 0) {
+        close(descriptor);
+        return false;
+    }
+
+    void* view = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (view == MAP_FAILED) {
+        close(descriptor);
+        return false;
+    }
+    fd = descriptor;
+#endif
+    base = static_cast<uint8_t*>(view);
+    size = mapSize;
+    return true;
+}
+
+
+bool RrdFile::ReadFile(const char* path, size_t limit, std::vector<uint8_t>* contents) {
+    FILE* input = fopen(path, "rb");
+    if (input == NULL) return false;
+
+    contents->clear();
+    uint8_t buffer[65536];
+    size_t length;
+    while (contents->size() < limit && (length = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+        contents->insert(contents->end(), buffer, buffer + length);
+    }
+    fclose(input);
+    return true;
+}
+
+
+bool RrdFile::Open(const char* path, const char* const* names, int metrics) {
+    Close();
+    if (metrics <= 0 || metrics > MAX_METRICS) return false;
+
+    metricCount = metrics;
+    slotSize = sizeof(uint64_t) + metricCount * sizeof(RrdRecord);
+    size_t offset = HEADER_SIZE;
+    for (int i = 0; i < TIER_COUNT; i++) {
+        tierOffsets[i] = offset;
+        offset += TIERS[i].slots * slotSize;
+        buckets[i] = -1;
+        accumulators[i].assign(metricCount, Accumulator());
+    }
+
+    // A file with another metric set is read before mapping resizes it, to move its columns
+    std::vector<uint8_t> previous;
+    bool migrate = false;
+    if (ReadFile(path, sizeof(RrdHeader), &previous) && previous.size() >= sizeof(RrdHeader)) {
+        const RrdHeader* header = reinterpret_cast<const RrdHeader*>(previous.data());
+        bool sameNames = header->metricCount == static_cast<uint32_t>(metricCount);
+        for (int i = 0; i < metricCount && sameNames; i++) {
+            sameNames = strncmp(header->names[i], names[i], NAME_SIZE) == 0;
+        }
+        migrate = header->version == RRD_VERSION && !sameNames && ReadFile(path, SIZE_MAX, &previous);
+    }
+    if (!migrate) previous.clear();
+
+    bool created;
+    if (!Map(path, offset, &created)) return false;
+
+    const RrdHeader* header = reinterpret_cast<const RrdHeader*>(migrate ? previous.data() : base);
+    bool sameTiers = memcmp(header->magic, RRD_MAGIC, sizeof(RRD_MAGIC)) == 0 &&
+        header->tierCount == TIER_COUNT && memcmp(header->tiers, TIERS, sizeof(TIERS)) == 0;
+    if (migrate && sameTiers && header->metricCount <= MAX_METRICS &&
+        header->slotSize == sizeof(uint64_t) + header->metricCount * sizeof(RrdRecord)) {
+        Migrate(previous, names);
+    }
+    else if (created || !sameTiers || header->version != RRD_VERSION || header->metricCount != static_cast<uint32_t>(metricCount) ||
+        header->slotSize != slotSize) {
+        // A version 1 file of the same size holds the current metrics in order, anything else is reinitialized
+        bool adopt = !created && sameTiers && header->version == 1 &&
+            header->metricCount == static_cast<uint32_t>(metricCount) && header->slotSize == slotSize;
+        if (!adopt) memset(base, 0, size);
+        Initialize(names);
+    }
+    return true;
+}
+
+
+// Write the header of the current layout
+void RrdFile::Initialize(const char* const* names) {
+    RrdHeader* header = reinterpret_cast<RrdHeader*>(base);
+    memcpy(header->magic, RRD_MAGIC, sizeof(RRD_MAGIC));
+    header->version = RRD_VERSION;
+    header->metricCount = metricCount;
+    header->slotSize = static_cast<uint32_t>(slotSize);
+    header->tierCount = TIER_COUNT;
+    memcpy(header->tiers, TIERS, sizeof(TIERS));
+    memset(header->names, 0, sizeof(header->names));
+    for (int i = 0; i < metricCount; i++) {
+        strncpy(header->names[i], names[i], NAME_SIZE - 1);
+    }
+    Flush();
+}
+
+
+// Rebuild the file from the contents of a file with another metric set, moving the columns of the
+// metrics both sets share and leaving the others empty
+void RrdFile::Migrate(const std::vector<uint8_t>& previous, const char* const* names) {
+    const RrdHeader* header = reinterpret_cast<const RrdHeader*>(previous.data());
+    size_t previousSlotSize = header->slotSize;
+    std::vector<int> columns(metricCount, -1);
+    for (int i = 0; i < metricCount; i++) {
+        for (uint32_t j = 0; j < header->metricCount; j++) {
+            if (strncmp(header->names[j], names[i], NAME_SIZE) == 0) columns[i] = static_cast<int>(j);
+        }
+    }
+
+    memset(base, 0, size);
+    size_t previousOffset = HEADER_SIZE;
+    for (int tier = 0; tier < TIER_COUNT; tier++) {
+        for (uint32_t i = 0; i < TIERS[tier].slots; i++) {
+            const uint8_t* from = previous.data() + previousOffset + i * previousSlotSize;
+            if (from + previousSlotSize > previous.data() + previous.size()) break;     // Truncated file
+            uint8_t* to = base + tierOffsets[tier] + i * slotSize;
+
+            const RrdRecord* fromRecords = reinterpret_cast<const RrdRecord*>(from + sizeof(uint64_t));
+            RrdRecord* toRecords = reinterpret_cast<RrdRecord*>(to + sizeof(uint64_t));
+            for (int metric = 0; metric < metricCount; metric++) {
+                if (columns[metric] >= 0) toRecords[metric] = fromRecords[columns[metric]];
+            }
+            memcpy(to, from, sizeof(uint64_t));
+        }
+        previousOffset += TIERS[tier].slots * previousSlotSize;
+    }
+    Initialize(names);
+}
+
+
+void RrdFile::Close() {
+    if (base == NULL) return;
+
+    Flush();
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    mapping = NULL;
+    file = NULL;
+#else
+    munmap(base, size);
+    close(fd);
+    fd = -1;
+#endif
+    base = NULL;
+    size = 0;
+}
+
+
+void RrdFile::Flush() {
+    if (base == NULL) return;
+#ifdef _WIN32
+    FlushViewOfFile(base, 0);
+#else
+    msync(base, size, MS_ASYNC);
+#endif
+}
+
+
+uint8_t* RrdFile::Slot(int tier, int64_t bucket) const {
+    return base + tierOffsets[tier] + static_cast<size_t>(bucket % TIERS[tier].slots) * slotSize;
+}
+
+
+// Start consolidating a new bucket, continuing from the slot if it already holds this bucket
+// (the plugin was restarted within the bucket)
+void RrdFile::ResumeBucket(int tier, int64_t bucket) {
+    buckets[tier] = bucket;
+    const uint8_t* slot = Slot(tier, bucket);
+    bool resume = LoadSequence(slot) == CompleteSequence(bucket);
+    const RrdRecord* records = reinterpret_cast<const RrdRecord*>(slot + sizeof(uint64_t));
+
+    for (int i = 0; i < metricCount; i++) {
+        Accumulator& accumulator = accumulators[tier][i];
+        if (resume && records[i].count > 0) {
+            accumulator.sum = static_cast<double>(records[i].avg) * records[i].count;
+            accumulator.min = records[i].min;
+            accumulator.max = records[i].max;
+            accumulator.count = records[i].count;
+        }
+        else {
+            accumulator.sum = 0.0;
+            accumulator.min = FLT_MAX;
+            accumulator.max = -FLT_MAX;
+            accumulator.count = 0;
+        }
+    }
+}
+
+
+void RrdFile::WriteSlot(int tier, int64_t bucket) {
+    uint8_t* slot = Slot(tier, bucket);
+    RrdRecord* records = reinterpret_cast<RrdRecord*>(slot + sizeof(uint64_t));
+
+    StoreSequence(slot, CompleteSequence(bucket) - 1);
+    for (int i = 0; i < metricCount; i++) {
+        const Accumulator& accumulator = accumulators[tier][i];
+        records[i].avg = accumulator.count ? static_cast<float>(accumulator.sum / accumulator.count) : 0.0f;
+        records[i].min = accumulator.min;
+        records[i].max = accumulator.max;
+        records[i].count = accumulator.count;
+    }
+    StoreSequence(slot, CompleteSequence(bucket));
+}
+
+
+void RrdFile::Update(int64_t timestamp, const double* values) {
+    if (base == NULL || timestamp < 0) return;
+
+    for (int tier = 0; tier < TIER_COUNT; tier++) {
+        int64_t bucket = timestamp / TIERS[tier].step;
+        if (bucket < buckets[tier]) continue;   // Clock went backwards, keep the newer data
+        if (bucket != buckets[tier]) ResumeBucket(tier, bucket);
+
+        for (int i = 0; i < metricCount; i++) {
+            double value = values[i];
+            if (value != value) continue;
+
+            Accumulator& accumulator = accumulators[tier][i];
+            float sample = static_cast<float>(value);
+            accumulator.sum += value;
+            if (sample < accumulator.min) accumulator.min = sample;
+            if (sample > accumulator.max) accumulator.max = sample;
+            accumulator.count++;
+        }
+        WriteSlot(tier, bucket);
+    }
+}
+
+
+bool RrdFile::Aggregate(int metric, int64_t from, int64_t to, HistoryAggregate* out) const {
+    out->min = DBL_MAX;
+    out->max = -DBL_MAX;
+    out->sum = 0.0;
+    out->count = 0;
+    if (base == NULL || metric < 0 || metric >= metricCount || to < from) return false;
+
+    // Use the finest tier whose ring spans the requested range
+    int tier = 0;
+    while (tier < TIER_COUNT - 1 && static_cast<int64_t>(TIERS[tier].step) * TIERS[tier].slots < to - from + 1) {
+        tier++;
+    }
+
+    int64_t step = TIERS[tier].step;
+    int64_t first = from / step;
+    int64_t last = to / step;
+    if (last - first >= TIERS[tier].slots) first = last - TIERS[tier].slots + 1;
+
+    for (int64_t bucket = first; bucket <= last; bucket++) {
+        const uint8_t* slot = Slot(tier, bucket);
+        if (LoadSequence(slot) != CompleteSequence(bucket)) continue;  // Stale, empty or torn slot
+
+        const RrdRecord& record = reinterpret_cast<const RrdRecord*>(slot + sizeof(uint64_t))[metric];
+        if (record.count == 0) continue;
+        if (record.min < out->min) out->min = record.min;
+        if (record.max > out->max) out->max = record.max;
+        out->sum += static_cast<double>(record.avg) * record.count;
+        out->count += record.count;
+    }
+    return out->count > 0;
+}
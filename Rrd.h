@@ -0,0 +1,79 @@
+// Persistent round-robin history database.
+// A fixed-size file is memory-mapped and split into tiers of decreasing resolution
+// (1 s for 1 h, 10 s for 1 day, 1 min for 30 days). Each slot holds avg/min/max of every
+// metric for one time bucket and is rewritten in place as samples arrive. Slots carry a
+// sequence number that is odd while the slot is being written, so a slot torn by a crash
+// is recognized and skipped when the file is opened again. The header names the metric of every
+// column, so a file written with another metric set keeps the history of the metrics both sets
+// share; only a file with other tiers or a damaged header is reinitialized.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "History.h"
+
+
+struct RrdTier {
+    uint32_t step;      // Seconds per slot
+    uint32_t slots;     // Number of slots in the ring
+};
+
+
+class RrdFile {
+public:
+    static const int TIER_COUNT = 3;
+    static const RrdTier TIERS[TIER_COUNT];
+
+    RrdFile() {}
+    ~RrdFile() { Close(); }
+
+    static const int MAX_METRICS = 64;
+    static const int NAME_SIZE = 32;        // Including the terminating zero
+
+    // Open or create the database of the metrics named 'names'; columns of a file written with
+    // other metrics are mapped by name, a file with a different tier layout is reinitialized
+    bool Open(const char* path, const char* const* names, int metricCount);
+    void Close();
+    bool IsOpen() const { return base != NULL; }
+
+    // Consolidate one sample of every metric into all tiers; NaN values are skipped
+    void Update(int64_t timestamp, const double* values);
+    // Aggregate a metric over [from, to] from the finest tier that covers the range
+    bool Aggregate(int metric, int64_t from, int64_t to, HistoryAggregate* out) const;
+    // Write dirty pages to disk
+    void Flush();
+
+private:
+    struct Accumulator {
+        double sum;
+        float min;
+        float max;
+        uint32_t count;
+    };
+
+    uint8_t* Slot(int tier, int64_t bucket) const;
+    void WriteSlot(int tier, int64_t bucket);
+    void ResumeBucket(int tier, int64_t bucket);
+    bool Map(const char* path, size_t size, bool* created);
+    // Read up to about 'limit' bytes of a file
+    static bool ReadFile(const char* path, size_t limit, std::vector<uint8_t>* contents);
+    void Initialize(const char* const* names);
+    void Migrate(const std::vector<uint8_t>& previous, const char* const* names);
+
+    uint8_t* base = NULL;
+    size_t size = 0;
+    int metricCount = 0;
+    size_t slotSize = 0;
+    size_t tierOffsets[TIER_COUNT] = {};
+    int64_t buckets[TIER_COUNT] = {};           // Bucket currently being consolidated per tier
+    std::vector<Accumulator> accumulators[TIER_COUNT];
+#ifdef _WIN32
+    void* file = NULL;
+    void* mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
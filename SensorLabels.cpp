@@ -0,0 +1,91 @@
+// Sensor label rules, see SensorLabels.h
+
+#include "SensorLabels.h"
+
+#include <ctype.h>
+#include <stddef.h>
+
+
+struct SensorRule {
+    SensorKind kind;
+    const char* canonical;
+    const char* label;
+};
+
+
+// Labels used by LibreHardwareMonitor for Intel and AMD CPUs and the Nuvoton, ITE and Fintek chips.
+// The first rule of a canonical name is the name itself
+static const SensorRule RULES[] = {
+    { SENSOR_TEMPERATURE, "Package",  "CPU Package" },
+    { SENSOR_TEMPERATURE, "Package",  "Core (Tctl/Tdie)" },
+    { SENSOR_TEMPERATURE, "Package",  "Core (Tdie)" },
+    { SENSOR_TEMPERATURE, "Package",  "Core (Tctl)" },
+    { SENSOR_TEMPERATURE, "Package",  "Package" },
+    { SENSOR_VOLTAGE,     "VCore",    "VCore" },
+    { SENSOR_VOLTAGE,     "VCore",    "CPU Core" },
+    { SENSOR_VOLTAGE,     "VCore",    "CPU VCore" },
+    { SENSOR_VOLTAGE,     "VCore",    "Core (SVI2 TFN)" },
+    { SENSOR_VOLTAGE,     "VCore",    "Core (SVI3 TFN)" },
+    { SENSOR_VOLTAGE,     "VSoC",     "VSoC" },
+    { SENSOR_VOLTAGE,     "VSoC",     "SoC (SVI2 TFN)" },
+    { SENSOR_VOLTAGE,     "VSoC",     "CPU SoC" },
+    { SENSOR_VOLTAGE,     "VCCSA",    "VCCSA" },
+    { SENSOR_VOLTAGE,     "VCCSA",    "CPU System Agent" },
+    { SENSOR_VOLTAGE,     "VCCIO",    "VCCIO" },
+    { SENSOR_VOLTAGE,     "VCCIO",    "CPU I/O" },
+    { SENSOR_VOLTAGE,     "DRAM",     "DRAM" },
+    { SENSOR_VOLTAGE,     "DRAM",     "VDIMM" },
+    { SENSOR_VOLTAGE,     "DRAM",     "Memory" },
+    { SENSOR_VOLTAGE,     "VTT",      "VTT" },
+    { SENSOR_VOLTAGE,     "12V",      "12V" },
+    { SENSOR_VOLTAGE,     "5V",       "5V" },
+    { SENSOR_VOLTAGE,     "3.3V",     "3.3V" },
+    { SENSOR_VOLTAGE,     "3.3V",     "3VCC" },
+    { SENSOR_VOLTAGE,     "3VSB",     "3VSB" },
+    { SENSOR_VOLTAGE,     "3VSB",     "3.3V Standby" },
+    { SENSOR_VOLTAGE,     "5VSB",     "5VSB" },
+    { SENSOR_VOLTAGE,     "5VSB",     "5V Standby" },
+    { SENSOR_VOLTAGE,     "VBat",     "VBat" },
+    { SENSOR_VOLTAGE,     "VBat",     "CMOS Battery" },
+    { SENSOR_VOLTAGE,     "AVCC",     "AVCC" },
+};
+
+
+// Next character of a label that takes part in the comparison, 0 at the end
+static char NextSignificant(const char*& p) {
+    while (*p == ' ' || *p == '_') p++;
+    if (*p == '\0') return 0;
+    return static_cast<char>(tolower(static_cast<unsigned char>(*p++)));
+}
+
+
+bool SameSensorLabel(const char* a, const char* b) {
+    if (*a == '+') a++;
+    if (*b == '+') b++;
+    for (;;) {
+        char ca = NextSignificant(a);
+        char cb = NextSignificant(b);
+        if (ca != cb) return false;
+        if (ca == 0) return true;
+    }
+}
+
+
+const char* CanonicalSensorName(SensorKind kind, const char* label) {
+    for (size_t i = 0; i < sizeof(RULES) / sizeof(RULES[0]); i++) {
+        if (RULES[i].kind == kind && SameSensorLabel(RULES[i].label, label)) return RULES[i].canonical;
+    }
+    return nullptr;
+}
+
+
+int FindSensor(SensorKind kind, const char* name, const char* const* labels, int count) {
+    for (int i = 0; i < count; i++) {
+        const char* canonical = CanonicalSensorName(kind, labels[i]);
+        if (canonical != nullptr && SameSensorLabel(canonical, name)) return i;
+    }
+    for (int i = 0; i < count; i++) {
+        if (SameSensorLabel(labels[i], name)) return i;
+    }
+    return -1;
+}
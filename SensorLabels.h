@@ -0,0 +1,24 @@
+// Canonical names for the sensors of CPUs and motherboard monitoring chips.
+// Chips and BIOS tables label the same rail or probe differently ("Vcore", "CPU Core",
+// "Core (SVI2 TFN)"); a rules table maps each known label to one canonical name so the
+// plugin params do not depend on the chip vendor.
+
+#pragma once
+
+
+enum SensorKind {
+    SENSOR_TEMPERATURE,
+    SENSOR_VOLTAGE
+};
+
+
+// Map a sensor label to its canonical name, nullptr if no rule matches.
+// Labels are compared ignoring case, spaces, underscores and a leading '+'
+const char* CanonicalSensorName(SensorKind kind, const char* label);
+
+// True if two labels are equal under the same comparison
+bool SameSensorLabel(const char* a, const char* b);
+
+// Index of the sensor a param names among 'count' sensors labelled 'labels': the first whose canonical name
+// is 'name', else the first whose own label is 'name', both compared as above; -1 if there is none
+int FindSensor(SensorKind kind, const char* name, const char* const* labels, int count);
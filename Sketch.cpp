@@ -0,0 +1,149 @@
+// DDSketch quantile sketches, see Sketch.h
+
+#include "Sketch.h"
+
+#include <math.h>
+
+
+const double QuantileSketch::RELATIVE_ACCURACY = 0.005;
+
+static const double MIN_INDEXABLE = 1e-6;    // Smaller values go to the zero bucket
+
+
+QuantileSketch::QuantileSketch() {
+    gamma = (1.0 + RELATIVE_ACCURACY) / (1.0 - RELATIVE_ACCURACY);
+    logGamma = log(gamma);
+}
+
+
+int QuantileSketch::Index(double value) const {
+    return static_cast<int>(ceil(log(value) / logGamma));
+}
+
+
+// Representative value of a bucket, within RELATIVE_ACCURACY of every value counted in it
+double QuantileSketch::Value(int index) const {
+    return 2.0 * pow(gamma, index) / (gamma + 1.0);
+}
+
+
+void QuantileSketch::AddToBucket(int index, uint32_t n) {
+    if (counts.empty()) {
+        offset = index;
+        counts.push_back(0);
+    }
+
+    if (index < offset) {
+        if (offset + static_cast<int>(counts.size()) - index <= MAX_BUCKETS) {
+            // Grow the store downwards
+            counts.insert(counts.begin(), offset - index, 0);
+            offset = index;
+        }
+        else {
+            // Below the capped range: collapse into the lowest bucket
+            index = offset;
+        }
+    }
+    else if (index >= offset + static_cast<int>(counts.size())) {
+        int needed = index - offset + 1;
+        if (needed > MAX_BUCKETS) {
+            // Slide the range up, collapsing the lowest buckets into the new lowest one
+            size_t shift = static_cast<size_t>(needed - MAX_BUCKETS);
+            if (shift > counts.size()) shift = counts.size();
+            uint32_t collapsed = 0;
+            for (size_t i = 0; i < shift; i++) collapsed += counts[i];
+            counts.erase(counts.begin(), counts.begin() + shift);
+            offset = index - MAX_BUCKETS + 1;
+            counts.insert(counts.begin(), counts.empty() ? 1 : 0, 0);
+            counts[0] += collapsed;
+            needed = MAX_BUCKETS;
+        }
+        counts.resize(needed, 0);
+    }
+
+    counts[index - offset] += n;
+}
+
+
+void QuantileSketch::Add(double value) {
+    count++;
+    if (value < MIN_INDEXABLE) {
+        zeroCount++;
+        return;
+    }
+    AddToBucket(Index(value), 1);
+}
+
+
+void QuantileSketch::Merge(const QuantileSketch& other) {
+    count += other.count;
+    zeroCount += other.zeroCount;
+    for (size_t i = 0; i < other.counts.size(); i++) {
+        if (other.counts[i] != 0) AddToBucket(other.offset + static_cast<int>(i), other.counts[i]);
+    }
+}
+
+
+void QuantileSketch::Clear() {
+    count = 0;
+    zeroCount = 0;
+    offset = 0;
+    counts.clear();
+}
+
+
+bool QuantileSketch::Quantile(double q, double* value) const {
+    if (count == 0) return false;
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+
+    // Lower rank: the value at position floor(q * (count - 1)) in sorted order
+    uint64_t rank = static_cast<uint64_t>(q * (count - 1));
+    if (rank < zeroCount) {
+        *value = 0.0;
+        return true;
+    }
+
+    uint64_t seen = zeroCount;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen > rank) {
+            *value = Value(offset + static_cast<int>(i));
+            return true;
+        }
+    }
+    *value = Value(offset + static_cast<int>(counts.size()) - 1);
+    return true;
+}
+
+
+/*********************************************************
+ *         WindowedSketch                                *
+ *********************************************************/
+
+void WindowedSketch::Add(int64_t timestamp, double value) {
+    if (value != value) return;     // Skip unavailable samples
+
+    int64_t hour = timestamp / 3600;
+    QuantileSketch& current = hourly[hour % WINDOW_HOURS];
+    if (hourOf[hour % WINDOW_HOURS] != hour) {
+        // The slot still holds an hour that left the window
+        current.Clear();
+        hourOf[hour % WINDOW_HOURS] = hour;
+    }
+
+    current.Add(value);
+    lifetime.Add(value);
+}
+
+
+bool WindowedSketch::WindowQuantile(double q, int64_t now, int hours, double* value) const {
+    if (hours < 1 || hours > WINDOW_HOURS) return false;
+
+    QuantileSketch merged;
+    int64_t hour = now / 3600;
+    for (int64_t h = hour - hours + 1; h <= hour; h++) {
+        if (h >= 0 && hourOf[h % WINDOW_HOURS] == h) merged.Merge(hourly[h % WINDOW_HOURS]);
+    }
+    return merged.Quantile(q, value);
+}
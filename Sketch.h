@@ -0,0 +1,59 @@
+// Mergeable quantile sketches for long-window percentiles of sensor values.
+// QuantileSketch is a DDSketch: values are counted in logarithmic buckets so every quantile
+// is returned with a bounded relative error, and two sketches merge by adding bucket counts.
+// The bucket store is capped; when a value falls outside the cap the lowest buckets are
+// collapsed, which only affects the accuracy of the lowest quantiles.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+class QuantileSketch {
+public:
+    static const int MAX_BUCKETS = 2048;        // Caps the sketch at 8 KB
+    static const double RELATIVE_ACCURACY;      // 0.5%, keeps integer readings below 100 exact after rounding
+
+    QuantileSketch();
+
+    // Add a non-negative value; negative values are counted as zero
+    void Add(double value);
+    void Merge(const QuantileSketch& other);
+    void Clear();
+
+    // Value at quantile q (0..1); returns false if the sketch is empty
+    bool Quantile(double q, double* value) const;
+    uint64_t Count() const { return count; }
+
+private:
+    int Index(double value) const;
+    double Value(int index) const;
+    void AddToBucket(int index, uint32_t n);
+
+    double gamma;
+    double logGamma;
+    uint64_t count = 0;
+    uint64_t zeroCount = 0;         // Values too small to index, including zeros
+    int offset = 0;                 // Bucket index of counts[0]
+    std::vector<uint32_t> counts;
+};
+
+
+// Quantiles of one metric over its lifetime and over recent windows of whole hours
+class WindowedSketch {
+public:
+    static const int WINDOW_HOURS = 24;
+
+    void Add(int64_t timestamp, double value);
+    // Quantile since the plugin was loaded
+    bool LifetimeQuantile(double q, double* value) const { return lifetime.Quantile(q, value); }
+    // Quantile over the current hour and the hours before it; false if 'hours' is not 1 to WINDOW_HOURS
+    bool WindowQuantile(double q, int64_t now, int hours, double* value) const;
+
+private:
+    QuantileSketch lifetime;
+    QuantileSketch hourly[WINDOW_HOURS];    // Ring indexed by hour number
+    int64_t hourOf[WINDOW_HOURS] = {};      // Hour number currently held by each ring slot
+};
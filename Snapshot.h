@@ -0,0 +1,28 @@
+// Filling of snapshot API samples from the metric readings.
+// The snapshot layout (SnapshotApi.h) lists the values in the order of SNAPSHOT_METRICS; the pipe
+// stream sends the same layout, so the plugin, CPUGPUd and the stream clients share this mapping.
+
+#pragma once
+
+#include <math.h>
+
+#include "Metrics.h"
+#include "SnapshotApi.h"
+
+
+static_assert(CPUGPU_VALUE_COUNT == SNAPSHOT_VALUE_COUNT, "SNAPSHOT_METRICS covers the snapshot layout");
+static_assert(CPUGPU_VALUE_COUNT <= CPUGPU_MAX_VALUES, "The snapshot validity mask holds 64 values");
+
+
+// Fill 'sample' with the METRIC_COUNT readings 'values', indexed by Metric, taken at Unix time 'timestamp'.
+// Unavailable (NAN) readings and the values past CPUGPU_VALUE_COUNT are NAN and not marked valid
+inline void FillSnapshot(const double* values, int64_t timestamp, cpugpu_sample* sample) {
+    sample->version = CPUGPU_API_VERSION;
+    sample->timestamp = timestamp;
+    sample->valid = 0;
+    for (int i = 0; i < CPUGPU_MAX_VALUES; i++) {
+        double value = (i < CPUGPU_VALUE_COUNT) ? values[SNAPSHOT_METRICS[i]] : NAN;
+        sample->values[i] = value;
+        if (!isnan(value)) sample->valid |= 1ull << i;
+    }
+}
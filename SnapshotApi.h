@@ -0,0 +1,104 @@
+/* C interface of the CPUGPU plugin for programs other than LCDSmartie.
+ * One call fills a caller-provided snapshot with the latest raw readings, so
+ * values do not go through the formatted strings of function1 to function5.
+ * The layout is fixed per CPUGPU_API_VERSION: new values are only appended and
+ * a caller built against an older header still receives the values it knows. */
+
+#ifndef CPUGPU_SNAPSHOT_API_H
+#define CPUGPU_SNAPSHOT_API_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#define CPUGPU_CALL __stdcall
+#ifdef CPUGPU_BUILD
+#define CPUGPU_API __declspec(dllexport)
+#else
+#define CPUGPU_API __declspec(dllimport)
+#endif
+#else
+#define CPUGPU_CALL
+#define CPUGPU_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPUGPU_API_VERSION 1
+#define CPUGPU_MAX_VALUES 64
+
+/* Return codes */
+#define CPUGPU_OK             0
+#define CPUGPU_ERROR_VERSION  -1  /* The DLL does not provide the requested layout version */
+#define CPUGPU_ERROR_INIT     -2  /* The hardware monitor could not be started */
+#define CPUGPU_ERROR_SIZE     -3  /* The snapshot size is smaller than the layout of the opened version */
+#define CPUGPU_ERROR_CLOSED   -4  /* cpugpu_open was not called */
+
+/* Index of each value in cpugpu_sample.values; units are those of the raw readings */
+enum cpugpu_value {
+    CPUGPU_CPU_LOAD,        /* % */
+    CPUGPU_CPU_POWER,       /* W */
+    CPUGPU_CPU_TEMP,        /* degrees C */
+    CPUGPU_CPU_FAN_RPM,     /* RPM */
+    CPUGPU_CPU_FAN,         /* % */
+    CPUGPU_CPU_CLOCK,       /* MHz */
+    CPUGPU_CPU_LIMIT,       /* 1 if throttled, 0 otherwise */
+    CPUGPU_CPU_IPC,         /* instructions per cycle */
+    CPUGPU_CPU_LLC_MISS,    /* % */
+    CPUGPU_CPU_INSTR,       /* instructions per second */
+    CPUGPU_GPU_LOAD,        /* % */
+    CPUGPU_GPU_POWER,       /* W */
+    CPUGPU_GPU_LIMIT,       /* 1 if at the power limit, 0 otherwise */
+    CPUGPU_GPU_TEMP,        /* degrees C */
+    CPUGPU_GPU_FAN,         /* % */
+    CPUGPU_GPU_CLOCK,       /* MHz */
+    CPUGPU_GPU_MEM_CLOCK,   /* MHz */
+    CPUGPU_GPU_MEM_ALLOC,   /* bytes */
+    CPUGPU_GPU_MEM_USAGE,   /* % */
+    CPUGPU_MEM_USED,        /* bytes */
+    CPUGPU_MEM_AVAILABLE,   /* bytes */
+    CPUGPU_MEM_USAGE,       /* % */
+    CPUGPU_MEM_CACHED,      /* bytes */
+    CPUGPU_MEM_SWAP,        /* bytes */
+    CPUGPU_MEM_SWAP_USAGE,  /* % */
+    CPUGPU_MEM_FAULTS,      /* hard page faults per second */
+    CPUGPU_DISK_READ,       /* bytes per second */
+    CPUGPU_DISK_WRITE,      /* bytes per second */
+    CPUGPU_DISK_READ_IOPS,  /* operations per second */
+    CPUGPU_DISK_WRITE_IOPS, /* operations per second */
+    CPUGPU_DISK_UTIL,       /* % of the busiest drive */
+    CPUGPU_DISK_TEMP,       /* degrees C of the hottest drive */
+    CPUGPU_NET_RX,          /* bytes per second */
+    CPUGPU_NET_TX,          /* bytes per second */
+    CPUGPU_VALUE_COUNT
+};
+
+typedef struct cpugpu_sample {
+    uint32_t size;                      /* sizeof(cpugpu_sample), set by the caller */
+    uint32_t version;                   /* Layout version of the filled values */
+    int64_t timestamp;                  /* Unix time of the readings in seconds */
+    uint64_t valid;                     /* Bit i is set if values[i] holds a reading */
+    double values[CPUGPU_MAX_VALUES];   /* Indexed by cpugpu_value */
+} cpugpu_sample;
+
+/* Start the monitoring backends for a layout version; returns CPUGPU_OK or an error code */
+CPUGPU_API int CPUGPU_CALL cpugpu_open(uint32_t version);
+
+/* Fill 'sample' with the readings of the current second. The first call in a second takes the readings:
+ * it reads the hardware and may allocate and block for a few milliseconds; later calls in the same second
+ * only copy the values already taken. Returns CPUGPU_OK or an error code */
+CPUGPU_API int CPUGPU_CALL cpugpu_snapshot(cpugpu_sample* sample);
+
+/* Serve the readings like the plugin in LCDSmartie does: the subscription pipe, web dashboard and collector
+ * push configured in CPUGPU.cpp. Readings are taken by cpugpu_snapshot calls, which a daemon makes every second */
+CPUGPU_API int CPUGPU_CALL cpugpu_serve(void);
+
+/* Stop the monitoring backends */
+CPUGPU_API void CPUGPU_CALL cpugpu_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,500 @@
+// Subscription stream over named pipes or Unix domain sockets, see SubscriptionServer.h
+
+#include "SubscriptionServer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <sddl.h>
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+typedef HANDLE Connection;
+static const Connection NO_CONNECTION = INVALID_HANDLE_VALUE;
+
+// Full access for the system, administrators and the owner; authenticated users may read and write
+// (FILE_GENERIC_READ | FILE_WRITE_DATA) but not create pipe instances (FILE_APPEND_DATA)
+static const char PIPE_SECURITY[] = "D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)(A;;0x0012008B;;;AU)";
+#else
+typedef int Connection;
+static const Connection NO_CONNECTION = -1;
+#endif
+
+
+struct Client {
+    Connection connection = NO_CONNECTION;  // Closed by the client thread, under the server lock
+    std::thread thread;
+    std::atomic<bool> done{ false };
+};
+
+
+struct SubscriptionServer::Impl {
+    std::string path;
+    std::atomic<intptr_t> listener;         // Listening socket; on Windows each pipe instance listens itself
+    std::thread acceptor;
+    std::atomic<bool> accepting{ false };
+    std::atomic<bool> stopping{ false };
+
+    std::mutex lock;                        // Guards the members below
+    std::condition_variable published;
+    uint64_t sequence = 0;                  // Number of ticks published
+    int64_t timestamp = 0;
+    double values[FRAME_MAX_VALUES] = {};
+    std::list<std::unique_ptr<Client>> clients;
+
+#ifdef _WIN32
+    PSECURITY_DESCRIPTOR security = NULL;
+    Connection firstInstance = NO_CONNECTION;   // Created by Start, connected by the acceptor
+    Connection CreateInstance(bool first);
+#endif
+
+    Impl() : listener(static_cast<intptr_t>(NO_CONNECTION)) {}
+    bool Start(const char* name);
+    void Stop();
+    void Publish(int64_t time, const double* tickValues);
+    void Accept();
+    void Serve(Client* client);
+    void Reap();
+};
+
+
+static bool ReadAll(Connection connection, void* data, size_t size) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    while (size > 0) {
+#ifdef _WIN32
+        DWORD read = 0;
+        if (!ReadFile(connection, p, static_cast<DWORD>(size), &read, NULL) || read == 0) return false;
+#else
+        ssize_t read = recv(connection, p, size, 0);
+        if (read <= 0) return false;
+#endif
+        p += read;
+        size -= read;
+    }
+    return true;
+}
+
+
+static bool WriteAll(Connection connection, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+#ifdef _WIN32
+        DWORD written = 0;
+        if (!WriteFile(connection, p, static_cast<DWORD>(size), &written, NULL) || written == 0) return false;
+#else
+        ssize_t written = send(connection, p, size, MSG_NOSIGNAL);
+        if (written <= 0) return false;
+#endif
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+
+// Read the subscription mask a client sends first; a client that does not send it within
+// SUBSCRIBE_TIMEOUT is dropped, so it cannot hold a slot
+static bool ReadMask(Connection connection, uint64_t* mask, const std::atomic<bool>& stopping) {
+#ifdef _WIN32
+    for (int waited = 0; ; waited += 10) {
+        DWORD available = 0;
+        if (!PeekNamedPipe(connection, NULL, 0, NULL, &available, NULL)) return false;
+        if (available >= sizeof(*mask)) break;
+        if (stopping || waited >= SubscriptionServer::SUBSCRIBE_TIMEOUT) return false;
+        Sleep(10);
+    }
+    return ReadAll(connection, mask, sizeof(*mask));
+#else
+    (void)stopping;
+    timeval timeout = { SubscriptionServer::SUBSCRIBE_TIMEOUT / 1000, (SubscriptionServer::SUBSCRIBE_TIMEOUT % 1000) * 1000 };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    bool read = ReadAll(connection, mask, sizeof(*mask));
+    timeval none = { 0, 0 };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+    return read;
+#endif
+}
+
+
+static void CloseConnection(Connection connection) {
+#ifdef _WIN32
+    DisconnectNamedPipe(connection);
+    CloseHandle(connection);
+#else
+    close(connection);
+#endif
+}
+
+
+// Make a blocking call of 'thread' on 'connection' return; on Windows the call is cancelled,
+// which has to be repeated until the thread notices that the server stops
+static void Interrupt(std::thread& thread, intptr_t connection) {
+#ifdef _WIN32
+    (void)connection;
+    CancelSynchronousIo(thread.native_handle());
+#else
+    (void)thread;
+    if (connection != NO_CONNECTION) shutdown(static_cast<int>(connection), SHUT_RDWR);
+#endif
+}
+
+
+SubscriptionServer::SubscriptionServer() : impl(new Impl()) {
+}
+
+
+SubscriptionServer::~SubscriptionServer() {
+    Stop();
+    delete impl;
+}
+
+
+bool SubscriptionServer::Running() const {
+    return impl->acceptor.joinable();
+}
+
+
+bool SubscriptionServer::Start(const char* name) {
+    return Running() || impl->Start(name);
+}
+
+
+void SubscriptionServer::Stop() {
+    if (Running()) impl->Stop();
+}
+
+
+void SubscriptionServer::Publish(int64_t timestamp, const double* values) {
+    impl->Publish(timestamp, values);
+}
+
+
+#ifdef _WIN32
+Connection SubscriptionServer::Impl::CreateInstance(bool first) {
+    SECURITY_ATTRIBUTES attributes = { sizeof(attributes), security, FALSE };
+    return CreateNamedPipeA(path.c_str(), PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+        PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES,
+        static_cast<DWORD>(FRAME_MAX_SIZE), sizeof(uint64_t), 0, &attributes);
+}
+#endif
+
+
+bool SubscriptionServer::Impl::Start(const char* name) {
+    stopping = false;
+#ifdef _WIN32
+    path = std::string("\\\\.\\pipe\\") + name;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(PIPE_SECURITY, SDDL_REVISION_1, &security, NULL)) return false;
+    // Fails if another process already serves the name
+    firstInstance = CreateInstance(true);
+    if (firstInstance == INVALID_HANDLE_VALUE) {
+        LocalFree(security);
+        security = NULL;
+        return false;
+    }
+#else
+    path = name;
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+        close(fd);      // Another process serves the path
+        return false;
+    }
+    close(fd);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    unlink(address.sun_path);   // Left over by a process that did not stop cleanly
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SubscriptionServer::MAX_CLIENTS) != 0) {
+        close(fd);
+        return false;
+    }
+    listener = fd;
+#endif
+    accepting = true;
+    acceptor = std::thread(&Impl::Accept, this);
+    return true;
+}
+
+
+void SubscriptionServer::Impl::Stop() {
+    stopping = true;
+    published.notify_all();
+
+    // Cancel the blocking calls until every thread has seen 'stopping'; give up waiting after two seconds
+    for (int attempt = 0; attempt < 200; attempt++) {
+        bool busy = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto& client : clients) {
+                if (client->done) continue;
+                Interrupt(client->thread, static_cast<intptr_t>(client->connection));
+                busy = true;
+            }
+        }
+        if (accepting) {
+            Interrupt(acceptor, listener);
+            busy = true;
+        }
+        if (!busy) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    acceptor.join();
+#ifdef _WIN32
+    if (firstInstance != NO_CONNECTION) CloseHandle(firstInstance);
+    firstInstance = NO_CONNECTION;
+    LocalFree(security);
+    security = NULL;
+#else
+    close(static_cast<int>(listener));
+    unlink(path.c_str());
+#endif
+    listener = static_cast<intptr_t>(NO_CONNECTION);
+
+    // The client threads take the lock when they finish, so they are joined without it
+    std::list<std::unique_ptr<Client>> finished;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        finished.swap(clients);
+    }
+    for (auto& client : finished) client->thread.join();
+}
+
+
+void SubscriptionServer::Impl::Publish(int64_t time, const double* tickValues) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        timestamp = time;
+        memcpy(values, tickValues, sizeof(values));
+        sequence++;
+    }
+    published.notify_all();
+}
+
+
+void SubscriptionServer::Impl::Accept() {
+    while (!stopping) {
+        Connection connection = NO_CONNECTION;
+#ifdef _WIN32
+        // Every client gets its own instance of the pipe, the first one was created by Start
+        connection = (firstInstance != NO_CONNECTION) ? firstInstance : CreateInstance(false);
+        firstInstance = NO_CONNECTION;
+        if (connection == INVALID_HANDLE_VALUE) break;
+        if (!ConnectNamedPipe(connection, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+            CloseHandle(connection);
+            continue;
+        }
+#else
+        connection = accept(static_cast<int>(listener), NULL, NULL);
+        if (connection < 0) {
+            if (stopping) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));   // Out of descriptors, try again later
+            continue;
+        }
+#endif
+        if (stopping) {
+            CloseConnection(connection);
+            break;
+        }
+
+        Reap();
+        std::lock_guard<std::mutex> guard(lock);
+        if (clients.size() >= SubscriptionServer::MAX_CLIENTS) {
+            CloseConnection(connection);
+            continue;
+        }
+        clients.emplace_back(new Client());
+        Client* client = clients.back().get();
+        client->connection = connection;
+        client->thread = std::thread(&Impl::Serve, this, client);
+    }
+
+    accepting = false;
+}
+
+
+// Join the threads of clients that disconnected
+void SubscriptionServer::Impl::Reap() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = clients.begin(); it != clients.end();) {
+        if ((*it)->done) {
+            (*it)->thread.join();
+            it = clients.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+
+void SubscriptionServer::Impl::Serve(Client* client) {
+    uint64_t subscription = 0;
+    if (ReadMask(client->connection, &subscription, stopping)) {
+        DeltaEncoder encoder(subscription);
+        uint8_t frame[FRAME_MAX_SIZE];
+        double current[FRAME_MAX_VALUES];
+        int64_t time = 0;
+        uint64_t seen = 0;
+
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                published.wait(guard, [&] { return stopping || sequence != seen; });
+                if (stopping) break;
+                // Only the latest tick is taken, ticks published while the last frame was written are skipped
+                seen = sequence;
+                time = timestamp;
+                memcpy(current, values, sizeof(current));
+            }
+            size_t size = encoder.Encode(time, current, frame);
+            if (!WriteAll(client->connection, frame, size)) break;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    CloseConnection(client->connection);
+    client->connection = NO_CONNECTION;
+    client->done = true;
+}
+
+
+struct SubscriptionClient::Impl {
+    Connection connection = NO_CONNECTION;
+    std::thread reader;
+    std::atomic<bool> connected{ false };
+    std::atomic<bool> stopping{ false };
+
+    mutable std::mutex lock;                // Guards the members below
+    bool received = false;
+    int64_t timestamp = 0;
+    int64_t connectTime = 0;
+    double values[FRAME_MAX_VALUES] = {};
+
+    void Read();
+};
+
+
+SubscriptionClient::SubscriptionClient() : impl(new Impl()) {
+}
+
+
+SubscriptionClient::~SubscriptionClient() {
+    Disconnect();
+    delete impl;
+}
+
+
+bool SubscriptionClient::Connect(const char* name, uint64_t mask) {
+    Disconnect();
+    Impl& client = *impl;
+#ifdef _WIN32
+    std::string path = std::string("\\\\.\\pipe\\") + name;
+    // GENERIC_WRITE would include the right to create pipe instances, which the server does not grant
+    client.connection = CreateFileA(path.c_str(), GENERIC_READ | FILE_WRITE_DATA, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (client.connection == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeA(path.c_str(), 1000)) {
+        // The server is between two pipe instances
+        client.connection = CreateFileA(path.c_str(), GENERIC_READ | FILE_WRITE_DATA, 0, NULL, OPEN_EXISTING, 0, NULL);
+    }
+    if (client.connection == INVALID_HANDLE_VALUE) return false;
+#else
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(name) >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, name);
+    client.connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client.connection < 0) return false;
+    if (connect(client.connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        CloseConnection(client.connection);
+        client.connection = NO_CONNECTION;
+        return false;
+    }
+#endif
+    if (!WriteAll(client.connection, &mask, sizeof(mask))) {
+        CloseConnection(client.connection);
+        client.connection = NO_CONNECTION;
+        return false;
+    }
+
+    client.stopping = false;
+    client.received = false;
+    client.connectTime = time(NULL);
+    client.connected = true;
+    client.reader = std::thread(&Impl::Read, impl);
+    return true;
+}
+
+
+void SubscriptionClient::Disconnect() {
+    Impl& client = *impl;
+    if (!client.reader.joinable()) return;
+    client.stopping = true;
+    // The reader blocks in a read of the connection until it is cancelled or shut down
+    for (int attempt = 0; attempt < 200 && client.connected; attempt++) {
+        Interrupt(client.reader, static_cast<intptr_t>(client.connection));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    client.reader.join();
+#ifdef _WIN32
+    CloseHandle(client.connection);
+#else
+    close(client.connection);
+#endif
+    client.connection = NO_CONNECTION;
+}
+
+
+bool SubscriptionClient::Connected() const {
+    return impl->connected;
+}
+
+
+bool SubscriptionClient::Latest(int64_t* timestamp, double* values) const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    if (!impl->received) return false;
+    *timestamp = impl->timestamp;
+    memcpy(values, impl->values, sizeof(impl->values));
+    return true;
+}
+
+
+int64_t SubscriptionClient::SilentFor(int64_t now) const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return now - (impl->received ? impl->timestamp : impl->connectTime);
+}
+
+
+void SubscriptionClient::Impl::Read() {
+    uint8_t frame[FRAME_MAX_SIZE];
+    while (!stopping) {
+        uint32_t size = 0;
+        if (!ReadAll(connection, &size, sizeof(size)) || size < FRAME_HEADER_SIZE || size > FRAME_MAX_SIZE) break;
+        memcpy(frame, &size, sizeof(size));
+        if (!ReadAll(connection, frame + sizeof(size), size - sizeof(size))) break;
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (!ApplyDeltaFrame(frame, size, &timestamp, values)) break;
+        received = true;
+    }
+    connected = false;
+}
@@ -0,0 +1,69 @@
+// Local subscription stream of the snapshot values.
+// Clients connect to a named pipe (\\.\pipe\<name>) on Windows or a Unix domain socket elsewhere, write
+// the uint64 mask of the values they want within SUBSCRIBE_TIMEOUT and then receive a DeltaFrame each
+// tick with the subscribed values that changed (none if nothing did, so the time still advances).
+// Publish only copies the readings and wakes the client threads, so the sampler never waits for a
+// client. A slow client skips the ticks it could not take and gets the changes against what it last
+// received, so its backlog is at most one frame. Only one server can own a name: on Windows the first
+// pipe instance is created exclusively, and its DACL lets authenticated users read and write but not
+// create instances; elsewhere a socket path that still answers is not taken over.
+// SubscriptionClient is the receiving end.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "DeltaFrame.h"
+
+
+class SubscriptionServer {
+public:
+    static const int MAX_CLIENTS = 16;
+    static const int SUBSCRIBE_TIMEOUT = 2000;  // Milliseconds a new client has to send its mask
+
+    SubscriptionServer();
+    ~SubscriptionServer();
+
+    // Start listening on the pipe or socket 'name'; returns false if it cannot be created or another server owns it
+    bool Start(const char* name);
+    void Stop();
+    bool Running() const;
+
+    // Hand over the FRAME_MAX_VALUES values of a new tick
+    void Publish(int64_t timestamp, const double* values);
+
+private:
+    // Threads and locks stay in the native translation unit, <thread> and <mutex> cannot be used under /clr
+    struct Impl;
+    Impl* impl;
+
+    SubscriptionServer(const SubscriptionServer&) = delete;
+    SubscriptionServer& operator=(const SubscriptionServer&) = delete;
+};
+
+
+class SubscriptionClient {
+public:
+    SubscriptionClient();
+    ~SubscriptionClient();
+
+    // Connect to the pipe or socket 'name' of a SubscriptionServer and subscribe to the values in 'mask';
+    // frames are then read by a background thread
+    bool Connect(const char* name, uint64_t mask);
+    void Disconnect();
+    // False once the server went away
+    bool Connected() const;
+
+    // Copy the FRAME_MAX_VALUES values as of the last frame; returns false before the first frame
+    bool Latest(int64_t* timestamp, double* values) const;
+    // Seconds from the time of the last frame, or from Connect before the first one, to Unix time 'now'.
+    // Every tick sends a frame, so this growing past a second or two means the server stopped publishing
+    int64_t SilentFor(int64_t now) const;
+
+private:
+    struct Impl;
+    Impl* impl;
+
+    SubscriptionClient(const SubscriptionClient&) = delete;
+    SubscriptionClient& operator=(const SubscriptionClient&) = delete;
+};
@@ -0,0 +1,103 @@
+// Top process consumers, see TopProcesses.h
+
+#include "TopProcesses.h"
+
+#include <algorithm>
+
+
+void TopProcesses::Begin(double seconds) {
+    interval = (scan > 0) ? seconds - lastSeconds : 0.0;
+    lastSeconds = seconds;
+    scan++;
+}
+
+
+bool TopProcesses::Sample(uint32_t pid, uint64_t startTime, uint64_t cpuTime, uint64_t memory) {
+    std::unordered_map<uint32_t, Process>::iterator found = processes.find(pid);
+    bool isNew = (found == processes.end() || found->second.startTime != startTime);
+    if (isNew) {
+        Process process = { startTime, cpuTime, memory, 0, scan, false, std::string() };
+        processes[pid] = process;
+        return true;
+    }
+
+    Process& process = found->second;
+    process.measured = (process.scan + 1 == scan && cpuTime >= process.cpuTime);
+    process.cpuDelta = process.measured ? cpuTime - process.cpuTime : 0;
+    process.cpuTime = cpuTime;
+    process.memory = memory;
+    process.scan = scan;
+    return false;
+}
+
+
+void TopProcesses::SetName(uint32_t pid, const char* name) {
+    std::unordered_map<uint32_t, Process>::iterator found = processes.find(pid);
+    if (found != processes.end()) found->second.name = name;
+}
+
+
+// A process while ranking; its name is only copied if it ends up in a top list
+struct Candidate {
+    uint32_t pid;
+    const std::string* name;
+    double cpu;
+    uint64_t memory;
+};
+
+
+// Keep the 'count' largest candidates by 'key' in a min-heap, largest first once sorted
+template <typename Key>
+static void Rank(std::vector<Candidate>& top, const Candidate& entry, size_t count, Key key) {
+    auto greater = [&key](const Candidate& a, const Candidate& b) { return key(a) > key(b); };
+    if (top.size() < count) {
+        top.push_back(entry);
+        std::push_heap(top.begin(), top.end(), greater);
+    }
+    else if (key(entry) > key(top.front())) {
+        std::pop_heap(top.begin(), top.end(), greater);
+        top.back() = entry;
+        std::push_heap(top.begin(), top.end(), greater);
+    }
+}
+
+
+// Sort a heap built by Rank largest first and copy it out with the names
+template <typename Key>
+static void Publish(std::vector<Candidate>& heap, Key key, std::vector<TopEntry>* top) {
+    std::sort_heap(heap.begin(), heap.end(), [&key](const Candidate& a, const Candidate& b) { return key(a) > key(b); });
+    top->clear();
+    for (const Candidate& candidate : heap) {
+        TopEntry entry = { candidate.pid, *candidate.name, candidate.cpu, candidate.memory };
+        top->push_back(entry);
+    }
+}
+
+
+void TopProcesses::End(int processors) {
+    double capacity = interval * 1e7 * (processors > 0 ? processors : 1);  // 100 ns units available
+
+    auto byCpu = [](const Candidate& entry) { return entry.cpu; };
+    auto byMemory = [](const Candidate& entry) { return static_cast<double>(entry.memory); };
+    std::vector<Candidate> heapCpu, heapMemory;
+    heapCpu.reserve(TOP_COUNT);
+    heapMemory.reserve(TOP_COUNT);
+    for (std::unordered_map<uint32_t, Process>::iterator it = processes.begin(); it != processes.end(); ) {
+        const Process& process = it->second;
+        if (process.scan != scan) {
+            it = processes.erase(it);   // Exited since the last scan
+            continue;
+        }
+
+        // Erasing other processes leaves the name of this one in place, so the heaps can point to it
+        Candidate entry = { it->first, &process.name, 0.0, process.memory };
+        if (process.measured && capacity > 0.0) entry.cpu = 100.0 * process.cpuDelta / capacity;
+        Rank(heapCpu, entry, TOP_COUNT, byCpu);
+        Rank(heapMemory, entry, TOP_COUNT, byMemory);
+        ++it;
+    }
+
+    Publish(heapCpu, byCpu, &topCpu);
+    Publish(heapMemory, byMemory, &topMemory);
+    valid = interval > 0.0;
+}
@@ -0,0 +1,60 @@
+// Top CPU and memory consumers among all processes.
+// Every scan feeds the cumulative CPU time and memory of each running process; CPU usage is the CPU
+// time delta against the previous scan of the same process. Processes are keyed by id and start
+// time, so a reused process id is not mistaken for the old process, and processes that were not
+// seen in a scan are pruned. Ranking keeps a bounded heap, so a scan costs O(n log TOP_COUNT), and only
+// the names of the processes that end up ranked are copied. The scan itself (NtQuerySystemInformation)
+// stays with the caller, so the ranking is tested on made-up process lists.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+struct TopEntry {
+    uint32_t pid;
+    std::string name;
+    double cpu;         // Percent of all logical processors
+    uint64_t memory;    // Bytes
+};
+
+
+class TopProcesses {
+public:
+    static const int TOP_COUNT = 10;    // Ranks kept per criterion
+
+    // Start a scan taken at 'seconds' on a monotonic clock
+    void Begin(double seconds);
+    // Feed one process, 'cpuTime' in 100 ns units; returns true if it is new and needs a name
+    bool Sample(uint32_t pid, uint64_t startTime, uint64_t cpuTime, uint64_t memory);
+    void SetName(uint32_t pid, const char* name);
+    // Finish the scan: prune exited processes and rank the rest
+    void End(int processors);
+
+    bool Valid() const { return valid; }
+    int Count(bool byMemory) const { return static_cast<int>((byMemory ? topMemory : topCpu).size()); }
+    // Entry of rank 0..Count()-1 by CPU usage or by memory
+    const TopEntry& Top(int rank, bool byMemory) const { return (byMemory ? topMemory : topCpu)[rank]; }
+
+private:
+    struct Process {
+        uint64_t startTime;
+        uint64_t cpuTime;
+        uint64_t memory;
+        uint64_t cpuDelta;  // CPU time during the last scan interval
+        uint32_t scan;      // Number of the last scan that saw the process
+        bool measured;      // Seen in two consecutive scans
+        std::string name;
+    };
+
+    std::unordered_map<uint32_t, Process> processes;
+    std::vector<TopEntry> topCpu;
+    std::vector<TopEntry> topMemory;
+    uint32_t scan = 0;
+    double lastSeconds = 0.0;
+    double interval = 0.0;
+    bool valid = false;
+};
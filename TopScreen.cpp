@@ -0,0 +1,171 @@
+// Screen of cpugpu-top, see TopScreen.h
+
+#include "TopScreen.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+
+
+static const char* const SPARK_BLOCKS[] = { "", "\xE2\x96\x81", "\xE2\x96\x82", "\xE2\x96\x83", "\xE2\x96\x84",
+    "\xE2\x96\x85", "\xE2\x96\x86", "\xE2\x96\x87", "\xE2\x96\x88" };
+static const unsigned char DEGREE = 0xB0;   // Degree sign of the units in Metrics.h
+
+
+void Screen::Reset(int newWidth, int newHeight, std::string* out) {
+    width = newWidth;
+    height = newHeight;
+    // The last column is left free, so that a full line never wraps the cursor
+    shown.assign(height, std::string(width - 1, ' '));
+    out->append("\x1b[H\x1b[2J");
+}
+
+
+void Screen::Draw(const std::vector<std::string>& lines, std::string* out) {
+    for (int row = 0; row < height; row++) {
+        std::string line = (row < static_cast<int>(lines.size())) ? lines[row] : std::string();
+        line.resize(width - 1, ' ');
+        const std::string& old = shown[row];
+
+        size_t first = 0;
+        while (first < line.size() && line[first] == old[first]) first++;
+        if (first == line.size()) continue;
+        size_t last = line.size() - 1;
+        while (line[last] == old[last]) last--;
+
+        char move[32];
+        snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, static_cast<int>(first) + 1);
+        out->append(move);
+        AppendText(line.data() + first, last - first + 1, out);
+        shown[row] = line;
+    }
+}
+
+
+void Screen::AppendText(const char* text, size_t length, std::string* out) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 1 && c <= SPARK_LEVELS) out->append(SPARK_BLOCKS[c]);
+        else if (c == DEGREE) out->append("\xC2\xB0");
+        else out->push_back(static_cast<char>(c));
+    }
+}
+
+
+MetricHistory::MetricHistory() : samples(METRIC_COUNT * SPARK_SAMPLES, NAN) {}
+
+
+void MetricHistory::Append(const double* values) {
+    next = (next + 1) % SPARK_SAMPLES;
+    for (int i = 0; i < METRIC_COUNT; i++) samples[i * SPARK_SAMPLES + next] = values[i];
+    if (count < SPARK_SAMPLES) count++;
+}
+
+
+void MetricHistory::AppendSparkline(int metric, int width, std::string* line) const {
+    if (width > count) width = count;
+    const double* series = &samples[metric * SPARK_SAMPLES];
+    double low = INFINITY, high = -INFINITY;
+    for (int i = 0; i < width; i++) {
+        double value = series[(next - i + SPARK_SAMPLES) % SPARK_SAMPLES];
+        if (value < low) low = value;
+        if (value > high) high = value;
+    }
+    for (int i = width - 1; i >= 0; i--) {
+        double value = series[(next - i + SPARK_SAMPLES) % SPARK_SAMPLES];
+        if (isnan(value)) {
+            line->push_back(' ');
+            continue;
+        }
+        int level = (high > low) ? 1 + static_cast<int>((value - low) / (high - low) * (SPARK_LEVELS - 1) + 0.5) : 1;
+        line->push_back(static_cast<char>(level));
+    }
+}
+
+
+std::vector<std::string> MetricLines(const MetricHistory& history, const double* shown, bool stale, int columnWidth,
+    bool blankLines) {
+    std::vector<std::string> lines;
+    char text[128];
+
+    int group = 0;
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        const MetricInfo& info = METRICS[i];
+        if (info.group != group) {
+            group = info.group;
+            if (blankLines) lines.push_back(std::string());
+            std::string heading = GROUP_KEYS[group];
+            for (char& c : heading) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            lines.push_back(heading);
+        }
+
+        char value[32] = "-";
+        if (!isnan(shown[i])) {
+            snprintf(value, sizeof(value), stale ? "(%.*f)" : "%.*f", info.decimals, shown[i] * info.scale);
+        }
+        int length = snprintf(text, sizeof(text), "  %-11s%10s %-5s ", info.name, value, info.unit);
+        std::string line(text, length);
+        history.AppendSparkline(i, columnWidth - length, &line);
+        if (static_cast<int>(line.size()) > columnWidth) line.resize(columnWidth);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+
+std::vector<std::string> Layout(const char* name, time_t now, int staleSeconds, const MetricHistory& history,
+    const double* shown, int width, int height, int* scroll) {
+    int rows = (height > 1) ? height - 1 : 1;     // Below the header
+    std::vector<std::string> body = MetricLines(history, shown, staleSeconds > 0, width - 1, true);
+    int columnWidth = (width - 2) / 2;
+    if (static_cast<int>(body.size()) > rows && columnWidth >= COLUMN_MIN_WIDTH) {
+        std::vector<std::string> entries = MetricLines(history, shown, staleSeconds > 0, columnWidth, false);
+        // Break the columns at the group heading that balances them best, so no group is split
+        size_t half = entries.size();
+        size_t rowsNeeded = entries.size();
+        for (size_t i = 1; i < entries.size(); i++) {
+            if (entries[i][0] == ' ') continue;
+            size_t taller = (i > entries.size() - i) ? i : entries.size() - i;
+            if (taller < rowsNeeded) {
+                half = i;
+                rowsNeeded = taller;
+            }
+        }
+        body.clear();
+        for (size_t row = 0; row < half || row < entries.size() - half; row++) {
+            std::string line = (row < half) ? entries[row] : std::string();
+            if (half + row < entries.size()) {
+                line.resize(columnWidth + 1, ' ');
+                line += entries[half + row];
+            }
+            body.push_back(line);
+        }
+    }
+
+    int maxScroll = static_cast<int>(body.size()) - rows;
+    if (*scroll > maxScroll) *scroll = maxScroll;
+    if (*scroll < 0) *scroll = 0;
+
+    struct tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char text[160];
+    int length = snprintf(text, sizeof(text), "cpugpu-top - %s - %02d:%02d:%02d", name, local.tm_hour, local.tm_min, local.tm_sec);
+    if (staleSeconds > 0) {
+        length += snprintf(text + length, sizeof(text) - length, " - STALE, no data for %ds", staleSeconds);
+    }
+    if (maxScroll > 0) {
+        snprintf(text + length, sizeof(text) - length, " - rows %d-%d of %d", *scroll + 1, *scroll + rows,
+            static_cast<int>(body.size()));
+    }
+
+    std::vector<std::string> lines;
+    lines.push_back(text);
+    for (int row = 0; row < rows && *scroll + row < static_cast<int>(body.size()); row++) {
+        lines.push_back(body[*scroll + row]);
+    }
+    return lines;
+}
@@ -0,0 +1,69 @@
+// Screen of cpugpu-top: the layout of the metrics with their sparklines for a terminal of a given size, and
+// a screen that redraws by difference to what it shows. Kept apart from the terminal handling in
+// CpuGpuTop.cpp, so that both build and are tested on any platform.
+
+#pragma once
+
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "Metrics.h"
+
+
+static const int SPARK_SAMPLES = 240;   // Seconds of history kept per metric
+static const int SPARK_LEVELS = 8;
+static const int COLUMN_MIN_WIDTH = 38; // Narrowest column of the two-column layout, with a short sparkline
+
+
+// Terminal screen that redraws by difference to what it shows.
+// Sparkline levels are kept as the bytes 1 to SPARK_LEVELS in the lines, so that every column is one byte,
+// and are written as block characters
+class Screen {
+public:
+    // Start over on a cleared screen of the given size
+    void Reset(int newWidth, int newHeight, std::string* out);
+
+    bool SameSize(int otherWidth, int otherHeight) const { return width == otherWidth && height == otherHeight; }
+
+    // Append the escape sequences that turn the shown lines into 'lines'
+    void Draw(const std::vector<std::string>& lines, std::string* out);
+
+private:
+    static void AppendText(const char* text, size_t length, std::string* out);
+
+    int width = 0;
+    int height = 0;
+    std::vector<std::string> shown;
+};
+
+
+// Readings of every metric over the last SPARK_SAMPLES seconds
+class MetricHistory {
+public:
+    MetricHistory();
+
+    void Append(const double* values);
+
+    double Latest(int metric) const { return samples[metric * SPARK_SAMPLES + next]; }
+
+    // Append the sparkline of the last 'width' seconds of a metric, scaled to its range over those seconds
+    void AppendSparkline(int metric, int width, std::string* line) const;
+
+private:
+    std::vector<double> samples;    // SPARK_SAMPLES per metric, a ring ending at 'next'
+    int next = 0;
+    int count = 0;
+};
+
+
+// Lines of the metric groups, each a heading followed by one line per metric, at most 'columnWidth' long.
+// 'shown' holds the values to print, in parentheses if they are 'stale'
+std::vector<std::string> MetricLines(const MetricHistory& history, const double* shown, bool stale, int columnWidth,
+    bool blankLines);
+
+// Lay out the header and the metrics for a terminal of 'width' x 'height': one column with blank lines between
+// the groups if it fits, else two columns, scrolled by '*scroll' rows (clamped here) if even they do not fit.
+// 'staleSeconds' is how long no frame arrived, 0 while they arrive
+std::vector<std::string> Layout(const char* name, time_t now, int staleSeconds, const MetricHistory& history,
+    const double* shown, int width, int height, int* scroll);
@@ -0,0 +1,136 @@
+// Tests of the C-state residency on a fake MSR reader, see CState.h
+
+#include "Test.h"
+
+#include <string.h>
+#include <vector>
+
+#include "CState.h"
+#include "FakeMsr.h"
+
+
+static const uint32_t CORE_C3 = 0x3FC;
+static const uint32_t CORE_C6 = 0x3FD;
+static const uint32_t PKG_C2 = 0x60D;
+static const uint32_t PKG_C6 = 0x3F9;
+
+static const uint64_t TICK = 1000000000ull;    // TSC cycles per update
+
+
+// Advance one processor by a tick, resident in 'states' for the given shares of it
+static void Tick(FakeMsrReader* msr, int processor, const std::vector<std::pair<uint32_t, double>>& states) {
+    msr->Add(processor, MSR_TIME_STAMP_COUNTER, TICK);
+    for (const std::pair<uint32_t, double>& state : states) {
+        msr->Add(processor, state.first, static_cast<uint64_t>(state.second * TICK));
+    }
+}
+
+
+// Four processors in two packages whose first processors are 0 and 2. Core C6 exists on every processor,
+// the package counters only where they are read; C3 and C7 do not exist
+static void TwoPackages(FakeMsrReader* msr) {
+    for (int i = 0; i < 4; i++) {
+        msr->Set(i, MSR_TIME_STAMP_COUNTER, 5000);
+        msr->Set(i, CORE_C6, 100);
+    }
+    for (int i : { 0, 2 }) {
+        msr->Set(i, PKG_C2, 0);
+        msr->Set(i, PKG_C6, 0);
+    }
+}
+
+
+TEST(CState, CoreAndPackageResidency) {
+    FakeMsrReader msr(4);
+    TwoPackages(&msr);
+    CStateResidency residency(&msr);
+    std::vector<int> packages = { 0, 2 };
+    CHECK(residency.Update(packages));
+    CHECK(!residency.Valid());      // One reading gives no interval yet
+    CHECK(residency.Available(CSTATE_C6) && residency.Available(CSTATE_PC6) && residency.Available(CSTATE_PC2));
+    CHECK(!residency.Available(CSTATE_C3) && !residency.Available(CSTATE_C7));
+
+    // Core states average every processor, package states the first processor of each package only
+    Tick(&msr, 0, { { CORE_C6, 0.5 }, { PKG_C6, 0.4 }, { PKG_C2, 0.1 } });
+    Tick(&msr, 1, { { CORE_C6, 0.3 } });
+    Tick(&msr, 2, { { CORE_C6, 0.2 }, { PKG_C6, 0.2 } });
+    Tick(&msr, 3, {});
+    CHECK(residency.Update(packages));
+    CHECK(residency.Valid());
+    CHECK_NEAR(residency.Residency(CSTATE_C6), 25.0, 1e-9);
+    CHECK_NEAR(residency.Residency(CSTATE_PC6), 30.0, 1e-9);
+    CHECK_NEAR(residency.Residency(CSTATE_PC2), 5.0, 1e-9);
+    CHECK(residency.Residency(CSTATE_C3) == 0.0);
+}
+
+
+TEST(CState, ProbesOnceAndBatchesReads) {
+    FakeMsrReader msr(4);
+    TwoPackages(&msr);
+    CStateResidency residency(&msr);
+    std::vector<int> packages = { 0, 2 };
+    residency.Update(packages);
+
+    // After the probe, one read per processor and update; the missing states are not asked for again
+    int reads = msr.readCalls;
+    for (int i = 0; i < 4; i++) Tick(&msr, i, { { CORE_C6, 0.5 } });
+    CHECK(residency.Update(packages));
+    CHECK(msr.readCalls - reads == 4);
+
+    // A CPU without any residency counter has no residency
+    FakeMsrReader none(2);
+    none.Set(0, MSR_TIME_STAMP_COUNTER, 0);
+    CStateResidency missing(&none);
+    CHECK(!missing.Update({ 0 }));
+    CHECK(!missing.Valid());
+}
+
+
+TEST(CState, ResetCountersAndChangedPackages) {
+    FakeMsrReader msr(2);
+    msr.Set(0, MSR_TIME_STAMP_COUNTER, 5000);
+    msr.Set(1, MSR_TIME_STAMP_COUNTER, 5000);
+    msr.Set(0, CORE_C3, 0);
+    msr.Set(1, CORE_C3, 0);
+    msr.Set(0, CORE_C6, 1000000);
+    msr.Set(1, CORE_C6, 1000000);
+    CStateResidency residency(&msr);
+    std::vector<int> packages = { 0 };
+    residency.Update(packages);
+
+    // The C6 counter of processor 1 was reset (resume from sleep): its interval counts as not resident
+    Tick(&msr, 0, { { CORE_C6, 0.8 }, { CORE_C3, 0.1 } });
+    msr.Add(1, MSR_TIME_STAMP_COUNTER, TICK);
+    msr.Set(1, CORE_C6, 10);
+    CHECK(residency.Update(packages));
+    CHECK_NEAR(residency.Residency(CSTATE_C6), 40.0, 1e-9);
+    CHECK_NEAR(residency.Residency(CSTATE_C3), 5.0, 1e-9);
+
+    // A new package list starts over, as the processors now read other counters
+    Tick(&msr, 0, { { CORE_C6, 0.2 } });
+    Tick(&msr, 1, { { CORE_C6, 0.2 } });
+    CHECK(residency.Update({ 1 }));
+    CHECK(!residency.Valid());
+
+    // A failed read invalidates the residency until two readings span an interval again
+    msr.failReads = true;
+    CHECK(!residency.Update({ 1 }));
+    msr.failReads = false;
+    CHECK(residency.Update({ 1 }));
+    CHECK(!residency.Valid());
+}
+
+
+TEST(CState, SelectorNames) {
+    // The names of the CState@<state> selector
+    CHECK(CStateResidency::FindState("C6") == CSTATE_C6);
+    CHECK(CStateResidency::FindState("PC6") == CSTATE_PC6);
+    CHECK(CStateResidency::FindState("PC10") == CSTATE_PC10);
+    CHECK(CStateResidency::FindState("C8") == -1);
+    CHECK(CStateResidency::FindState("c6") == -1);
+    CHECK(CStateResidency::FindState("") == -1);
+    for (int state = 0; state < CSTATE_COUNT; state++) {
+        CHECK(CStateResidency::FindState(CStateResidency::StateName(state)) == state);
+    }
+    CHECK(strcmp(CStateResidency::StateName(CSTATE_COUNT), "") == 0);
+}
@@ -0,0 +1,140 @@
+// Tests of the throttling status and reasons, see CpuThrottle.h
+
+#include "Test.h"
+
+#include <string.h>
+#include <vector>
+
+#include "CpuThrottle.h"
+#include "FakeMsr.h"
+
+
+static const uint32_t PACKAGE_THERM_STATUS = 0x1B1;
+static const uint32_t PERF_LIMIT_REASONS = 0x64F;
+static const uint32_t TEMPERATURE_TARGET = 0x1A2;
+
+
+TEST(CpuThrottle, LimitReasonBits) {
+    FakeMsrReader msr(1);
+    msr.Set(0, PACKAGE_THERM_STATUS, 0);
+    msr.Set(0, PERF_LIMIT_REASONS, 0);
+    CpuThrottle throttle(&msr);
+    CHECK(throttle.Update(100, {}));
+    CHECK(throttle.Valid());
+    CHECK(!throttle.Throttling());
+    CHECK(throttle.ActiveReason()[0] == '\0');
+
+    // PL1 (bit 10) and PL2 (bit 11): PL2 is the more severe name
+    msr.Set(0, PERF_LIMIT_REASONS, (1ull << 10) | (1ull << 11));
+    CHECK(throttle.Update(101, {}));
+    CHECK(throttle.Active(THROTTLE_PL1) && throttle.Active(THROTTLE_PL2));
+    CHECK(!throttle.Active(THROTTLE_THERMAL));
+    CHECK(strcmp(throttle.ActiveReason(), "PL2") == 0);
+
+    // PROCHOT (bit 0) and thermal (bit 1); VR current (bit 7) and VR thermal (bit 6) count as EDP
+    msr.Set(0, PERF_LIMIT_REASONS, (1ull << 0) | (1ull << 1));
+    throttle.Update(102, {});
+    CHECK(throttle.Active(THROTTLE_PROCHOT) && throttle.Active(THROTTLE_THERMAL));
+    CHECK(strcmp(throttle.ActiveReason(), "PROCHOT") == 0);
+    for (int bit : { 6, 7, 8 }) {
+        msr.Set(0, PERF_LIMIT_REASONS, 1ull << bit);
+        throttle.Update(103, {});
+        CHECK(throttle.Active(THROTTLE_EDP));
+        CHECK(!throttle.Active(THROTTLE_PL1));
+    }
+}
+
+
+TEST(CpuThrottle, TimeShares) {
+    FakeMsrReader msr(1);
+    msr.Set(0, PACKAGE_THERM_STATUS, 0);
+    msr.Set(0, PERF_LIMIT_REASONS, 0);
+    CpuThrottle throttle(&msr);
+    throttle.Update(0, {});
+
+    // 6 s unthrottled, then 3 s at PL1 and 1 s thermal; a 60 s gap is not counted
+    for (int64_t t = 1; t <= 6; t++) throttle.Update(t, {});
+    msr.Set(0, PERF_LIMIT_REASONS, 1ull << 10);
+    for (int64_t t = 7; t <= 9; t++) throttle.Update(t, {});
+    msr.Set(0, PERF_LIMIT_REASONS, 1ull << 1);
+    throttle.Update(10, {});
+    throttle.Update(70, {});
+    CHECK_NEAR(throttle.Percent(-1), 40.0, 1e-9);
+    CHECK_NEAR(throttle.Percent(THROTTLE_PL1), 30.0, 1e-9);
+    CHECK_NEAR(throttle.Percent(THROTTLE_THERMAL), 10.0, 1e-9);
+    CHECK(CpuThrottle::FindReason("PL1") == THROTTLE_PL1);
+    CHECK(CpuThrottle::FindReason("") == -1);
+    CHECK(CpuThrottle::FindReason("Fan") == THROTTLE_REASON_COUNT);
+}
+
+
+TEST(CpuThrottle, TemperatureTargetBits) {
+    // TjMax in bits 23:16, with the offset in bits 29:24 and other fields around it
+    FakeMsrReader msr(1);
+    msr.Set(0, TEMPERATURE_TARGET, (5ull << 24) | (100ull << 16) | 0x0A00);
+    CpuThrottle throttle(&msr);
+    CHECK(throttle.TemperatureTarget() == 100);
+
+    // Read once: a later change of the register is not seen
+    msr.Set(0, TEMPERATURE_TARGET, 90ull << 16);
+    CHECK(throttle.TemperatureTarget() == 100);
+
+    FakeMsrReader none(1);
+    CpuThrottle missing(&none);
+    CHECK(missing.TemperatureTarget() == 0);
+}
+
+
+TEST(CpuThrottle, RetriesLimitReasonsBeforeGivingUp) {
+    FakeMsrReader msr(1);
+    msr.Set(0, PACKAGE_THERM_STATUS, 1ull << 10);      // The package reports a power limit
+    msr.Set(0, PERF_LIMIT_REASONS, 1ull << 11);
+    CpuThrottle throttle(&msr);
+    throttle.Update(0, {});
+    CHECK(throttle.Active(THROTTLE_PL2));
+
+    // A failed read falls back to the package status for that update only
+    msr.Remove(0, PERF_LIMIT_REASONS);
+    throttle.Update(1, {});
+    CHECK(throttle.Active(THROTTLE_PL1) && !throttle.Active(THROTTLE_PL2));
+    msr.Set(0, PERF_LIMIT_REASONS, 1ull << 11);
+    throttle.Update(2, {});
+    CHECK(throttle.Active(THROTTLE_PL2) && !throttle.Active(THROTTLE_PL1));
+
+    // Three failures in a row: the register is taken as missing and no longer read
+    msr.Remove(0, PERF_LIMIT_REASONS);
+    for (int64_t t = 3; t < 6; t++) throttle.Update(t, {});
+    msr.Set(0, PERF_LIMIT_REASONS, 1ull << 11);
+    int reads = msr.readCalls;
+    throttle.Update(6, {});
+    CHECK(msr.readCalls == reads + 1);      // Only the package status
+    CHECK(throttle.Active(THROTTLE_PL1) && !throttle.Active(THROTTLE_PL2));
+}
+
+
+TEST(CpuThrottle, AnyPackageThrottles) {
+    // Two packages, read on their first processors 0 and 2; only the second one is limited
+    FakeMsrReader msr(4);
+    for (int processor : { 0, 2 }) {
+        msr.Set(processor, PACKAGE_THERM_STATUS, 0);
+        msr.Set(processor, PERF_LIMIT_REASONS, 0);
+    }
+    msr.Set(2, PERF_LIMIT_REASONS, 1ull << 1);
+    CpuThrottle throttle(&msr);
+    std::vector<int> packages = { 0, 2 };
+    CHECK(throttle.Update(0, packages));
+    CHECK(throttle.Active(THROTTLE_THERMAL));
+
+    // Without the package list only processor 0 is read
+    CpuThrottle first(&msr);
+    CHECK(first.Update(0, {}));
+    CHECK(!first.Throttling());
+
+    // A package that cannot be read is left out; none readable means no status
+    msr.Remove(0, PACKAGE_THERM_STATUS);
+    CHECK(throttle.Update(1, packages));
+    CHECK(throttle.Active(THROTTLE_THERMAL));
+    msr.Remove(2, PACKAGE_THERM_STATUS);
+    CHECK(!throttle.Update(2, packages));
+    CHECK(!throttle.Valid());
+}
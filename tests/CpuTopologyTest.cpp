@@ -0,0 +1,156 @@
+// Tests of the processor topology from made-up GetLogicalProcessorInformationEx records, see CpuTopology.h
+
+#include "Test.h"
+
+#include <string.h>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+// Records of GetLogicalProcessorInformationEx(RelationAll), appended one by one
+class RecordList {
+public:
+    // A core or package record over 'masks', given as pairs of group and processor mask
+    void Add(uint32_t relationship, int efficiencyClass, const std::vector<std::pair<int, uintptr_t>>& masks) {
+        size_t size = offsetof(ProcessorRecord, groupMask) + masks.size() * sizeof(ProcessorGroupMask);
+        std::vector<uint8_t> record(size, 0);
+        ProcessorRecord header = {};
+        header.relationship = relationship;
+        header.size = static_cast<uint32_t>(size);
+        header.efficiencyClass = static_cast<uint8_t>(efficiencyClass);
+        header.groupCount = static_cast<uint16_t>(masks.size());
+        memcpy(record.data(), &header, offsetof(ProcessorRecord, groupMask));
+        for (size_t i = 0; i < masks.size(); i++) {
+            ProcessorGroupMask mask = {};
+            mask.group = static_cast<uint16_t>(masks[i].first);
+            mask.mask = masks[i].second;
+            memcpy(record.data() + offsetof(ProcessorRecord, groupMask) + i * sizeof(mask), &mask, sizeof(mask));
+        }
+        bytes.insert(bytes.end(), record.begin(), record.end());
+    }
+
+    void Core(int efficiencyClass, uintptr_t mask) { Add(RELATION_PROCESSOR_CORE, efficiencyClass, { { 0, mask } }); }
+    void Package(uintptr_t mask) { Add(RELATION_PROCESSOR_PACKAGE, 0, { { 0, mask } }); }
+
+    // A record of another relationship (a cache, a NUMA node), which the parser skips by its size.
+    // The header is written even for a size too small to hold it, as a damaged record
+    void Other(uint32_t relationship, uint32_t size) {
+        std::vector<uint8_t> record((size < 8) ? 8 : size, 0xA5);
+        memcpy(record.data(), &relationship, 4);
+        memcpy(record.data() + 4, &size, 4);
+        bytes.insert(bytes.end(), record.begin(), record.end());
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
+
+// Compare lists of processors; as a function, the braces of the expected list stay out of CHECK
+static bool Processors(const std::vector<int>& actual, const std::vector<int>& expected) {
+    return actual == expected;
+}
+
+
+TEST(CpuTopology, HybridCoresWithSmt) {
+    // 2 P-cores with two threads each (efficiency class 1) and 4 E-cores (class 0) in one package
+    RecordList list;
+    list.Core(1, 0x03);
+    list.Core(1, 0x0C);
+    for (int core = 4; core < 8; core++) list.Core(0, static_cast<uintptr_t>(1) << core);
+    list.Other(2, 56);      // An L3 cache
+    list.Package(0xFF);
+
+    CpuTopology topology;
+    topology.Build(list.bytes.data(), list.bytes.size(), { 8 });
+    CHECK(!topology.Empty());
+    CHECK(topology.Hybrid());
+    CHECK(topology.PackageCount() == 1);
+    CHECK(topology.ClassCount() == 2);
+    CHECK(topology.FindClass("P") == 1);
+    CHECK(topology.FindClass("E") == 0);
+    CHECK(topology.FindClass("X") == -1);
+    CHECK(Processors(topology.ClassProcessors(topology.FindClass("P")), { 0, 1, 2, 3 }));
+    CHECK(Processors(topology.ClassProcessors(topology.FindClass("E")), { 4, 5, 6, 7 }));
+    CHECK(Processors(topology.PackageProcessors(0), { 0, 1, 2, 3, 4, 5, 6, 7 }));
+}
+
+
+TEST(CpuTopology, SeveralPackages) {
+    // Two sockets of two cores with two threads each, a single core type with a class other than 0
+    RecordList list;
+    for (int core = 0; core < 4; core++) list.Core(2, static_cast<uintptr_t>(3) << (2 * core));
+    list.Package(0x0F);
+    list.Other(1, 80);      // A NUMA node
+    list.Package(0xF0);
+
+    CpuTopology topology;
+    topology.Build(list.bytes.data(), list.bytes.size(), { 8 });
+    CHECK(topology.PackageCount() == 2);
+    CHECK(Processors(topology.PackageProcessors(0), { 0, 1, 2, 3 }));
+    CHECK(Processors(topology.PackageProcessors(1), { 4, 5, 6, 7 }));
+    CHECK(!topology.Hybrid());
+
+    // Without hybrid cores "P" means all cores and "E" none
+    CHECK(topology.FindClass("P") == 0);
+    CHECK(topology.ClassProcessors(0).size() == 8);
+    CHECK(topology.FindClass("E") == -1);
+}
+
+
+TEST(CpuTopology, ProcessorGroups) {
+    // Processors numbered group by group: group 1 starts after the 4 of group 0. Bits beyond the active
+    // processors of a group and groups that are not active are ignored
+    RecordList list;
+    list.Add(RELATION_PROCESSOR_CORE, 1, { { 0, 0x0F } });
+    list.Add(RELATION_PROCESSOR_CORE, 0, { { 1, 0x03 } });
+    list.Add(RELATION_PROCESSOR_PACKAGE, 0, { { 0, 0xFF }, { 1, 0x07 }, { 5, 0x01 } });
+
+    CpuTopology topology;
+    topology.Build(list.bytes.data(), list.bytes.size(), { 4, 2 });
+    CHECK(topology.PackageCount() == 1);
+    CHECK(Processors(topology.PackageProcessors(0), { 0, 1, 2, 3, 4, 5 }));
+    CHECK(Processors(topology.ClassProcessors(topology.FindClass("E")), { 4, 5 }));
+}
+
+
+TEST(CpuTopology, FallsBackWithoutRecords) {
+    // No records (the call failed): an empty topology, so package registers are read on processor 0
+    CpuTopology topology;
+    topology.Build(NULL, 0, { 8 });
+    CHECK(topology.Empty());
+    CHECK(topology.PackageCount() == 0);
+    CHECK(topology.FindClass("P") == -1);
+    CHECK(topology.FindClass("E") == -1);
+
+    // A damaged record ends the list; what came before it is kept
+    RecordList list;
+    list.Package(0x03);
+    list.Other(3, 0);
+    list.Package(0x0C);
+    topology.Build(list.bytes.data(), list.bytes.size(), { 4 });
+    CHECK(topology.PackageCount() == 1);
+    CHECK(Processors(topology.PackageProcessors(0), { 0, 1 }));
+
+    // A list cut short in a record is read up to that record
+    list = RecordList();
+    list.Package(0x03);
+    list.Core(1, 0x03);
+    topology.Build(list.bytes.data(), list.bytes.size() - 4, { 4 });
+    CHECK(topology.PackageCount() == 1);
+    CHECK(!topology.Hybrid());
+}
+
+
+TEST(CpuTopology, UncoveredProcessorsAreLeftOut) {
+    // A processor without a package record does not count, nor does its core class
+    RecordList list;
+    list.Core(1, 0x03);
+    list.Core(0, 0x04);
+    list.Package(0x03);
+    CpuTopology topology;
+    topology.Build(list.bytes.data(), list.bytes.size(), { 3 });
+    CHECK(Processors(topology.PackageProcessors(0), { 0, 1 }));
+    CHECK(!topology.Hybrid());
+    CHECK(topology.FindClass("P") == 0);
+}
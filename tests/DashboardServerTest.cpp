@@ -0,0 +1,143 @@
+// Tests of the web dashboard, see DashboardServer.h. A loopback socket plays the browser.
+
+#include "Test.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DashboardServer.h"
+#include "Metrics.h"
+#include "TestSockets.h"
+
+
+// A port that was free a moment ago
+static int FreePort() {
+    LoopbackSocket probe(true);
+    probe.Bind(0, false);
+    return probe.Port();
+}
+
+
+// Read from 'browser' until 'text' arrived after 'from', or nothing more arrives within a second; returns
+// the offset past 'text', or std::string::npos
+static size_t ReadUntil(const LoopbackSocket& browser, std::string* received, const std::string& text, size_t from = 0) {
+    for (;;) {
+        size_t found = received->find(text, from);
+        if (found != std::string::npos) return found + text.size();
+        char data[8192];
+        int size = browser.Receive(data, sizeof(data), 1000);
+        if (size <= 0) return std::string::npos;
+        received->append(data, size);
+    }
+}
+
+
+static bool Request(LoopbackSocket* browser, int port, const char* path) {
+    return browser->Connect(port) && browser->Send(std::string("GET ") + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+}
+
+
+TEST(DashboardServer, ServesPage) {
+    int port = FreePort();
+    DashboardServer server;
+    CHECK(server.Start(port));
+
+    LoopbackSocket browser(true);
+    CHECK(Request(&browser, port, "/"));
+    std::string response;
+    size_t body = ReadUntil(browser, &response, "\r\n\r\n");
+    CHECK(response.find("HTTP/1.1 200 OK\r\n") == 0);
+    CHECK(response.find("Content-Type: text/html") != std::string::npos);
+    ReadUntil(browser, &response, "</html>");
+    size_t length = response.find("Content-Length: ");
+    CHECK(body != std::string::npos && length != std::string::npos);
+    if (body != std::string::npos && length != std::string::npos) {
+        CHECK(response.size() - body == std::stoul(response.substr(length + 16)));
+    }
+    CHECK(response.find("new EventSource(\"events\")") != std::string::npos);
+
+    LoopbackSocket other(true);
+    CHECK(Request(&other, port, "/favicon.ico"));
+    std::string notFound;
+    CHECK(ReadUntil(other, &notFound, "\r\n\r\n") != std::string::npos);
+    CHECK(notFound.find("HTTP/1.1 404 Not Found\r\n") == 0);
+    server.Stop();
+}
+
+
+TEST(DashboardServer, StreamsFullThenChangedValues) {
+    int port = FreePort();
+    DashboardServer server;
+    CHECK(server.Start(port));
+    double values[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) values[i] = i;
+    values[METRIC_GPU_TEMP] = NAN;
+    server.Publish(1700000000, values);
+
+    // A viewer connecting after a tick gets all values of that tick at once
+    LoopbackSocket browser(true);
+    CHECK(Request(&browser, port, "/events"));
+    std::string stream;
+    size_t at = ReadUntil(browser, &stream, "retry: 2000\n\n");
+    CHECK(stream.find("Content-Type: text/event-stream") != std::string::npos);
+    at = ReadUntil(browser, &stream, "}}\n\n", at);
+    CHECK(at != std::string::npos);
+    std::string full = stream.substr(0, at);
+    CHECK(full.find("data: {\"time\":1700000000,\"values\":{\"cpu_load\":0,\"cpu_power\":1,") != std::string::npos);
+    CHECK(full.find("\"gpu_temp\":null") != std::string::npos);
+    CHECK(full.find("\"net_tx\":33}}") != std::string::npos);
+
+    // The next tick only carries what changed
+    values[METRIC_CPU_TEMP] = 71.5;
+    values[METRIC_GPU_TEMP] = 60.0;
+    server.Publish(1700000001, values);
+    size_t end = ReadUntil(browser, &stream, "}}\n\n", at);
+    CHECK(end != std::string::npos);
+    if (end != std::string::npos) {
+        CHECK(stream.substr(at, end - at) == "data: {\"time\":1700000001,\"values\":{\"cpu_temp\":71.5,\"gpu_temp\":60}}\n\n");
+    }
+
+    // Stopping the server ends the stream
+    server.Stop();
+    char data[256];
+    int size;
+    while ((size = browser.Receive(data, sizeof(data), 1000)) > 0) {}
+    CHECK(size == 0);
+}
+
+
+TEST(DashboardServer, RefusesViewersOverLimit) {
+    int port = FreePort();
+    DashboardServer server;
+    CHECK(server.Start(port));
+    double values[METRIC_COUNT] = {};
+    server.Publish(1700000000, values);
+
+    std::vector<std::unique_ptr<LoopbackSocket>> viewers;
+    for (int i = 0; i < DashboardServer::MAX_VIEWERS; i++) {
+        viewers.emplace_back(new LoopbackSocket(true));
+        std::string stream;
+        CHECK(Request(viewers.back().get(), port, "/events"));
+        CHECK(ReadUntil(*viewers.back(), &stream, "}}\n\n") != std::string::npos);
+    }
+
+    LoopbackSocket extra(true);
+    CHECK(Request(&extra, port, "/events"));
+    std::string response;
+    CHECK(ReadUntil(extra, &response, "\r\n\r\n") != std::string::npos);
+    CHECK(response.find("HTTP/1.1 503 Service Unavailable\r\n") == 0);
+
+    // A viewer leaving frees its slot once the server noticed, at the latest when it sends the next tick
+    viewers[0].reset();
+    bool served = false;
+    for (int attempt = 0; attempt < 20 && !served; attempt++) {
+        server.Publish(1700000001 + attempt, values);
+        LoopbackSocket retry(true);
+        std::string stream;
+        served = Request(&retry, port, "/events") && ReadUntil(retry, &stream, "\r\n\r\n") != std::string::npos &&
+            stream.find("HTTP/1.1 200 OK\r\n") == 0;
+    }
+    CHECK(served);
+    server.Stop();
+}
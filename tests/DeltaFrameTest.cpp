@@ -0,0 +1,99 @@
+// Tests of the delta frames of the subscription stream, see DeltaFrame.h
+
+#include "Test.h"
+
+#include <string.h>
+
+#include "DeltaFrame.h"
+
+
+static uint64_t FrameMask(const uint8_t* frame) {
+    uint64_t mask;
+    memcpy(&mask, frame + 16, sizeof(mask));
+    return mask;
+}
+
+
+TEST(DeltaFrame, FirstFrameCarriesAllSubscribedValues) {
+    double values[FRAME_MAX_VALUES];
+    for (int i = 0; i < FRAME_MAX_VALUES; i++) values[i] = i * 1.5;
+    uint64_t subscription = (1ull << 0) | (1ull << 5) | (1ull << 63);
+    DeltaEncoder encoder(subscription);
+    uint8_t frame[FRAME_MAX_SIZE];
+    size_t size = encoder.Encode(1700000000, values, frame);
+    CHECK(size == FRAME_HEADER_SIZE + 3 * sizeof(double));
+    CHECK(FrameMask(frame) == subscription);
+
+    double received[FRAME_MAX_VALUES] = {};
+    int64_t timestamp = 0;
+    CHECK(ApplyDeltaFrame(frame, size, &timestamp, received));
+    CHECK(timestamp == 1700000000);
+    CHECK(received[0] == 0.0 && received[5] == 7.5 && received[63] == 94.5);
+    CHECK(received[1] == 0.0);      // Not subscribed
+}
+
+
+TEST(DeltaFrame, SendsOnlyChanges) {
+    double values[FRAME_MAX_VALUES];
+    for (int i = 0; i < FRAME_MAX_VALUES; i++) values[i] = 20.0 + i;
+    DeltaEncoder encoder(~0ull);
+    uint8_t frame[FRAME_MAX_SIZE];
+    double received[FRAME_MAX_VALUES];
+    int64_t timestamp = 0;
+    size_t size = encoder.Encode(100, values, frame);
+    CHECK(size == FRAME_MAX_SIZE);
+    CHECK(ApplyDeltaFrame(frame, size, &timestamp, received));
+
+    values[3] = 99.0;
+    values[40] = -1.0;
+    size = encoder.Encode(101, values, frame);
+    CHECK(size == FRAME_HEADER_SIZE + 2 * sizeof(double));
+    CHECK(FrameMask(frame) == ((1ull << 3) | (1ull << 40)));
+    CHECK(ApplyDeltaFrame(frame, size, &timestamp, received));
+    CHECK(timestamp == 101);
+    CHECK(memcmp(received, values, sizeof(values)) == 0);
+}
+
+
+TEST(DeltaFrame, QuietTickIsAHeartbeat) {
+    double values[FRAME_MAX_VALUES];
+    for (int i = 0; i < FRAME_MAX_VALUES; i++) values[i] = NAN;
+    values[2] = 45.0;
+    DeltaEncoder encoder(~0ull);
+    uint8_t frame[FRAME_MAX_SIZE];
+    encoder.Encode(100, values, frame);
+
+    // Unchanged values, unavailable ones included, are not resent, but the time still advances
+    size_t size = encoder.Encode(101, values, frame);
+    CHECK(size == FRAME_HEADER_SIZE);
+    CHECK(FrameMask(frame) == 0);
+    double received[FRAME_MAX_VALUES] = {};
+    received[2] = 45.0;
+    int64_t timestamp = 0;
+    CHECK(ApplyDeltaFrame(frame, size, &timestamp, received));
+    CHECK(timestamp == 101 && received[2] == 45.0);
+}
+
+
+TEST(DeltaFrame, RejectsMalformedFrames) {
+    double values[FRAME_MAX_VALUES] = {};
+    DeltaEncoder encoder(0xFFull);
+    uint8_t frame[FRAME_MAX_SIZE];
+    size_t size = encoder.Encode(100, values, frame);
+    double received[FRAME_MAX_VALUES];
+    int64_t timestamp = 0;
+
+    CHECK(!ApplyDeltaFrame(frame, FRAME_HEADER_SIZE - 1, &timestamp, received));
+    CHECK(!ApplyDeltaFrame(frame, size - 8, &timestamp, received));     // Size field disagrees
+
+    uint8_t copy[FRAME_MAX_SIZE];
+    memcpy(copy, frame, size);
+    copy[4] = 2;        // Unknown version
+    CHECK(!ApplyDeltaFrame(copy, size, &timestamp, received));
+
+    memcpy(copy, frame, size);
+    copy[16] = 0xFF;
+    copy[17] = 0x01;    // Mask announces more values than the frame holds
+    CHECK(!ApplyDeltaFrame(copy, size, &timestamp, received));
+    CHECK(ApplyDeltaFrame(frame, size, &timestamp, received));
+}
@@ -0,0 +1,113 @@
+// Tests of the APERF/MPERF effective clocks, see EffectiveClock.h
+
+#include "Test.h"
+
+#include "EffectiveClock.h"
+#include "FakeMsr.h"
+
+
+static const double BASE_MHZ = 3000.0;
+
+
+// Advance the counters of one processor over a tick of 'tsc' cycles, busy for 'busy' of it at 'mhz'
+static void Run(FakeMsrReader* msr, int processor, uint64_t tsc, double busy, double mhz) {
+    uint64_t mperf = static_cast<uint64_t>(tsc * busy);
+    msr->Add(processor, MSR_TIME_STAMP_COUNTER, tsc);
+    msr->Add(processor, MSR_MPERF, mperf);
+    msr->Add(processor, MSR_APERF, static_cast<uint64_t>(mperf * mhz / BASE_MHZ));
+}
+
+
+static void Start(FakeMsrReader* msr, int processor, uint64_t tsc, uint64_t mperf, uint64_t aperf) {
+    msr->Set(processor, MSR_TIME_STAMP_COUNTER, tsc);
+    msr->Set(processor, MSR_MPERF, mperf);
+    msr->Set(processor, MSR_APERF, aperf);
+}
+
+
+TEST(EffectiveClock, ClocksFromCounterDeltas) {
+    FakeMsrReader msr(2);
+    Start(&msr, 0, 1000, 500, 400);
+    Start(&msr, 1, 2000, 700, 900);
+    EffectiveClock clock(&msr);
+    CHECK(clock.Update(BASE_MHZ));
+    CHECK(!clock.Valid());      // One reading gives no interval yet
+
+    Run(&msr, 0, 3000000000ull, 0.5, 4500.0);
+    Run(&msr, 1, 3000000000ull, 0.25, 1500.0);
+    CHECK(clock.Update(BASE_MHZ));
+    CHECK(clock.Measured());
+    CHECK_NEAR(clock.Clock(0), 4500.0, 0.01);
+    CHECK_NEAR(clock.Clock(1), 1500.0, 0.01);
+    CHECK_NEAR(clock.Min(), 1500.0, 0.01);
+    CHECK_NEAR(clock.Max(), 4500.0, 0.01);
+    CHECK_NEAR(clock.BusyWeighted(), (4500.0 * 0.5 + 1500.0 * 0.25) / 0.75, 0.01);
+    CHECK_NEAR(clock.Load({ 0, 1 }), 37.5, 1e-6);
+    CHECK_NEAR(clock.BusyWeighted({ 1 }), 1500.0, 0.01);
+}
+
+
+TEST(EffectiveClock, CountersWrapAround) {
+    // TSC and APERF pass 2^64 during the tick; the unsigned deltas still hold
+    FakeMsrReader msr(1);
+    Start(&msr, 0, ~0ull - 1000000, 1000, ~0ull - 5000);
+    EffectiveClock clock(&msr);
+    clock.Update(BASE_MHZ);
+    Run(&msr, 0, 3000000000ull, 0.8, 3600.0);
+    CHECK(msr.Get(0, MSR_TIME_STAMP_COUNTER) < 3000000000ull);
+    CHECK(msr.Get(0, MSR_APERF) < 3000000000ull);
+
+    CHECK(clock.Update(BASE_MHZ));
+    CHECK_NEAR(clock.Clock(0), 3600.0, 0.01);
+    CHECK_NEAR(clock.Load({ 0 }), 80.0, 1e-6);
+}
+
+
+TEST(EffectiveClock, KeepsLastClockAcrossCounterReset) {
+    FakeMsrReader msr(1);
+    Start(&msr, 0, 1000, 1000, 1000);
+    EffectiveClock clock(&msr);
+    clock.Update(BASE_MHZ);
+    Run(&msr, 0, 3000000000ull, 1.0, 2400.0);
+    clock.Update(BASE_MHZ);
+    CHECK_NEAR(clock.Clock(0), 2400.0, 0.01);
+
+    // Firmware cleared MPERF and APERF on resume: the interval is skipped, the next one is measured again
+    msr.Set(0, MSR_MPERF, 10);
+    msr.Set(0, MSR_APERF, 10);
+    Run(&msr, 0, 3000000000ull, 1.0, 4000.0);
+    CHECK(clock.Update(BASE_MHZ));
+    CHECK_NEAR(clock.Clock(0), 2400.0, 0.01);
+    Run(&msr, 0, 3000000000ull, 1.0, 4000.0);
+    CHECK(clock.Update(BASE_MHZ));
+    CHECK_NEAR(clock.Clock(0), 4000.0, 0.01);
+}
+
+
+TEST(EffectiveClock, ReadFailureInvalidates) {
+    FakeMsrReader msr(1);
+    Start(&msr, 0, 1000, 1000, 1000);
+    EffectiveClock clock(&msr);
+    clock.Update(BASE_MHZ);
+    Run(&msr, 0, 3000000000ull, 1.0, 3000.0);
+    CHECK(clock.Update(BASE_MHZ) && clock.Valid());
+
+    msr.failReads = true;
+    CHECK(!clock.Update(BASE_MHZ));
+    CHECK(!clock.Valid());
+
+    // Reads work again: the first interval starts over
+    msr.failReads = false;
+    CHECK(clock.Update(BASE_MHZ) && !clock.Valid());
+    CHECK(!clock.Update(0.0));
+}
+
+
+TEST(EffectiveClock, ReportedClocksWithoutCounters) {
+    EffectiveClock clock(NULL);
+    CHECK(!clock.Update(BASE_MHZ));
+    const double mhz[] = { 3200.0, 4800.0 };
+    clock.UpdateFromCurrentClocks(mhz, 2);
+    CHECK(clock.Valid() && !clock.Measured());
+    CHECK_NEAR(clock.Average(), 4000.0, 1e-9);
+}
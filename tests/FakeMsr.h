@@ -0,0 +1,47 @@
+// MsrReader over registers held in memory, for the tests of the MSR engines
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Msr.h"
+
+
+class FakeMsrReader : public MsrReader {
+public:
+    explicit FakeMsrReader(int processorCount) : registers(processorCount) {}
+
+    int ProcessorCount() const override { return static_cast<int>(registers.size()); }
+
+    // Fails like the driver when a register is missing or reads are switched off
+    bool Read(int processor, const uint32_t* indices, int count, uint64_t* values) override {
+        readCalls++;
+        if (failReads) return false;
+        for (int i = 0; i < count; i++) {
+            std::map<uint32_t, uint64_t>::const_iterator found = registers[processor].find(indices[i]);
+            if (found == registers[processor].end()) return false;
+            values[i] = found->second;
+        }
+        return true;
+    }
+
+    bool Write(int processor, uint32_t index, uint64_t value) override {
+        writeCalls++;
+        registers[processor][index] = value;
+        return true;
+    }
+
+    void Set(int processor, uint32_t index, uint64_t value) { registers[processor][index] = value; }
+    void Add(int processor, uint32_t index, uint64_t delta) { registers[processor][index] += delta; }
+    uint64_t Get(int processor, uint32_t index) { return registers[processor][index]; }
+    // Take a register away, so that reading it fails until it is set again
+    void Remove(int processor, uint32_t index) { registers[processor].erase(index); }
+
+    int readCalls = 0;
+    int writeCalls = 0;
+    bool failReads = false;
+
+private:
+    std::vector<std::map<uint32_t, uint64_t>> registers;
+};
@@ -0,0 +1,105 @@
+// Tests of the fan anomaly detection, see FanHealth.h
+
+#include "Test.h"
+
+#include "FanHealth.h"
+
+
+// Fan curve of the synthetic trace: off below 45 degrees (zero-RPM mode), then rising to 3000 RPM at 89
+static double NormalRpm(double temperature) {
+    return (temperature < 45.0) ? 0.0 : 800.0 + 50.0 * (temperature - 45.0);
+}
+
+static double Load(double temperature) {
+    return (temperature - 30.0) / 60.0 * 100.0;
+}
+
+
+// A day of temperature cycles between 30 and 85 degrees with the fan following its curve, +-2% jitter
+static void Train(FanMonitor* monitor) {
+    for (int i = 0; i < 24 * 3600; i++) {
+        double temperature = 57.5 + 27.5 * sin(i * 2.0 * 3.14159265358979 / 1200.0);
+        double jitter = 1.0 + 0.02 * sin(i * 0.37);
+        monitor->Update(NormalRpm(temperature) * jitter, temperature, Load(temperature));
+    }
+}
+
+
+// Feed 'count' samples at a fixed temperature and speed
+static void Hold(FanMonitor* monitor, int count, double temperature, double rpm) {
+    for (int i = 0; i < count; i++) monitor->Update(rpm, temperature, Load(temperature));
+}
+
+
+TEST(FanHealth, LearnsTheFanCurve) {
+    FanMonitor monitor;
+    double rpm = 0.0;
+    CHECK(!monitor.ExpectedRpm(&rpm));
+    Hold(&monitor, 1, 60.0, NormalRpm(60.0));
+    CHECK(monitor.Health() == FAN_LEARNING);
+
+    Train(&monitor);
+    Hold(&monitor, 1, 72.0, NormalRpm(72.0));
+    CHECK(monitor.Health() == FAN_OK);
+    CHECK(monitor.ExpectedRpm(&rpm));
+    CHECK_NEAR(rpm, NormalRpm(72.0), 0.1 * NormalRpm(72.0));
+}
+
+
+TEST(FanHealth, ReportsPersistentStall) {
+    FanMonitor monitor;
+    Train(&monitor);
+    Hold(&monitor, 9, 72.0, 0.0);
+    CHECK(monitor.Health() == FAN_OK);      // A single dropout is not a fault
+    Hold(&monitor, 1, 72.0, 0.0);
+    CHECK(monitor.Health() == FAN_STALLED);
+
+    Hold(&monitor, 1, 72.0, NormalRpm(72.0));
+    CHECK(monitor.Health() == FAN_OK);
+}
+
+
+TEST(FanHealth, ZeroRpmModeIsNotAStall) {
+    FanMonitor monitor;
+    Train(&monitor);
+    Hold(&monitor, 600, 35.0, 0.0);
+    CHECK(monitor.Health() == FAN_OK);
+}
+
+
+TEST(FanHealth, StallWithoutHistoryWhenHot) {
+    // Just installed: a stopped fan is fine while warm, not at the stall temperature
+    FanMonitor monitor;
+    Hold(&monitor, 30, 60.0, 0.0);
+    CHECK(monitor.Health() == FAN_LEARNING);
+    Hold(&monitor, 9, 85.0, 0.0);
+    CHECK(monitor.Health() == FAN_LEARNING);
+    Hold(&monitor, 1, 85.0, 0.0);
+    CHECK(monitor.Health() == FAN_STALLED);
+}
+
+
+TEST(FanHealth, ReportsDegradedBearing) {
+    FanMonitor monitor;
+    Train(&monitor);
+    Hold(&monitor, 59, 72.0, 0.4 * NormalRpm(72.0));
+    CHECK(monitor.Health() == FAN_OK);
+    Hold(&monitor, 1, 72.0, 0.4 * NormalRpm(72.0));
+    CHECK(monitor.Health() == FAN_DEGRADED);
+
+    // The slow samples were not learned: the expectation is still the healthy speed
+    double rpm = 0.0;
+    CHECK(monitor.ExpectedRpm(&rpm));
+    CHECK_NEAR(rpm, NormalRpm(72.0), 0.1 * NormalRpm(72.0));
+}
+
+
+TEST(FanHealth, ReportsFanStuckAtFullSpeed) {
+    FanMonitor monitor;
+    Train(&monitor);
+    double fullSpeed = NormalRpm(85.0);
+    Hold(&monitor, 119, 50.0, fullSpeed);
+    CHECK(monitor.Health() == FAN_OK);
+    Hold(&monitor, 1, 50.0, fullSpeed);
+    CHECK(monitor.Health() == FAN_STUCK_MAX);
+}
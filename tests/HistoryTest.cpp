@@ -0,0 +1,159 @@
+// Tests of the Gorilla-compressed history, see History.h
+
+#include "Test.h"
+
+#include <string.h>
+#include <vector>
+
+#include "History.h"
+
+
+// Sensor-like series: slow drift with noise, integer steps, repeats and a sign change
+static double SampleValue(int i) {
+    switch ((i / 50) % 4) {
+    case 0:  return 40.0 + 0.01 * i + 0.37 * sin(i * 0.7);
+    case 1:  return static_cast<double>(1000 + (i % 7) * 25);
+    case 2:  return 12.5;
+    default: return -3.0e-5 * i;
+    }
+}
+
+
+static bool SameBits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+
+TEST(History, RoundTripIsExact) {
+    HistorySeries series(1000000);
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    int64_t timestamp = 1700000000;
+    for (int i = 0; i < 1000; i++) {
+        timestamp += (i % 97 == 0) ? 30 : 1;    // Gaps, as when the plugin did not sample for a while
+        timestamps.push_back(timestamp);
+        values.push_back(SampleValue(i));
+        series.Append(timestamp, values.back());
+    }
+    CHECK(series.SampleCount() == 1000);
+
+    std::vector<int64_t> readTimestamps(1000);
+    std::vector<double> readValues(1000);
+    size_t count = series.Read(timestamps.front(), timestamps.back(), readTimestamps.data(), readValues.data(), 1000);
+    CHECK(count == 1000);
+    for (size_t i = 0; i < count && i < 1000; i++) {
+        if (readTimestamps[i] != timestamps[i] || !SameBits(readValues[i], values[i])) {
+            printf("  sample %d differs\n", static_cast<int>(i));
+            CHECK(false);
+            break;
+        }
+    }
+}
+
+
+TEST(History, ReadsPartialRange) {
+    HistorySeries series(1000000);
+    for (int i = 0; i < 500; i++) series.Append(1000 + i, i);
+
+    int64_t timestamps[500];
+    double values[500];
+    size_t count = series.Read(1130, 1249, timestamps, values, 500);
+    CHECK(count == 120);
+    CHECK(timestamps[0] == 1130 && values[0] == 130.0);
+    CHECK(timestamps[119] == 1249 && values[119] == 249.0);
+
+    CHECK(series.Read(1130, 1249, timestamps, values, 10) == 10);
+}
+
+
+TEST(History, SkipsNanAndOldSamples) {
+    HistorySeries series(1000000);
+    series.Append(100, 1.0);
+    series.Append(101, NAN);
+    series.Append(101, 2.0);
+    series.Append(101, 3.0);
+    series.Append(50, 4.0);
+    CHECK(series.SampleCount() == 2);
+    CHECK(series.OldestTimestamp() == 100 && series.NewestTimestamp() == 101);
+}
+
+
+TEST(History, AggregateMatchesSamples) {
+    HistorySeries series(1000000);
+    for (int i = 0; i < 600; i++) series.Append(i, SampleValue(i));
+
+    // A range cutting blocks on both ends, so both the summaries and decoded samples are used
+    int64_t from = 77, to = 431;
+    double min = INFINITY, max = -INFINITY, sum = 0.0;
+    for (int64_t i = from; i <= to; i++) {
+        double value = SampleValue(static_cast<int>(i));
+        if (value < min) min = value;
+        if (value > max) max = value;
+        sum += value;
+    }
+
+    HistoryAggregate aggregate;
+    CHECK(series.Aggregate(from, to, &aggregate));
+    CHECK(aggregate.count == to - from + 1);
+    CHECK(aggregate.min == min);
+    CHECK(aggregate.max == max);
+    CHECK_NEAR(aggregate.sum, sum, 1e-9 * fabs(sum) + 1e-9);
+
+    CHECK(!series.Aggregate(1000, 2000, &aggregate));
+}
+
+
+TEST(History, DropsBlocksOutsideRetention) {
+    HistorySeries series(3600);
+    for (int i = 0; i < 3 * 3600; i++) series.Append(i, 20.0);
+    CHECK(series.OldestTimestamp() >= 2 * 3600 - HistoryBlock::SAMPLES_PER_BLOCK);
+    CHECK(series.OldestTimestamp() <= 2 * 3600);
+    CHECK(series.NewestTimestamp() == 3 * 3600 - 1);
+}
+
+
+TEST(History, CompressesSteadySeries) {
+    // A constant value sampled every second takes two bits per sample; with the block summaries a day
+    // stays below 2 bytes per sample, an eighth of the 16 bytes of raw timestamp and value
+    HistorySeries series(1000000);
+    for (int i = 0; i < 24 * 3600; i++) series.Append(i, 45.0);
+    CHECK(series.SampleCount() == 24 * 3600);
+    CHECK(series.ByteSize() < 2 * 24 * 3600);
+}
+
+
+TEST(History, AppendCost) {
+    // 72 hours of a CPU temperature: load cycles of ten minutes and noise, in the quarter degree steps
+    // the sensors report
+    const int samples = 72 * 3600;
+    std::vector<double> trace(samples);
+    uint32_t seed = 1;
+    for (int i = 0; i < samples; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        double noise = ((seed >> 16) % 5) * 0.25;
+        trace[i] = floor((55.0 + 15.0 * sin(i * 6.283185307179586 / 600.0) + noise) * 4.0) / 4.0;
+    }
+
+    HistorySeries series(samples);
+    int64_t start = 1700000000;
+    Benchmark("HistorySeries::Append", samples, [&](int i) { series.Append(start + i, trace[i]); });
+    double bytesPerSample = static_cast<double>(series.ByteSize()) / series.SampleCount();
+    printf("  bytes per sample: %.2f\n", bytesPerSample);
+    CHECK(series.SampleCount() == static_cast<size_t>(samples));
+    CHECK(bytesPerSample < 4.0);
+
+    // A 28-hour aggregate decodes only the two blocks cut by the range; reading an hour decodes it all
+    HistoryAggregate aggregate = {};
+    int64_t end = start + samples - 1;
+    Benchmark("Aggregate over 28 h", 1000, [&](int i) { series.Aggregate(end - 28 * 3600 - i, end - i, &aggregate); });
+    CHECK(aggregate.count == 28 * 3600 + 1);
+
+    std::vector<int64_t> timestamps(3600);
+    std::vector<double> values(3600);
+    size_t read = 0;
+    Benchmark("Read of 1 h", 100, [&](int) {
+        read = series.Read(end - 3599, end, timestamps.data(), values.data(), 3600);
+    });
+    CHECK(read == 3600);
+    CHECK(values[3599] == trace[samples - 1]);
+}
@@ -0,0 +1,171 @@
+// Tests of the push to a collector, see MetricExporter.h. A loopback socket stands in for the collector.
+
+#include "Test.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "MetricExporter.h"
+#include "Metrics.h"
+#include "TestSockets.h"
+
+
+static void Readings(double* values) {
+    for (int i = 0; i < METRIC_COUNT; i++) values[i] = i * 1.5;
+    values[METRIC_CPU_FAN_RPM] = NAN;               // Unavailable, not sent
+    values[METRIC_GPU_MEM_ALLOC] = 8.5e9;
+}
+
+
+// Every datagram the collector received within 'milliseconds'
+static std::vector<std::string> ReceiveDatagrams(const LoopbackSocket& collector, int milliseconds) {
+    std::vector<std::string> datagrams;
+    char data[65536];
+    int size;
+    while ((size = collector.Receive(data, sizeof(data), milliseconds)) > 0) datagrams.push_back(std::string(data, size));
+    return datagrams;
+}
+
+
+TEST(MetricExporter, StatsdGaugesOverUdp) {
+    LoopbackSocket collector(false);
+    CHECK(collector.Bind(0, false));
+    std::string address = "127.0.0.1:" + std::to_string(collector.Port());
+
+    MetricExporter exporter;
+    CHECK(exporter.Open(address.c_str(), EXPORT_STATSD, "node1"));
+    double values[METRIC_COUNT];
+    Readings(values);
+    CHECK(exporter.Push(1700000000, values));
+
+    std::vector<std::string> datagrams = ReceiveDatagrams(collector, 500);
+    CHECK(!datagrams.empty());
+    std::string all;
+    for (const std::string& datagram : datagrams) {
+        CHECK(datagram.size() <= MetricExporter::PACKET_SIZE);
+        CHECK(datagram.back() == '\n');     // No metric is split between datagrams
+        all += datagram;
+    }
+    CHECK(all.find("cpugpu.cpu.load:0|g\n") == 0);
+    CHECK(all.find("\ncpugpu.cpu.temp:3|g\n") != std::string::npos);
+    CHECK(all.find("\ncpugpu.gpu.mem_alloc:8500000000|g\n") != std::string::npos);
+    CHECK(all.find("fan_rpm") == std::string::npos);
+
+    size_t lines = 0;
+    for (char c : all) lines += (c == '\n');
+    CHECK(lines == METRIC_COUNT - 1);
+}
+
+
+TEST(MetricExporter, InfluxLineOverUdp) {
+    LoopbackSocket collector(false);
+    CHECK(collector.Bind(0, false));
+    std::string address = "udp://127.0.0.1:" + std::to_string(collector.Port());
+
+    MetricExporter exporter;
+    CHECK(exporter.Open(address.c_str(), EXPORT_INFLUX, "node1"));
+    double values[METRIC_COUNT];
+    Readings(values);
+    CHECK(exporter.Push(1700000000, values));
+
+    std::vector<std::string> datagrams = ReceiveDatagrams(collector, 500);
+    CHECK(datagrams.size() == 1);
+    if (datagrams.size() != 1) return;
+    const std::string& line = datagrams[0];
+    CHECK(line.find("cpugpu,host=node1 cpu_load=0,cpu_power=1.5,cpu_temp=3,cpu_fan=6,") == 0);
+    CHECK(line.find(",gpu_mem_alloc=8500000000,") != std::string::npos);
+    CHECK(line.find(" 1700000000000000000\n") == line.size() - 21);
+
+    // A sample without any reading makes no line
+    for (int i = 0; i < METRIC_COUNT; i++) values[i] = NAN;
+    CHECK(exporter.Format(1700000001, values) == 0);
+}
+
+
+TEST(MetricExporter, TcpReconnectsAfterCollectorRestart) {
+    LoopbackSocket listener(true);
+    CHECK(listener.Bind(0, true));
+    int port = listener.Port();
+    std::string address = "tcp://127.0.0.1:" + std::to_string(port);
+
+    MetricExporter exporter;
+    CHECK(exporter.Open(address.c_str(), EXPORT_INFLUX, "node1"));
+    double values[METRIC_COUNT];
+    Readings(values);
+
+    // The connection completes in the background; pushes before that are dropped
+    LoopbackSocket connection(listener.Accept(1000));
+    CHECK(connection.Valid());
+    bool pushed = false;
+    for (int attempt = 0; attempt < 100 && !pushed; attempt++) {
+        pushed = exporter.Push(1700000000, values);
+        if (!pushed) connection.Readable(10);
+    }
+    CHECK(pushed);
+    char data[4096];
+    int size = connection.Receive(data, sizeof(data), 1000);
+    CHECK(size > 0 && std::string(data, size).find("cpugpu,host=node1 cpu_load=0,") == 0);
+
+    // The collector restarts: the push that hits the closed connection is dropped, a later one gets through
+    connection.Close();
+    listener.Close();
+    for (int attempt = 0; attempt < 10; attempt++) exporter.Push(1700000001 + attempt, values);
+    LoopbackSocket restarted(true);
+    CHECK(restarted.Bind(port, true));
+    pushed = false;
+    for (int attempt = 0; attempt < 100 && !pushed; attempt++) {
+        pushed = exporter.Push(1700000100 + attempt, values);
+        if (!pushed) restarted.Readable(10);
+    }
+    CHECK(pushed);
+    LoopbackSocket reconnected(restarted.Accept(1000));
+    size = reconnected.Receive(data, sizeof(data), 1000);
+    CHECK(size > 0 && std::string(data, size).find("cpugpu,host=node1 cpu_load=0,") == 0);
+}
+
+
+TEST(MetricExporter, RejectsAddressWithoutPort) {
+    MetricExporter exporter;
+    CHECK(!exporter.Open("localhost", EXPORT_STATSD, "node1"));
+    CHECK(!exporter.IsOpen());
+    double values[METRIC_COUNT];
+    Readings(values);
+    CHECK(!exporter.Push(1700000000, values));
+}
+
+
+TEST(MetricExporter, TcpHandshakeThatHangsIsStartedOver) {
+    LoopbackSocket listener(true);
+    CHECK(listener.Bind(0, true));
+    std::string address = "tcp://127.0.0.1:" + std::to_string(listener.Port());
+    double values[METRIC_COUNT];
+    Readings(values);
+
+    // Connections nobody accepts fill the backlog, so the handshake of the next one is not answered
+    MetricExporter fillers[8];
+    for (MetricExporter& filler : fillers) CHECK(filler.Open(address.c_str(), EXPORT_INFLUX, "filler"));
+    for (int attempt = 0; attempt < 5; attempt++) {
+        for (MetricExporter& filler : fillers) filler.Push(1700000000, values);
+        listener.Readable(10);
+    }
+    MetricExporter exporter;
+    CHECK(exporter.Open(address.c_str(), EXPORT_INFLUX, "node1"));
+    for (int64_t second = 0; second <= MetricExporter::CONNECT_TIMEOUT; second++) {
+        CHECK(!exporter.Push(1700000000 + second, values));
+    }
+
+    // The backlog drains: TCP would retry the abandoned handshake only a second after it started,
+    // the one opened by the next push is answered at once
+    for (MetricExporter& filler : fillers) filler.Close();
+    for (;;) {
+        LoopbackSocket waiting(listener.Accept(0));
+        if (!waiting.Valid()) break;
+    }
+    bool pushed = false;
+    for (int attempt = 0; attempt < 30 && !pushed; attempt++) {
+        pushed = exporter.Push(1700000010, values);
+        if (!pushed) listener.Readable(10);
+    }
+    CHECK(pushed);
+}
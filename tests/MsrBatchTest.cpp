@@ -0,0 +1,138 @@
+// Tests of the batched MSR pass, see MsrBatch.h
+
+#include "Test.h"
+
+#include "FakeMsr.h"
+#include "MsrBatch.h"
+
+
+static const uint32_t CLOCK_REGISTERS[] = { MSR_TIME_STAMP_COUNTER, MSR_MPERF, MSR_APERF };
+static const uint32_t THERM_STATUS = 0x19C;
+
+
+static void Fill(FakeMsrReader* msr) {
+    for (int i = 0; i < msr->ProcessorCount(); i++) {
+        for (uint32_t index : CLOCK_REGISTERS) msr->Set(i, index, 100 * i + index);
+        msr->Set(i, THERM_STATUS, 0x88000000ull + i);
+    }
+}
+
+
+// What the engines read in one tick: the clock counters, then the thermal status, of every processor
+static bool Tick(BatchedMsrReader* batch, uint64_t clocks[][3], uint64_t* therm) {
+    batch->BeginPass();
+    bool ok = true;
+    for (int i = 0; i < batch->ProcessorCount(); i++) ok = batch->Read(i, CLOCK_REGISTERS, 3, clocks[i]) && ok;
+    for (int i = 0; i < batch->ProcessorCount(); i++) ok = batch->Read(i, &THERM_STATUS, 1, &therm[i]) && ok;
+    batch->EndPass();
+    return ok;
+}
+
+
+TEST(MsrBatch, OneReadPerProcessorOnceLearned) {
+    FakeMsrReader msr(4);
+    Fill(&msr);
+    BatchedMsrReader batch(&msr);
+    uint64_t clocks[4][3], therm[4];
+
+    CHECK(Tick(&batch, clocks, therm));
+    CHECK(msr.readCalls == 8);     // First pass: every engine read goes through
+
+    for (int tick = 0; tick < 3; tick++) {
+        for (int i = 0; i < 4; i++) msr.Add(i, MSR_APERF, 1000);
+        msr.readCalls = 0;
+        CHECK(Tick(&batch, clocks, therm));
+        CHECK(msr.readCalls == 4);
+        for (int i = 0; i < 4; i++) {
+            CHECK(clocks[i][0] == msr.Get(i, MSR_TIME_STAMP_COUNTER));
+            CHECK(clocks[i][2] == msr.Get(i, MSR_APERF));
+            CHECK(therm[i] == msr.Get(i, THERM_STATUS));
+        }
+    }
+}
+
+
+TEST(MsrBatch, NewRegisterIsReadThroughAndLearned) {
+    FakeMsrReader msr(1);
+    Fill(&msr);
+    BatchedMsrReader batch(&msr);
+    uint64_t clocks[1][3], therm[1];
+    Tick(&batch, clocks, therm);
+    Tick(&batch, clocks, therm);
+
+    // An engine starts reading another register
+    static const uint32_t PACKAGE_STATUS = 0x1B1;
+    msr.Set(0, PACKAGE_STATUS, 42);
+    batch.BeginPass();
+    msr.readCalls = 0;
+    uint64_t value = 0;
+    CHECK(batch.Read(0, &PACKAGE_STATUS, 1, &value) && value == 42);
+    CHECK(msr.readCalls == 1);
+    batch.EndPass();
+
+    // Next pass it comes with the batch, and the registers nobody read last pass are dropped
+    msr.readCalls = 0;
+    batch.BeginPass();
+    CHECK(msr.readCalls == 1);
+    CHECK(batch.Read(0, &PACKAGE_STATUS, 1, &value) && value == 42);
+    CHECK(msr.readCalls == 1);
+    CHECK(batch.Read(0, CLOCK_REGISTERS, 3, clocks[0]));
+    CHECK(msr.readCalls == 2);
+    batch.EndPass();
+}
+
+
+TEST(MsrBatch, WriteDropsFetchedValues) {
+    FakeMsrReader msr(2);
+    Fill(&msr);
+    BatchedMsrReader batch(&msr);
+    uint64_t clocks[2][3], therm[2];
+    Tick(&batch, clocks, therm);
+
+    batch.BeginPass();
+    CHECK(batch.Write(1, THERM_STATUS, 7));
+    msr.readCalls = 0;
+    uint64_t value = 0;
+    CHECK(batch.Read(1, &THERM_STATUS, 1, &value) && value == 7);
+    CHECK(msr.readCalls == 1);
+    CHECK(batch.Read(0, &THERM_STATUS, 1, &value) && value == 0x88000000ull);
+    CHECK(msr.readCalls == 1);
+    batch.EndPass();
+}
+
+
+TEST(MsrBatch, FailedFetchFallsBackToSingleReads) {
+    FakeMsrReader msr(1);
+    Fill(&msr);
+    BatchedMsrReader batch(&msr);
+    uint64_t clocks[1][3], therm[1];
+    Tick(&batch, clocks, therm);
+
+    msr.failReads = true;
+    CHECK(!Tick(&batch, clocks, therm));
+    msr.failReads = false;
+
+    // Nothing was read successfully, so the next pass fetches nothing and relearns
+    msr.readCalls = 0;
+    CHECK(Tick(&batch, clocks, therm));
+    CHECK(msr.readCalls == 2);
+    msr.readCalls = 0;
+    CHECK(Tick(&batch, clocks, therm));
+    CHECK(msr.readCalls == 1);
+}
+
+
+TEST(MsrBatch, ReadsOutsideAPassGoThrough) {
+    FakeMsrReader msr(1);
+    Fill(&msr);
+    BatchedMsrReader batch(&msr);
+    uint64_t clocks[1][3], therm[1];
+    Tick(&batch, clocks, therm);
+    Tick(&batch, clocks, therm);
+
+    msr.Add(0, MSR_APERF, 5);
+    msr.readCalls = 0;
+    uint64_t values[3];
+    CHECK(batch.Read(0, CLOCK_REGISTERS, 3, values));
+    CHECK(msr.readCalls == 1 && values[2] == msr.Get(0, MSR_APERF));
+}
@@ -0,0 +1,152 @@
+// Tests of the PMU counters on a fake MSR reader, see PerfCounters.h
+
+#include "Test.h"
+
+#include "FakeMsr.h"
+#include "PerfCounters.h"
+
+
+static const uint32_t PMC0 = 0xC1;
+static const uint32_t PMC1 = 0xC2;
+static const uint32_t PERFEVTSEL0 = 0x186;
+static const uint32_t PERFEVTSEL1 = 0x187;
+static const uint32_t FIXED_CTR0 = 0x309;
+static const uint32_t FIXED_CTR1 = 0x30A;
+static const uint32_t FIXED_CTR_CTRL = 0x38D;
+static const uint32_t PERF_GLOBAL_CTRL = 0x38F;
+
+// The selection PerfCounters programs: LLC references and misses, fixed counters 0 and 1
+static const uint64_t OWN_LLC_REFERENCES = 0x2E | (0x4F << 8) | (1 << 16) | (1 << 17) | (1 << 22);
+static const uint64_t OWN_LLC_MISSES = 0x2E | (0x41 << 8) | (1 << 16) | (1 << 17) | (1 << 22);
+static const uint64_t OWN_FIXED = 0x33;
+static const uint64_t OWN_GLOBAL = 0x3 | (0x3ull << 32);
+static const uint64_t OTHER_GLOBAL = 0x4 | (0x4ull << 32);     // PMC2 and fixed counter 2 of another tool
+
+
+// Processors with idle counters and 'global' in IA32_PERF_GLOBAL_CTRL
+static void Reset(FakeMsrReader* msr, uint64_t global) {
+    for (int i = 0; i < msr->ProcessorCount(); i++) {
+        msr->Set(i, PERFEVTSEL0, 0);
+        msr->Set(i, PERFEVTSEL1, 0);
+        msr->Set(i, FIXED_CTR_CTRL, 0);
+        msr->Set(i, PERF_GLOBAL_CTRL, global);
+        for (uint32_t counter : { PMC0, PMC1, FIXED_CTR0, FIXED_CTR1 }) msr->Set(i, counter, 1000);
+    }
+}
+
+
+TEST(PerfCounters, ProgramsAndRestores) {
+    FakeMsrReader msr(2);
+    Reset(&msr, OTHER_GLOBAL);
+    PerfCounters counters(&msr);
+    CHECK(counters.Start());
+    for (int i = 0; i < 2; i++) {
+        CHECK(msr.Get(i, PERFEVTSEL0) == OWN_LLC_REFERENCES);
+        CHECK(msr.Get(i, PERFEVTSEL1) == OWN_LLC_MISSES);
+        CHECK(msr.Get(i, FIXED_CTR_CTRL) == OWN_FIXED);
+        CHECK(msr.Get(i, PERF_GLOBAL_CTRL) == (OTHER_GLOBAL | OWN_GLOBAL));
+    }
+
+    counters.Stop();
+    for (int i = 0; i < 2; i++) {
+        CHECK(msr.Get(i, PERFEVTSEL0) == 0 && msr.Get(i, FIXED_CTR_CTRL) == 0);
+        CHECK(msr.Get(i, PERF_GLOBAL_CTRL) == OTHER_GLOBAL);
+    }
+}
+
+
+TEST(PerfCounters, TakesOverOwnSelection) {
+    // A killed instance left the counters programmed and globally enabled
+    FakeMsrReader msr(2);
+    Reset(&msr, OTHER_GLOBAL | OWN_GLOBAL);
+    for (int i = 0; i < 2; i++) {
+        msr.Set(i, PERFEVTSEL0, OWN_LLC_REFERENCES);
+        msr.Set(i, PERFEVTSEL1, OWN_LLC_MISSES);
+        msr.Set(i, FIXED_CTR_CTRL, OWN_FIXED);
+    }
+    PerfCounters counters(&msr);
+    CHECK(counters.Start());
+    CHECK(msr.Get(0, PERF_GLOBAL_CTRL) == (OTHER_GLOBAL | OWN_GLOBAL));
+
+    // Stop disables them rather than restoring the enable bits the killed instance set
+    counters.Stop();
+    for (int i = 0; i < 2; i++) {
+        CHECK(msr.Get(i, PERF_GLOBAL_CTRL) == OTHER_GLOBAL);
+        CHECK(msr.Get(i, PERFEVTSEL0) == 0 && msr.Get(i, PERFEVTSEL1) == 0);
+    }
+}
+
+
+TEST(PerfCounters, LeavesOtherToolAlone) {
+    // A profiler uses PMC0 for another event: nothing is written, now or on later updates
+    FakeMsrReader msr(2);
+    Reset(&msr, OWN_GLOBAL);
+    msr.Set(1, PERFEVTSEL0, 0x3C | (1 << 16) | (1 << 22));
+    PerfCounters counters(&msr);
+    CHECK(!counters.Start());
+    CHECK(!counters.Update(1.0));
+    CHECK(!counters.Valid());
+    counters.Stop();
+    CHECK(msr.writeCalls == 0);
+    CHECK(msr.Get(1, PERFEVTSEL0) == (0x3C | (1 << 16) | (1 << 22)));
+    CHECK(msr.Get(0, PERF_GLOBAL_CTRL) == OWN_GLOBAL);
+
+    // Only fixed counters in use also count as taken
+    FakeMsrReader fixed(1);
+    Reset(&fixed, 0);
+    fixed.Set(0, FIXED_CTR_CTRL, 0x3);
+    PerfCounters other(&fixed);
+    CHECK(!other.Start());
+    CHECK(fixed.writeCalls == 0);
+}
+
+
+TEST(PerfCounters, MetricsFromDeltas) {
+    FakeMsrReader msr(2);
+    Reset(&msr, 0);
+    PerfCounters counters(&msr);
+    CHECK(counters.Update(0.0));
+    CHECK(!counters.Valid());
+
+    // Over two seconds: 6e9 instructions in 4e9 cycles, 1e6 of 4e6 LLC references missed
+    for (int i = 0; i < 2; i++) {
+        msr.Add(i, FIXED_CTR0, 3000000000ull);
+        msr.Add(i, FIXED_CTR1, 2000000000ull);
+        msr.Add(i, PMC0, 2000000);
+        msr.Add(i, PMC1, 500000);
+    }
+    CHECK(counters.Update(2.0));
+    CHECK(counters.Valid());
+    CHECK_NEAR(counters.Ipc(), 1.5, 1e-12);
+    CHECK_NEAR(counters.LlcMissRate(), 25.0, 1e-12);
+    CHECK_NEAR(counters.InstructionsPerSecond(), 3e9, 1e-3);
+
+    // A failed read invalidates the metrics until two readings span an interval again
+    msr.failReads = true;
+    CHECK(!counters.Update(1.0));
+    CHECK(!counters.Valid());
+    msr.failReads = false;
+    CHECK(counters.Update(1.0));
+    CHECK(!counters.Valid());
+}
+
+
+TEST(PerfCounters, TickCost) {
+    // One batched read of the four counters per processor and tick; the driver round trips dominate on
+    // real hardware, so the figure here is the bookkeeping around them
+    const int processors = 32;
+    FakeMsrReader msr(processors);
+    Reset(&msr, 0);
+    PerfCounters counters(&msr);
+    CHECK(counters.Start());
+
+    int reads = msr.readCalls;
+    counters.Update(1.0);
+    CHECK(msr.readCalls - reads == processors);
+
+    Benchmark("PerfCounters::Update, 32 processors", 10000, [&](int) {
+        for (int i = 0; i < processors; i++) msr.Add(i, FIXED_CTR0, 1000);
+        counters.Update(1.0);
+    });
+    CHECK(counters.Valid());
+}
@@ -0,0 +1,105 @@
+// Tests of the time-to-throttle prediction, see Predict.h
+
+#include "Test.h"
+
+#include "Predict.h"
+
+
+// First-order device: dT/dt = (AMBIENT - T) / TIME_CONSTANT + HEATING * P, sampled exactly every second
+static const double AMBIENT = 30.0;
+static const double TIME_CONSTANT = 100.0;
+static const double HEATING = 0.005;            // K/s per W
+
+static double Steady(double power) {
+    return AMBIENT + HEATING * TIME_CONSTANT * power;
+}
+
+static double Step(double temperature, double power) {
+    return Steady(power) + (temperature - Steady(power)) * exp(-1.0 / TIME_CONSTANT);
+}
+
+// Seconds the device takes from 'temperature' to 'limit' at constant 'power'
+static double TimeTo(double limit, double temperature, double power) {
+    return TIME_CONSTANT * log((Steady(power) - temperature) / (Steady(power) - limit));
+}
+
+
+// Feed a workload alternating between power levels so heating and cooling can be told apart
+static double Warmup(ThermalPredictor* predictor, int64_t* timestamp) {
+    static const double POWERS[] = { 50.0, 150.0, 100.0, 20.0, 150.0, 80.0 };
+    double temperature = AMBIENT;
+    for (int i = 0; i < 1800; i++) {
+        double power = POWERS[(i / 150) % 6];
+        predictor->Update(++*timestamp, temperature, power);
+        temperature = Step(temperature, power);
+    }
+    return temperature;
+}
+
+
+TEST(Predict, UnknownWhileLearning) {
+    ThermalPredictor predictor;
+    double temperature = 40.0;
+    for (int i = 0; i < 30; i++) {
+        predictor.Update(1000 + i, temperature, 150.0);
+        temperature = Step(temperature, 150.0);
+    }
+    CHECK(predictor.SecondsToLimit(90.0) == ThermalPredictor::UNKNOWN);
+}
+
+
+TEST(Predict, ConvergesOnExponentialHeating) {
+    ThermalPredictor predictor;
+    int64_t timestamp = 1000;
+    double temperature = Warmup(&predictor, &timestamp);
+
+    // From a cool state at 150 W the device heads for 105 degrees and crosses 90 on the way
+    for (int i = 0; i < 300; i++) {
+        predictor.Update(++timestamp, temperature, 20.0);
+        temperature = Step(temperature, 20.0);
+    }
+    for (int i = 0; i < 5; i++) {
+        predictor.Update(++timestamp, temperature, 150.0);
+        temperature = Step(temperature, 150.0);
+    }
+    double last = temperature;
+    predictor.Update(++timestamp, last, 150.0);
+
+    double expected = TimeTo(90.0, last, 150.0);
+    int predicted = predictor.SecondsToLimit(90.0);
+    CHECK(predicted != ThermalPredictor::UNKNOWN);
+    CHECK_NEAR(predicted, expected, 0.05 * expected + 1.0);
+}
+
+
+TEST(Predict, UnknownBelowSteadyState) {
+    ThermalPredictor predictor;
+    int64_t timestamp = 1000;
+    double temperature = Warmup(&predictor, &timestamp);
+    for (int i = 0; i < 10; i++) {
+        predictor.Update(++timestamp, temperature, 100.0);
+        temperature = Step(temperature, 100.0);
+    }
+
+    // 100 W settles at 80 degrees, so 90 is never reached, and a limit below the temperature is reached already
+    CHECK(predictor.SecondsToLimit(90.0) == ThermalPredictor::UNKNOWN);
+    CHECK(predictor.SecondsToLimit(20.0) == 0);
+}
+
+
+TEST(Predict, RestartsAfterGap) {
+    ThermalPredictor predictor;
+    int64_t timestamp = 1000;
+    double temperature = Warmup(&predictor, &timestamp);
+
+    // An hour without samples and a device that cooled down meanwhile must not read as a steep slope
+    timestamp += 3600;
+    temperature = AMBIENT;
+    for (int i = 0; i < 5; i++) {
+        predictor.Update(++timestamp, temperature, 150.0);
+        temperature = Step(temperature, 150.0);
+    }
+    double expected = TimeTo(90.0, temperature, 150.0);
+    predictor.Update(++timestamp, temperature, 150.0);
+    CHECK_NEAR(predictor.SecondsToLimit(90.0), expected, 0.05 * expected + 1.0);
+}
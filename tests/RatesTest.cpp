@@ -0,0 +1,68 @@
+// Tests of the counter rates, see Rates.h
+
+#include "Test.h"
+
+#include "Rates.h"
+
+
+TEST(Rates, RateOverExactInterval) {
+    RateTracker tracker;
+    CHECK(!tracker.Update(1000, 10.0));
+    CHECK(!tracker.Valid());
+    CHECK(tracker.Update(6000, 12.5));
+    CHECK(tracker.Valid());
+    CHECK_NEAR(tracker.Rate(), 2000.0, 1e-9);
+}
+
+
+TEST(Rates, NarrowCounterWrapsAround) {
+    // A 32-bit byte counter passing 2^32 between two readings
+    RateTracker tracker(32);
+    tracker.Update(0xFFFFF000ull, 1.0);
+    CHECK(tracker.Update(0x00001000ull, 2.0));
+    CHECK_NEAR(tracker.Rate(), 0x2000, 1e-9);
+
+    // Bits above the width, as in a sign-extended reading, are ignored
+    CHECK(tracker.Update(0xFFFFFFFF00003000ull, 3.0));
+    CHECK_NEAR(tracker.Rate(), 0x2000, 1e-9);
+}
+
+
+TEST(Rates, WideCounterResetSkipsInterval) {
+    RateTracker tracker;
+    tracker.Update(1000000, 1.0);
+    tracker.Update(2000000, 2.0);
+    CHECK_NEAR(tracker.Rate(), 1000000.0, 1e-9);
+
+    // The device was re-enumerated and counts from zero again
+    CHECK(!tracker.Update(500, 3.0));
+    CHECK(!tracker.Valid());
+    CHECK(tracker.Update(1500, 4.0));
+    CHECK_NEAR(tracker.Rate(), 1000.0, 1e-9);
+}
+
+
+TEST(Rates, SameOrOlderTimeIsIgnored) {
+    RateTracker tracker;
+    tracker.Update(100, 5.0);
+    tracker.Update(300, 6.0);
+    CHECK(!tracker.Update(900, 6.0));
+    CHECK(!tracker.Update(900, 5.5));
+    CHECK_NEAR(tracker.Rate(), 200.0, 1e-9);
+
+    // The interval runs from the last accepted reading
+    CHECK(tracker.Update(700, 8.0));
+    CHECK_NEAR(tracker.Rate(), 200.0, 1e-9);
+}
+
+
+TEST(Rates, ResetForgetsReading) {
+    RateTracker tracker;
+    tracker.Update(100, 1.0);
+    tracker.Update(200, 2.0);
+    tracker.Reset();
+    CHECK(!tracker.Valid());
+    CHECK(!tracker.Update(5000, 3.0));
+    CHECK(tracker.Update(5100, 4.0));
+    CHECK_NEAR(tracker.Rate(), 100.0, 1e-9);
+}
@@ -0,0 +1,235 @@
+// Tests of the round-robin database, see Rrd.h
+
+#include "Test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <string>
+
+#include "Rrd.h"
+
+
+static std::string TempPath(const char* name) {
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    remove(path.c_str());
+    return path;
+}
+
+
+// Average of a metric over [from, to], NAN if it has no samples there
+static double Average(const RrdFile& file, int metric, int64_t from, int64_t to) {
+    HistoryAggregate aggregate;
+    if (!file.Aggregate(metric, from, to, &aggregate)) return NAN;
+    return aggregate.sum / aggregate.count;
+}
+
+
+static const int64_t START = 1700000000;
+
+
+TEST(Rrd, KeepsSamplesAcrossReopen) {
+    std::string path = TempPath("cpugpu_test_reopen.rrd");
+    const char* names[] = { "cpu.load", "cpu.temp" };
+    {
+        RrdFile file;
+        CHECK(file.Open(path.c_str(), names, 2));
+        for (int i = 0; i < 60; i++) {
+            double values[] = { static_cast<double>(i), (i % 2) ? NAN : 50.0 };
+            file.Update(START + i, values);
+        }
+        HistoryAggregate aggregate;
+        CHECK(file.Aggregate(0, START, START + 59, &aggregate));
+        CHECK(aggregate.count == 60 && aggregate.min == 0.0 && aggregate.max == 59.0);
+    }
+
+    RrdFile file;
+    CHECK(file.Open(path.c_str(), names, 2));
+    CHECK_NEAR(Average(file, 0, START, START + 59), 29.5, 1e-4);
+    HistoryAggregate aggregate;
+    CHECK(file.Aggregate(1, START, START + 59, &aggregate));
+    CHECK(aggregate.count == 30);       // NaN samples are skipped
+    file.Close();
+    remove(path.c_str());
+}
+
+
+TEST(Rrd, MapsColumnsByName) {
+    std::string path = TempPath("cpugpu_test_remap.rrd");
+    {
+        const char* names[] = { "cpu.load", "gpu.temp", "mem.used" };
+        RrdFile file;
+        CHECK(file.Open(path.c_str(), names, 3));
+        for (int i = 0; i < 30; i++) {
+            double values[] = { 10.0, 60.0, 8.0 };
+            file.Update(START + i, values);
+        }
+    }
+
+    // A later version added a metric, dropped one and ordered the columns differently
+    const char* names[] = { "gpu.temp", "net.rx", "cpu.load" };
+    RrdFile file;
+    CHECK(file.Open(path.c_str(), names, 3));
+    CHECK_NEAR(Average(file, 0, START, START + 29), 60.0, 1e-4);
+    CHECK(isnan(Average(file, 1, START, START + 29)));
+    CHECK_NEAR(Average(file, 2, START, START + 29), 10.0, 1e-4);
+
+    double values[] = { 70.0, 5.0, 20.0 };
+    file.Update(START + 30, values);
+    CHECK_NEAR(Average(file, 1, START, START + 30), 5.0, 1e-4);
+    file.Close();
+    remove(path.c_str());
+}
+
+
+TEST(Rrd, ResumesBucketAfterReopen) {
+    // A 10-second bucket half written before a restart is completed, not overwritten
+    std::string path = TempPath("cpugpu_test_resume.rrd");
+    const char* names[] = { "cpu.temp" };
+    int64_t bucket = START / 10 * 10;
+    {
+        RrdFile file;
+        CHECK(file.Open(path.c_str(), names, 1));
+        for (int i = 0; i < 5; i++) {
+            double value = 40.0;
+            file.Update(bucket + i, &value);
+        }
+    }
+
+    RrdFile file;
+    CHECK(file.Open(path.c_str(), names, 1));
+    for (int i = 5; i < 10; i++) {
+        double value = 60.0;
+        file.Update(bucket + i, &value);
+    }
+
+    // A range longer than the 1-second tier is answered from the 10-second tier
+    HistoryAggregate aggregate;
+    CHECK(file.Aggregate(0, bucket - 2 * 3600, bucket + 9, &aggregate));
+    CHECK(aggregate.count == 10);
+    CHECK_NEAR(aggregate.sum / aggregate.count, 50.0, 1e-4);
+    CHECK(aggregate.min == 40.0f && aggregate.max == 60.0f);
+    file.Close();
+    remove(path.c_str());
+}
+
+
+TEST(Rrd, CoarseTiersOutliveFineOnes) {
+    std::string path = TempPath("cpugpu_test_tiers.rrd");
+    const char* names[] = { "cpu.load" };
+    RrdFile file;
+    CHECK(file.Open(path.c_str(), names, 1));
+    for (int64_t t = 0; t < 3 * 3600; t++) {
+        double value = (t < 3600) ? 80.0 : 20.0;
+        file.Update(START + t, &value);
+    }
+
+    // The hot first hour is gone from the 1-second ring but kept by the 10-second tier
+    int64_t now = START + 3 * 3600 - 1;
+    CHECK_NEAR(Average(file, 0, now - 3599, now), 20.0, 1e-4);
+    HistoryAggregate aggregate;
+    CHECK(file.Aggregate(0, START, now, &aggregate));
+    CHECK(aggregate.max == 80.0f);
+    CHECK_NEAR(aggregate.sum / aggregate.count, 40.0, 0.1);
+    file.Close();
+    remove(path.c_str());
+}
+
+
+// Layout of the file as Rrd.cpp writes it, to damage it the way a crash would
+static const long HEADER_SIZE = 4096;
+static const long SLOT_SIZE_ONE_METRIC = 8 + 16;    // Sequence number and one avg/min/max/count record
+
+static void Patch(const std::string& path, long offset, const void* data, size_t length) {
+    FILE* file = fopen(path.c_str(), "r+b");
+    CHECK(file != NULL);
+    if (file == NULL) return;
+    fseek(file, offset, SEEK_SET);
+    fwrite(data, 1, length, file);
+    fclose(file);
+}
+
+
+TEST(Rrd, TornSlotsAreDiscarded) {
+    std::string path = TempPath("cpugpu_test_torn.rrd");
+    const char* names[] = { "cpu.temp" };
+    {
+        RrdFile file;
+        CHECK(file.Open(path.c_str(), names, 1));
+        for (int i = 0; i < 10; i++) {
+            double value = 50.0;
+            file.Update(START + i, &value);
+        }
+    }
+
+    // The process died while rewriting two 1-second slots: the sequence number is odd and the record
+    // half updated. One is an older bucket, the other the bucket being consolidated
+    const int torn[] = { 5, 9 };
+    for (int i : torn) {
+        int64_t bucket = START + i;
+        uint64_t sequence = static_cast<uint64_t>(bucket) * 2 + 1;
+        float garbage[4] = { 1e30f, -1e30f, 1e30f, 0.0f };
+        uint32_t count = 1000;
+        memcpy(&garbage[3], &count, sizeof(count));
+        long offset = HEADER_SIZE + static_cast<long>(bucket % RrdFile::TIERS[0].slots) * SLOT_SIZE_ONE_METRIC;
+        Patch(path, offset, &sequence, sizeof(sequence));
+        Patch(path, offset + 8, garbage, sizeof(garbage));
+    }
+
+    RrdFile file;
+    CHECK(file.Open(path.c_str(), names, 1));
+    HistoryAggregate aggregate;
+    CHECK(file.Aggregate(0, START, START + 9, &aggregate));
+    CHECK(aggregate.count == 8);
+    CHECK(aggregate.min == 50.0f && aggregate.max == 50.0f);
+
+    // The torn current bucket starts over instead of resuming from the garbage
+    double value = 70.0;
+    file.Update(START + 9, &value);
+    CHECK(file.Aggregate(0, START + 9, START + 9, &aggregate));
+    CHECK(aggregate.count == 1 && aggregate.max == 70.0f);
+    file.Close();
+    remove(path.c_str());
+}
+
+
+TEST(Rrd, DamagedHeaderReinitializes) {
+    const char* names[] = { "cpu.temp" };
+    std::string path = TempPath("cpugpu_test_header.rrd");
+
+    // A header cut short while being written, a garbled metric count and a file truncated by a crash
+    // before its first page was complete are all started over
+    for (int damage = 0; damage < 3; damage++) {
+        {
+            RrdFile file;
+            CHECK(file.Open(path.c_str(), names, 1));
+            double value = 50.0;
+            file.Update(START, &value);
+        }
+        if (damage == 0) {
+            char zeros[64] = {};
+            Patch(path, 16, zeros, sizeof(zeros));      // Tiers and names after the counts
+        }
+        else if (damage == 1) {
+            uint32_t metricCount = 0x7FFFFFFF;
+            Patch(path, 12, &metricCount, sizeof(metricCount));
+        }
+        else {
+            std::filesystem::resize_file(path, 2000);
+        }
+
+        RrdFile file;
+        CHECK(file.Open(path.c_str(), names, 1));
+        HistoryAggregate aggregate;
+        CHECK(!file.Aggregate(0, START, START, &aggregate));
+
+        // The reinitialized file works and keeps what is written from now on
+        double value = 60.0;
+        file.Update(START + 1, &value);
+        file.Close();
+        CHECK(file.Open(path.c_str(), names, 1));
+        CHECK_NEAR(Average(file, 0, START + 1, START + 1), 60.0, 1e-4);
+        file.Close();
+        remove(path.c_str());
+    }
+}
@@ -0,0 +1,123 @@
+// Tests of the sensor label rules on the labels of several chips, see SensorLabels.h
+
+#include "Test.h"
+
+#include <string.h>
+#include <vector>
+
+#include "SensorLabels.h"
+
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+
+// Voltage labels as LibreHardwareMonitor lists them, in sensor order
+static const char* const NUVOTON_NCT6798D[] = {
+    "Vcore", "Voltage #2", "AVCC", "+3.3V", "Voltage #5", "Voltage #6", "Voltage #7", "3VSB", "VBat", "VTT",
+    "Voltage #11", "Voltage #12", "Voltage #13", "Voltage #14", "Voltage #15"
+};
+static const char* const ITE_IT8688E[] = {
+    "Vcore", "+3.3V", "+12V", "+5V", "VSOC", "VDDP", "DRAM", "3VSB", "VBat"
+};
+static const char* const AMD_RYZEN[] = { "Core (SVI2 TFN)", "SoC (SVI2 TFN)", "Core #1 VID", "Core #2 VID" };
+static const char* const INTEL_CORE[] = { "CPU Core", "CPU Core #1", "CPU Core #2", "CPU Memory" };
+
+
+static bool IsCanonical(SensorKind kind, const char* label, const char* expected) {
+    const char* canonical = CanonicalSensorName(kind, label);
+    if (expected == nullptr) return canonical == nullptr;
+    return canonical != nullptr && strcmp(canonical, expected) == 0;
+}
+
+
+// Labels of the motherboard chip followed by those of the CPU, as VoltageSensors lists them
+static std::vector<const char*> Board(const char* const* chip, size_t chipCount, const char* const* cpu, size_t cpuCount) {
+    std::vector<const char*> labels(chip, chip + chipCount);
+    labels.insert(labels.end(), cpu, cpu + cpuCount);
+    return labels;
+}
+
+
+TEST(SensorLabels, SuperIoRails) {
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "Vcore", "VCore"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "+3.3V", "3.3V"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "+12V", "12V"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "3VSB", "3VSB"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "VBat", "VBat"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "AVCC", "AVCC"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "VSOC", "VSoC"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "DRAM", "DRAM"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "VDIMM", "DRAM"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "3.3V Standby", "3VSB"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "CMOS Battery", "VBat"));
+
+    // Unnamed inputs and rails without a rule keep only their own label
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "Voltage #5", nullptr));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "VDDP", nullptr));
+}
+
+
+TEST(SensorLabels, CpuSensors) {
+    // AMD reports the SVI2 telemetry, Intel the requested core voltage
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "Core (SVI2 TFN)", "VCore"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "SoC (SVI2 TFN)", "VSoC"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "Core #1 VID", nullptr));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "CPU Core", "VCore"));
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "CPU Core #1", nullptr));
+
+    // Package temperatures of both vendors; the per-die and per-core probes are not the package
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "CPU Package", "Package"));
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "Core (Tctl/Tdie)", "Package"));
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "Core (Tctl)", "Package"));
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "CCD1 (Tdie)", nullptr));
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "CPU Core #1", nullptr));
+
+    // Rules apply to their sensor kind only
+    CHECK(IsCanonical(SENSOR_VOLTAGE, "CPU Package", nullptr));
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "Vcore", nullptr));
+}
+
+
+TEST(SensorLabels, ComparisonIgnoresCaseSpacesAndUnderscores) {
+    CHECK(SameSensorLabel("+12V", "12v"));
+    CHECK(SameSensorLabel("CPU_Core", "cpu core"));
+    CHECK(SameSensorLabel("3.3 V", "+3.3V"));
+    CHECK(SameSensorLabel("Voltage #5", "voltage#5"));
+    CHECK(SameSensorLabel("", "  _ "));
+    CHECK(!SameSensorLabel("12V", "5V"));
+    CHECK(!SameSensorLabel("VCore", "VCore2"));
+    CHECK(!SameSensorLabel("3.3V", "33V"));
+    CHECK(IsCanonical(SENSOR_TEMPERATURE, "cpu_package", "Package"));
+}
+
+
+TEST(SensorLabels, VoltParamResolution) {
+    // Volt@VCore takes the rail the board chip measures, listed before the CPU's own report
+    std::vector<const char*> nuvotonIntel = Board(NUVOTON_NCT6798D, COUNT(NUVOTON_NCT6798D), INTEL_CORE, COUNT(INTEL_CORE));
+    int count = static_cast<int>(nuvotonIntel.size());
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VCore", nuvotonIntel.data(), count) == 0);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "vcore", nuvotonIntel.data(), count) == 0);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "3.3V", nuvotonIntel.data(), count) == 3);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VTT", nuvotonIntel.data(), count) == 9);
+
+    // Inputs without a canonical name are found by the label the chip gives them
+    CHECK(FindSensor(SENSOR_VOLTAGE, "Voltage #5", nuvotonIntel.data(), count) == 4);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "Voltage_5", nuvotonIntel.data(), count) == -1);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "voltage#5", nuvotonIntel.data(), count) == 4);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "CPU Core #2", nuvotonIntel.data(), count) == 17);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "12V", nuvotonIntel.data(), count) == -1);
+
+    // On a board whose chip has no core rail, the CPU's telemetry answers
+    std::vector<const char*> iteAmd = Board(ITE_IT8688E + 1, COUNT(ITE_IT8688E) - 1, AMD_RYZEN, COUNT(AMD_RYZEN));
+    count = static_cast<int>(iteAmd.size());
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VCore", iteAmd.data(), count) == 8);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VSoC", iteAmd.data(), count) == 3);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "12V", iteAmd.data(), count) == 1);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "DRAM", iteAmd.data(), count) == 5);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VDDP", iteAmd.data(), count) == 4);
+
+    // A canonical name wins over a later sensor that is labelled with it literally
+    const char* shadowed[] = { "Voltage #1", "CPU VCore", "VCore" };
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VCore", shadowed, 3) == 1);
+    CHECK(FindSensor(SENSOR_VOLTAGE, "VCore", nullptr, 0) == -1);
+}
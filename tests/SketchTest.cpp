@@ -0,0 +1,159 @@
+// Tests of the DDSketch quantile sketches, see Sketch.h
+
+#include "Test.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "Sketch.h"
+
+
+// Deterministic values spread log-uniformly over [low, high]
+static std::vector<double> LogUniform(int count, double low, double high, uint32_t seed) {
+    std::vector<double> values;
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        double u = (seed >> 8) / 16777216.0;
+        values.push_back(low * pow(high / low, u));
+    }
+    return values;
+}
+
+
+// Value at the lower rank floor(q * (count - 1)), the definition QuantileSketch::Quantile follows
+static double ExactQuantile(std::vector<double> values, double q) {
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(q * (values.size() - 1))];
+}
+
+
+static const double QUANTILES[] = { 0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0 };
+
+
+TEST(Sketch, RelativeErrorIsBounded) {
+    std::vector<double> values = LogUniform(100000, 0.01, 1e6, 12345);
+    QuantileSketch sketch;
+    for (double value : values) sketch.Add(value);
+    CHECK(sketch.Count() == values.size());
+
+    for (double q : QUANTILES) {
+        double exact = ExactQuantile(values, q);
+        double estimate = 0.0;
+        CHECK(sketch.Quantile(q, &estimate));
+        CHECK_NEAR(estimate, exact, QuantileSketch::RELATIVE_ACCURACY * exact * (1.0 + 1e-9));
+    }
+}
+
+
+TEST(Sketch, IntegerReadingsRoundExact) {
+    QuantileSketch sketch;
+    for (int value = 1; value < 100; value++) sketch.Add(value);
+    for (int value = 1; value < 100; value++) {
+        double estimate = 0.0;
+        CHECK(sketch.Quantile((value - 0.5) / 98.0, &estimate));     // Mid-rank, clear of rounding the rank down
+        CHECK(static_cast<int>(floor(estimate + 0.5)) == value);
+    }
+}
+
+
+TEST(Sketch, CountsZerosAndNegatives) {
+    QuantileSketch sketch;
+    double estimate = -1.0;
+    CHECK(!sketch.Quantile(0.5, &estimate));
+
+    for (int i = 0; i < 30; i++) sketch.Add(0.0);
+    for (int i = 0; i < 10; i++) sketch.Add(-5.0);
+    for (int i = 0; i < 60; i++) sketch.Add(50.0);
+    CHECK(sketch.Quantile(0.39, &estimate) && estimate == 0.0);
+    CHECK(sketch.Quantile(0.41, &estimate));
+    CHECK_NEAR(estimate, 50.0, 50.0 * QuantileSketch::RELATIVE_ACCURACY);
+}
+
+
+TEST(Sketch, MergeEqualsOneSketch) {
+    std::vector<double> low = LogUniform(5000, 1.0, 100.0, 1);
+    std::vector<double> high = LogUniform(5000, 50.0, 5000.0, 2);
+    QuantileSketch a, b, all;
+    for (double value : low) { a.Add(value); all.Add(value); }
+    for (double value : high) { b.Add(value); all.Add(value); }
+    a.Merge(b);
+    CHECK(a.Count() == all.Count());
+
+    for (double q : QUANTILES) {
+        double merged = 0.0, single = 0.0;
+        CHECK(a.Quantile(q, &merged) && all.Quantile(q, &single));
+        CHECK(merged == single);
+    }
+}
+
+
+TEST(Sketch, CollapseKeepsHighQuantiles) {
+    // MAX_BUCKETS buckets cover about 8.9 decades; of 24 the lowest ones collapse and the quantiles
+    // in the top 8 decades keep their accuracy
+    std::vector<double> values = LogUniform(50000, 1e-6, 1e18, 99);
+    QuantileSketch sketch;
+    for (double value : values) sketch.Add(value);
+    for (double q : { 0.7, 0.9, 0.99, 1.0 }) {
+        double exact = ExactQuantile(values, q);
+        double estimate = 0.0;
+        CHECK(sketch.Quantile(q, &estimate));
+        CHECK_NEAR(estimate, exact, QuantileSketch::RELATIVE_ACCURACY * exact * (1.0 + 1e-9));
+    }
+}
+
+
+TEST(Sketch, WindowsForgetOldHours) {
+    WindowedSketch sketch;
+    int64_t start = 1700000000 / 3600 * 3600;
+    for (int i = 0; i < 3600; i++) sketch.Add(start + i, 90.0);             // A hot hour
+    for (int i = 3600; i < 2 * 3600; i++) sketch.Add(start + i, 40.0);      // Then a cool one
+    sketch.Add(start + 2 * 3600, NAN);
+
+    double value = 0.0;
+    int64_t now = start + 2 * 3600 - 1;
+    CHECK(sketch.WindowQuantile(1.0, now, 1, &value));
+    CHECK_NEAR(value, 40.0, 40.0 * QuantileSketch::RELATIVE_ACCURACY);
+    CHECK(sketch.WindowQuantile(1.0, now, 2, &value));
+    CHECK_NEAR(value, 90.0, 90.0 * QuantileSketch::RELATIVE_ACCURACY);
+
+    // A day later the hot hour left the 24-hour window but not the lifetime sketch
+    int64_t later = start + (WindowedSketch::WINDOW_HOURS + 1) * 3600;
+    sketch.Add(later, 40.0);
+    CHECK(sketch.WindowQuantile(1.0, later, WindowedSketch::WINDOW_HOURS, &value));
+    CHECK_NEAR(value, 40.0, 40.0 * QuantileSketch::RELATIVE_ACCURACY);
+    CHECK(sketch.LifetimeQuantile(1.0, &value));
+    CHECK_NEAR(value, 90.0, 90.0 * QuantileSketch::RELATIVE_ACCURACY);
+}
+
+
+TEST(Sketch, WindowLongerThanRingIsRefused) {
+    // The ring holds WINDOW_HOURS hours, so a longer window has no answer instead of a shorter one
+    WindowedSketch sketch;
+    int64_t start = 1700000000 / 3600 * 3600;
+    for (int i = 0; i < 3600; i++) sketch.Add(start + i, 50.0);
+
+    double value = 0.0;
+    int64_t now = start + 3599;
+    CHECK(sketch.WindowQuantile(0.99, now, WindowedSketch::WINDOW_HOURS, &value));
+    CHECK(!sketch.WindowQuantile(0.99, now, WindowedSketch::WINDOW_HOURS + 1, &value));
+    CHECK(!sketch.WindowQuantile(0.99, now, 2 * WindowedSketch::WINDOW_HOURS, &value));
+    CHECK(!sketch.WindowQuantile(0.99, now, 0, &value));
+}
+
+
+TEST(Sketch, InsertCost) {
+    // A sample per metric and second goes into the lifetime and the hourly sketch, a query merges the day
+    std::vector<double> values = LogUniform(1 << 16, 20.0, 100.0, 7);
+    WindowedSketch sketch;
+    int64_t start = 1700000000;
+    const int samples = 24 * 3600;
+    Benchmark("WindowedSketch::Add", samples, [&](int i) { sketch.Add(start + i, values[i & 0xFFFF]); });
+
+    double value = 0.0;
+    bool found = true;
+    Benchmark("WindowQuantile over 24 h", 100, [&](int) {
+        found = sketch.WindowQuantile(0.99, start + samples - 1, WindowedSketch::WINDOW_HOURS, &value) && found;
+    });
+    CHECK(found);
+}
@@ -0,0 +1,13 @@
+/* Layout of the snapshot as a C compiler sees SnapshotApi.h, compared with C++ by SnapshotTest.cpp */
+
+#include <stddef.h>
+
+#include "SnapshotApi.h"
+
+
+size_t SnapshotLayoutC(size_t* timestampOffset, size_t* validOffset, size_t* valuesOffset) {
+    *timestampOffset = offsetof(cpugpu_sample, timestamp);
+    *validOffset = offsetof(cpugpu_sample, valid);
+    *valuesOffset = offsetof(cpugpu_sample, values);
+    return sizeof(cpugpu_sample);
+}
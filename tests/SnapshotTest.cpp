@@ -0,0 +1,78 @@
+// Tests of the snapshot API layout and of filling samples from fake readings, see SnapshotApi.h and Snapshot.h
+
+#include "Test.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "Snapshot.h"
+
+
+extern "C" size_t SnapshotLayoutC(size_t* timestampOffset, size_t* validOffset, size_t* valuesOffset);
+
+
+// Readings a backend could report, each value telling its metric apart
+static void FakeReadings(double* values) {
+    for (int i = 0; i < METRIC_COUNT; i++) values[i] = 1000.0 + i;
+}
+
+
+TEST(Snapshot, LayoutIsFixed) {
+    // Version 1 as shipped: callers built against it must keep finding their values at the same offsets
+    CHECK(offsetof(cpugpu_sample, size) == 0);
+    CHECK(offsetof(cpugpu_sample, version) == 4);
+    CHECK(offsetof(cpugpu_sample, timestamp) == 8);
+    CHECK(offsetof(cpugpu_sample, valid) == 16);
+    CHECK(offsetof(cpugpu_sample, values) == 24);
+    CHECK(sizeof(cpugpu_sample) == 24 + 8 * CPUGPU_MAX_VALUES);
+
+    size_t timestamp = 0, valid = 0, values = 0;
+    CHECK(SnapshotLayoutC(&timestamp, &valid, &values) == sizeof(cpugpu_sample));
+    CHECK(timestamp == 8 && valid == 16 && values == 24);
+}
+
+
+TEST(Snapshot, ValuesFollowTheEnum) {
+    // Every cpugpu_value is the metric of the same name, e.g. CPUGPU_GPU_MEM_CLOCK is gpu_mem_clock
+    static const char* const NAMES[CPUGPU_VALUE_COUNT] = {
+        "cpu_load", "cpu_power", "cpu_temp", "cpu_fan_rpm", "cpu_fan", "cpu_clock", "cpu_limit", "cpu_ipc",
+        "cpu_llc_miss", "cpu_instr",
+        "gpu_load", "gpu_power", "gpu_limit", "gpu_temp", "gpu_fan", "gpu_clock", "gpu_mem_clock", "gpu_mem_alloc",
+        "gpu_mem_usage",
+        "mem_used", "mem_available", "mem_usage", "mem_cached", "mem_swap", "mem_swap_usage", "mem_faults",
+        "disk_read", "disk_write", "disk_read_iops", "disk_write_iops", "disk_util", "disk_temp",
+        "net_rx", "net_tx",
+    };
+    for (int i = 0; i < CPUGPU_VALUE_COUNT; i++) {
+        char key[64];
+        size_t length = FormatMetricKey(SNAPSHOT_METRICS[i], '_', key);
+        key[length] = '\0';
+        if (strcmp(key, NAMES[i]) != 0) printf("  value %d is %s, expected %s\n", i, key, NAMES[i]);
+        CHECK(strcmp(key, NAMES[i]) == 0);
+    }
+}
+
+
+TEST(Snapshot, FillsFromReadings) {
+    double readings[METRIC_COUNT];
+    FakeReadings(readings);
+    readings[METRIC_GPU_TEMP] = NAN;    // No GPU sensor
+
+    cpugpu_sample sample;
+    memset(&sample, 0xAB, sizeof(sample));
+    sample.size = sizeof(sample);
+    FillSnapshot(readings, 1700000000, &sample);
+
+    CHECK(sample.size == sizeof(sample));
+    CHECK(sample.version == CPUGPU_API_VERSION);
+    CHECK(sample.timestamp == 1700000000);
+    CHECK(sample.values[CPUGPU_CPU_TEMP] == 1000.0 + METRIC_CPU_TEMP);
+    CHECK(sample.values[CPUGPU_NET_TX] == 1000.0 + METRIC_NET_TX);
+    CHECK(isnan(sample.values[CPUGPU_GPU_TEMP]));
+    CHECK(!(sample.valid & (1ull << CPUGPU_GPU_TEMP)));
+
+    // Valid are exactly the layout's values with a reading; the unused tail is NAN
+    uint64_t expected = ((1ull << CPUGPU_VALUE_COUNT) - 1) & ~(1ull << CPUGPU_GPU_TEMP);
+    CHECK(sample.valid == expected);
+    for (int i = CPUGPU_VALUE_COUNT; i < CPUGPU_MAX_VALUES; i++) CHECK(isnan(sample.values[i]));
+}
@@ -0,0 +1,320 @@
+// Tests of the subscription stream server and client, see SubscriptionServer.h.
+// The server and client threads are also run under ThreadSanitizer by configuring with -DCPUGPU_TSAN=ON.
+
+#include "Test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Snapshot.h"
+#include "SubscriptionServer.h"
+
+
+// Pipe name, or Unix socket path, private to one test
+static std::string StreamName(const char* test) {
+#ifdef _WIN32
+    return std::string("cpugpu_test_") + test;
+#else
+    return (std::filesystem::temp_directory_path() / (std::string("cpugpu_test_") + test)).string();
+#endif
+}
+
+
+// Poll 'condition' for up to 'milliseconds'; returns whether it became true
+template <typename Condition>
+static bool WaitFor(Condition condition, int milliseconds) {
+    for (int waited = 0; waited < milliseconds; waited += 10) {
+        if (condition()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+
+static void Values(double value, double* values) {
+    for (int i = 0; i < FRAME_MAX_VALUES; i++) values[i] = value + i;
+}
+
+
+// Latest timestamp a client received, 0 before the first frame
+static int64_t LatestTime(const SubscriptionClient& client) {
+    int64_t timestamp = 0;
+    double values[FRAME_MAX_VALUES];
+    return client.Latest(&timestamp, values) ? timestamp : 0;
+}
+
+
+TEST(Subscription, ClientsReceivePublishedValues) {
+    std::string name = StreamName("values");
+    SubscriptionServer server;
+    CHECK(server.Start(name.c_str()));
+    CHECK(server.Running());
+
+    SubscriptionClient all, some;
+    CHECK(all.Connect(name.c_str(), ~0ull));
+    CHECK(some.Connect(name.c_str(), 0x5));
+
+    // Clients only get ticks published after they subscribed, so keep ticking until both did
+    double values[FRAME_MAX_VALUES];
+    Values(10.0, values);
+    int64_t tick = 1000;
+    CHECK(WaitFor([&] { server.Publish(++tick, values); return LatestTime(all) > 0 && LatestTime(some) > 0; }, 3000));
+
+    Values(50.0, values);
+    int64_t last = ++tick;
+    server.Publish(last, values);
+    CHECK(WaitFor([&] { return LatestTime(all) == last && LatestTime(some) == last; }, 3000));
+
+    double received[FRAME_MAX_VALUES];
+    int64_t timestamp = 0;
+    CHECK(all.Latest(&timestamp, received));
+    CHECK(memcmp(received, values, sizeof(values)) == 0);
+    CHECK(some.Latest(&timestamp, received));
+    CHECK(received[0] == 50.0 && received[2] == 52.0);
+
+    server.Stop();
+    CHECK(!server.Running());
+    CHECK(WaitFor([&] { return !all.Connected() && !some.Connected(); }, 3000));
+}
+
+
+TEST(Subscription, UnchangedTicksAdvanceTime) {
+    // A daemon publishing the same readings still shows it is alive; one that stops publishing goes stale
+    std::string name = StreamName("heartbeat");
+    SubscriptionServer server;
+    CHECK(server.Start(name.c_str()));
+    SubscriptionClient client;
+    CHECK(client.Connect(name.c_str(), ~0ull));
+
+    double values[FRAME_MAX_VALUES];
+    Values(1.0, values);
+    int64_t tick = 2000;
+    CHECK(WaitFor([&] { server.Publish(++tick, values); return LatestTime(client) > 0; }, 3000));
+    for (int i = 0; i < 3; i++) {
+        int64_t expected = ++tick;
+        server.Publish(expected, values);
+        CHECK(WaitFor([&] { return LatestTime(client) == expected; }, 3000));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(LatestTime(client) == tick);
+    CHECK(client.Connected());
+    server.Stop();
+}
+
+
+TEST(Subscription, SecondServerIsRefused) {
+    std::string name = StreamName("owner");
+    SubscriptionServer first, second;
+    CHECK(first.Start(name.c_str()));
+    CHECK(!second.Start(name.c_str()));
+    first.Stop();
+
+    // Once the owner stopped, the name is free again
+    CHECK(second.Start(name.c_str()));
+    second.Stop();
+}
+
+
+TEST(Subscription, SilentClientsAreDropped) {
+    std::string name = StreamName("silent");
+    SubscriptionServer server;
+    CHECK(server.Start(name.c_str()));
+
+    // Connections that never send their mask hold every client slot
+    static const int SILENT = SubscriptionServer::MAX_CLIENTS;
+#ifdef _WIN32
+    std::string path = "\\\\.\\pipe\\" + name;
+    HANDLE silent[SILENT];
+    for (int i = 0; i < SILENT; i++) {
+        WaitNamedPipeA(path.c_str(), 1000);
+        silent[i] = CreateFileA(path.c_str(), GENERIC_READ | FILE_WRITE_DATA, 0, NULL, OPEN_EXISTING, 0, NULL);
+        CHECK(silent[i] != INVALID_HANDLE_VALUE);
+    }
+#else
+    int silent[SILENT];
+    for (int i = 0; i < SILENT; i++) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, name.c_str());
+        silent[i] = socket(AF_UNIX, SOCK_STREAM, 0);
+        CHECK(connect(silent[i], reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    }
+#endif
+
+    // After SUBSCRIBE_TIMEOUT the server closes them
+    std::this_thread::sleep_for(std::chrono::milliseconds(SubscriptionServer::SUBSCRIBE_TIMEOUT + 500));
+    for (int i = 0; i < SILENT; i++) {
+#ifdef _WIN32
+        DWORD available = 0;
+        CHECK(!PeekNamedPipe(silent[i], NULL, 0, NULL, &available, NULL));     // Broken pipe
+        CloseHandle(silent[i]);
+#else
+        char byte;
+        CHECK(recv(silent[i], &byte, 1, MSG_DONTWAIT) == 0);    // End of stream, not EAGAIN
+        close(silent[i]);
+#endif
+    }
+
+    // and a subscriber gets a slot again
+    SubscriptionClient client;
+    CHECK(client.Connect(name.c_str(), ~0ull));
+    double values[FRAME_MAX_VALUES];
+    Values(0.0, values);
+    int64_t tick = 3000;
+    CHECK(WaitFor([&] { server.Publish(++tick, values); return LatestTime(client) > 0; }, 3000));
+    server.Stop();
+}
+
+
+TEST(Subscription, ConcurrentClientsAndTicks) {
+    // Clients connecting and leaving while the sampler publishes; run under ThreadSanitizer to check the locking
+    std::string name = StreamName("concurrent");
+    SubscriptionServer server;
+    CHECK(server.Start(name.c_str()));
+
+    std::atomic<bool> publishing{ true };
+    std::thread sampler([&] {
+        double values[FRAME_MAX_VALUES];
+        for (int64_t tick = 1; publishing; tick++) {
+            Values(static_cast<double>(tick), values);
+            server.Publish(tick, values);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    for (int round = 0; round < 5; round++) {
+        SubscriptionClient clients[4];
+        for (SubscriptionClient& client : clients) CHECK(client.Connect(name.c_str(), ~0ull << round));
+        for (SubscriptionClient& client : clients) CHECK(WaitFor([&] { return LatestTime(client) > 0; }, 3000));
+    }
+
+    publishing = false;
+    sampler.join();
+    server.Stop();
+}
+
+
+// A daemon as CPUGPUd runs it: cpugpu_snapshot samples of fake readings, published on the stream
+static void PublishReadings(SubscriptionServer* daemon, int64_t timestamp, const double* readings) {
+    cpugpu_sample sample;
+    sample.size = sizeof(sample);
+    FillSnapshot(readings, timestamp, &sample);
+    daemon->Publish(sample.timestamp, sample.values);
+}
+
+
+TEST(Subscription, AttachedPluginGetsDaemonReadings) {
+    std::string name = StreamName("daemon");
+    SubscriptionServer daemon;
+    CHECK(daemon.Start(name.c_str()));
+    SubscriptionClient plugin;
+    CHECK(plugin.Connect(name.c_str(), ~0ull));
+
+    double readings[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) readings[i] = 100.0 + i;
+    readings[METRIC_GPU_POWER] = NAN;
+    int64_t now = time(NULL);
+    CHECK(WaitFor([&] { PublishReadings(&daemon, now, readings); return LatestTime(plugin) == now; }, 3000));
+
+    // The plugin maps the frame back to its metrics, as RecordHistory does while attached
+    int64_t timestamp = 0;
+    double frame[FRAME_MAX_VALUES];
+    CHECK(plugin.Latest(&timestamp, frame));
+    double values[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) values[i] = NAN;
+    for (int i = 0; i < CPUGPU_VALUE_COUNT; i++) values[SNAPSHOT_METRICS[i]] = frame[i];
+    CHECK(values[METRIC_CPU_TEMP] == readings[METRIC_CPU_TEMP]);
+    CHECK(values[METRIC_NET_TX] == readings[METRIC_NET_TX]);
+    CHECK(isnan(values[METRIC_GPU_POWER]));
+    daemon.Stop();
+}
+
+
+TEST(Subscription, SilentDaemonIsDetected) {
+    std::string name = StreamName("silent_daemon");
+    SubscriptionServer daemon;
+    CHECK(daemon.Start(name.c_str()));
+    int64_t now = time(NULL);
+    SubscriptionClient plugin;
+    CHECK(plugin.Connect(name.c_str(), ~0ull));
+
+    // Before the first frame the silence counts from Connect
+    CHECK(plugin.SilentFor(now + 5) >= 4 && plugin.SilentFor(now + 5) <= 5);
+
+    // Every tick sends a frame, changed or not, so an attached plugin sees the daemon alive
+    double readings[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) readings[i] = 1.0;
+    CHECK(WaitFor([&] { PublishReadings(&daemon, now, readings); return LatestTime(plugin) == now; }, 3000));
+    for (int64_t tick = now + 1; tick <= now + 3; tick++) {
+        PublishReadings(&daemon, tick, readings);
+        CHECK(WaitFor([&] { return LatestTime(plugin) == tick; }, 3000));
+        CHECK(plugin.SilentFor(tick) == 0);
+    }
+
+    // A daemon that hangs keeps the connection but stops ticking: the silence grows past DAEMON_TIMEOUT (2 s)
+    CHECK(plugin.Connected());
+    CHECK(plugin.SilentFor(now + 6) == 3);
+
+    // A daemon that exits closes the stream; a new one on the same name is attached to again
+    daemon.Stop();
+    CHECK(WaitFor([&] { return !plugin.Connected(); }, 3000));
+    SubscriptionServer restarted;
+    CHECK(restarted.Start(name.c_str()));
+    CHECK(plugin.Connect(name.c_str(), ~0ull));
+    CHECK(WaitFor([&] { PublishReadings(&restarted, now + 10, readings); return LatestTime(plugin) == now + 10; }, 3000));
+    restarted.Stop();
+}
+
+
+TEST(Subscription, AttachedTickCost) {
+    // With the daemon sampling once per tick, consumers attached to it pay only the delivery of the frame
+    std::string name = StreamName("tick_cost");
+    SubscriptionServer daemon;
+    CHECK(daemon.Start(name.c_str()));
+    const int consumers = 4;
+    SubscriptionClient plugins[consumers];
+    for (SubscriptionClient& plugin : plugins) CHECK(plugin.Connect(name.c_str(), ~0ull));
+    double readings[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) readings[i] = 1.0;
+    int64_t now = time(NULL);
+    for (SubscriptionClient& plugin : plugins) {
+        CHECK(WaitFor([&] { PublishReadings(&daemon, now, readings); return LatestTime(plugin) == now; }, 3000));
+    }
+
+    // The sampler's share: the frame is copied and the client threads are woken
+    Benchmark("publish to 4 consumers", 1000, [&](int tick) {
+        readings[METRIC_CPU_LOAD] = tick;
+        PublishReadings(&daemon, now + 1 + tick, readings);
+    });
+
+    // Until every consumer holds the frame of the tick
+    int64_t start = now + 1001;
+    bool delivered = true;
+    Benchmark("publish and delivery to 4 consumers", 200, [&](int tick) {
+        readings[METRIC_CPU_LOAD] = tick;
+        PublishReadings(&daemon, start + tick, readings);
+        for (SubscriptionClient& plugin : plugins) {
+            while (delivered && LatestTime(plugin) != start + tick) {
+                if (!plugin.Connected()) delivered = false;
+                std::this_thread::yield();
+            }
+        }
+    });
+    CHECK(delivered);
+    daemon.Stop();
+}
@@ -0,0 +1,45 @@
+// Minimal test harness of the native modules.
+// TEST registers a test function under a suite; CHECK and CHECK_NEAR report a failed condition with its
+// location and let the test go on, so one run lists every broken expectation of a suite.
+// Benchmark times a loop inside a test and prints its cost, which cpugpu_tests <Suite> shows.
+
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+
+
+typedef void (*TestFunction)();
+
+// Add a test to the registry; returns a dummy value so registration can run as a static initializer
+int RegisterTest(const char* suite, const char* name, TestFunction function);
+void ReportFailure(const char* file, int line, const char* expression);
+void ReportNotNear(const char* file, int line, const char* expression, double actual, double expected);
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static const int suite##_##name##_registered = RegisterTest(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(condition) \
+    do { if (!(condition)) ReportFailure(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double checkActual = (actual), checkExpected = (expected); \
+        if (!(fabs(checkActual - checkExpected) <= (tolerance))) \
+            ReportNotNear(__FILE__, __LINE__, #actual, checkActual, checkExpected); \
+    } while (0)
+
+
+// Run 'body(i)' for i from 0 to 'iterations' - 1 and print the average cost of a run; returns it in nanoseconds
+template <typename Body>
+double Benchmark(const char* what, int iterations, Body body) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) body(i);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    double nanoseconds = elapsed.count() / iterations;
+    printf("  %s: %.1f ns\n", what, nanoseconds);
+    return nanoseconds;
+}
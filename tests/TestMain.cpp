@@ -0,0 +1,64 @@
+// Runner of the registered tests, see Test.h
+//
+// Usage: cpugpu_tests [suite]   Run the tests of one suite, or all of them; exits with 1 if any failed.
+
+#include "Test.h"
+
+#include <string.h>
+#include <vector>
+
+
+struct TestCase {
+    const char* suite;
+    const char* name;
+    TestFunction function;
+};
+
+
+static std::vector<TestCase>& Registry() {
+    static std::vector<TestCase> tests;     // Filled by static initializers, so created on first use
+    return tests;
+}
+
+static int failures = 0;
+
+
+int RegisterTest(const char* suite, const char* name, TestFunction function) {
+    Registry().push_back({ suite, name, function });
+    return 0;
+}
+
+
+void ReportFailure(const char* file, int line, const char* expression) {
+    printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+    failures++;
+}
+
+
+void ReportNotNear(const char* file, int line, const char* expression, double actual, double expected) {
+    printf("  %s:%d: %s is %.9g, expected %.9g\n", file, line, expression, actual, expected);
+    failures++;
+}
+
+
+int main(int argc, char* argv[]) {
+    const char* suite = (argc > 1) ? argv[1] : NULL;
+    int run = 0;
+    int failed = 0;
+    for (const TestCase& test : Registry()) {
+        if (suite != NULL && strcmp(test.suite, suite) != 0) continue;
+        int before = failures;
+        test.function();
+        run++;
+        bool passed = failures == before;
+        if (!passed) failed++;
+        printf("%s %s.%s\n", passed ? "[  OK  ]" : "[FAILED]", test.suite, test.name);
+    }
+
+    if (run == 0) {
+        printf("No tests in suite %s\n", suite ? suite : "(all)");
+        return 1;
+    }
+    printf("%d of %d tests passed\n", run - failed, run);
+    return (failed == 0) ? 0 : 1;
+}
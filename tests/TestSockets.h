@@ -0,0 +1,122 @@
+// Loopback sockets for the tests of the network modules: a collector or browser on 127.0.0.1
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET TestSocket;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int TestSocket;
+#endif
+
+
+class LoopbackSocket {
+public:
+    // A new UDP or TCP socket
+    explicit LoopbackSocket(bool tcp) {
+#ifdef _WIN32
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+        handle = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    }
+
+    // A connection returned by Accept
+    explicit LoopbackSocket(TestSocket accepted) : handle(accepted) {
+#ifdef _WIN32
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+    }
+
+    ~LoopbackSocket() {
+        Close();
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    void Close() {
+        if (!Valid()) return;
+#ifdef _WIN32
+        closesocket(handle);
+#else
+        close(handle);
+#endif
+        handle = static_cast<TestSocket>(-1);
+    }
+
+    bool Valid() const { return handle != static_cast<TestSocket>(-1); }
+
+    // Bind to 127.0.0.1:'port', 0 for a free one (see Port), and listen if 'listening'
+    bool Bind(int port, bool listening) {
+        sockaddr_in address = Address(port);
+#ifndef _WIN32
+        // Rebinding the port of a collector that just stopped must not wait for its connections in TIME_WAIT
+        int reuse = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+        if (bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) return false;
+        return !listening || listen(handle, 4) == 0;
+    }
+
+    bool Connect(int port) {
+        sockaddr_in address = Address(port);
+        return connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    }
+
+    int Port() const {
+        sockaddr_in address = {};
+        socklen_t length = sizeof(address);
+        getsockname(handle, reinterpret_cast<sockaddr*>(&address), &length);
+        return ntohs(address.sin_port);
+    }
+
+    // Wait up to 'milliseconds' until the socket is readable, e.g. a connection waits to be accepted
+    bool Readable(int milliseconds) const {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(handle, &readable);
+        timeval timeout = { milliseconds / 1000, (milliseconds % 1000) * 1000 };
+        return select(static_cast<int>(handle) + 1, &readable, NULL, NULL, &timeout) > 0;
+    }
+
+    TestSocket Accept(int milliseconds) const {
+        if (!Readable(milliseconds)) return static_cast<TestSocket>(-1);
+        return accept(handle, NULL, NULL);
+    }
+
+    // Receive what arrives within 'milliseconds'; returns the bytes, -1 on error, 0 at the end of a stream
+    int Receive(char* data, int size, int milliseconds) const {
+        if (!Readable(milliseconds)) return -1;
+        return static_cast<int>(recv(handle, data, size, 0));
+    }
+
+    bool Send(const std::string& data) const {
+        return send(handle, data.data(), static_cast<int>(data.size()), 0) == static_cast<int>(data.size());
+    }
+
+private:
+    LoopbackSocket(const LoopbackSocket&) = delete;
+    LoopbackSocket& operator=(const LoopbackSocket&) = delete;
+
+    static sockaddr_in Address(int port) {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return address;
+    }
+
+    TestSocket handle;
+};
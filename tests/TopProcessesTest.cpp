@@ -0,0 +1,150 @@
+// Tests of the top process ranking on made-up process lists, see TopProcesses.h
+
+#include "Test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "TopProcesses.h"
+
+
+static const uint64_t SECOND = 10000000;    // CPU time units (100 ns) per second
+
+
+// One process of a made-up scan
+struct FakeProcess {
+    uint32_t pid;
+    uint64_t startTime;
+    uint64_t cpuTime;
+    uint64_t memory;
+    const char* name;
+};
+
+
+// Feed a scan taken at 'seconds' the way the plugin does, naming only the processes Sample asks for;
+// returns the number of names asked for
+static int Scan(TopProcesses* top, double seconds, const std::vector<FakeProcess>& list, int processors = 4) {
+    int named = 0;
+    top->Begin(seconds);
+    for (const FakeProcess& process : list) {
+        if (top->Sample(process.pid, process.startTime, process.cpuTime, process.memory)) {
+            top->SetName(process.pid, process.name);
+            named++;
+        }
+    }
+    top->End(processors);
+    return named;
+}
+
+
+TEST(TopProcesses, RanksByCpuAndMemory) {
+    TopProcesses top;
+    std::vector<FakeProcess> list = {
+        { 10, 1, 0, 100 << 20, "idle.exe" },
+        { 20, 2, 0, 900 << 20, "browser.exe" },
+        { 30, 3, 0, 50 << 20, "compiler.exe" },
+    };
+    CHECK(Scan(&top, 100.0, list) == 3);
+    CHECK(!top.Valid());        // One scan gives no CPU interval yet
+
+    // Over one second on 4 processors: the compiler used 2 of them, the browser a fifth of one
+    list[1].cpuTime += SECOND / 5;
+    list[2].cpuTime += 2 * SECOND;
+    CHECK(Scan(&top, 101.0, list) == 0);
+    CHECK(top.Valid());
+    CHECK(top.Count(false) == 3 && top.Count(true) == 3);
+    CHECK(top.Top(0, false).name == "compiler.exe");
+    CHECK_NEAR(top.Top(0, false).cpu, 50.0, 1e-9);
+    CHECK(top.Top(1, false).name == "browser.exe");
+    CHECK_NEAR(top.Top(1, false).cpu, 5.0, 1e-9);
+    CHECK(top.Top(2, false).cpu == 0.0);
+    CHECK(top.Top(0, true).name == "browser.exe" && top.Top(0, true).memory == 900u << 20);
+    CHECK(top.Top(2, true).pid == 30);
+}
+
+
+TEST(TopProcesses, ReusedPidIsANewProcess) {
+    TopProcesses top;
+    std::vector<FakeProcess> list = { { 10, 1, 50 * SECOND, 1 << 20, "old.exe" } };
+    Scan(&top, 0.0, list);
+    Scan(&top, 1.0, list);
+
+    // The process exited and its id went to a new one, whose CPU time starts low: not a negative delta,
+    // no usage until it was seen twice, and its own name
+    list[0] = { 10, 5, SECOND, 2 << 20, "new.exe" };
+    CHECK(Scan(&top, 2.0, list) == 1);
+    CHECK(top.Top(0, false).name == "new.exe");
+    CHECK(top.Top(0, false).cpu == 0.0);
+    list[0].cpuTime += SECOND;
+    CHECK(Scan(&top, 3.0, list) == 0);
+    CHECK_NEAR(top.Top(0, false).cpu, 25.0, 1e-9);
+}
+
+
+TEST(TopProcesses, PrunesExitedProcesses) {
+    TopProcesses top;
+    std::vector<FakeProcess> list = {
+        { 10, 1, 0, 1 << 20, "short.exe" },
+        { 20, 2, 0, 2 << 20, "long.exe" },
+    };
+    Scan(&top, 0.0, list);
+    Scan(&top, 1.0, list);
+    CHECK(top.Count(true) == 2);
+
+    // short.exe exited: it leaves the lists at once
+    std::vector<FakeProcess> remaining(list.begin() + 1, list.end());
+    Scan(&top, 2.0, remaining);
+    CHECK(top.Count(true) == 1 && top.Top(0, true).pid == 20);
+
+    // A process missing from one scan is new again when it shows up, with no usage over the gap
+    list[0].cpuTime += 10 * SECOND;
+    CHECK(Scan(&top, 3.0, list) == 1);
+    for (int rank = 0; rank < top.Count(false); rank++) {
+        if (top.Top(rank, false).pid == 10) CHECK(top.Top(rank, false).cpu == 0.0);
+    }
+}
+
+
+TEST(TopProcesses, KeepsTopCount) {
+    TopProcesses top;
+    std::vector<FakeProcess> list;
+    for (uint32_t i = 0; i < 100; i++) list.push_back({ 4 * (i + 1), i, 0, (i + 1) * 4096ull, "p.exe" });
+    Scan(&top, 0.0, list);
+    for (uint32_t i = 0; i < 100; i++) list[i].cpuTime = (i % 10 == 7) ? SECOND : i * 1000;
+    Scan(&top, 1.0, list);
+
+    CHECK(top.Count(false) == TopProcesses::TOP_COUNT && top.Count(true) == TopProcesses::TOP_COUNT);
+    for (int rank = 0; rank < TopProcesses::TOP_COUNT; rank++) {
+        CHECK(top.Top(rank, true).pid == 4u * (100 - rank));
+        CHECK_NEAR(top.Top(rank, false).cpu, 25.0, 1e-9);      // The ten processes with i % 10 == 7
+        if (rank > 0) CHECK(top.Top(rank, false).cpu <= top.Top(rank - 1, false).cpu);
+    }
+}
+
+
+TEST(TopProcesses, ScanCost) {
+    // 10000 processes, a few dozen of them starting and exiting between scans, as on a busy build server
+    const int count = 10000;
+    std::vector<FakeProcess> list;
+    std::vector<std::string> names;
+    for (int i = 0; i < count; i++) names.push_back("process" + std::to_string(i) + ".exe");
+    for (int i = 0; i < count; i++) {
+        list.push_back({ static_cast<uint32_t>(4 * (i + 1)), static_cast<uint64_t>(i), 0, static_cast<uint64_t>(i) << 12,
+            names[i].c_str() });
+    }
+
+    TopProcesses top;
+    uint64_t nextStart = count;
+    int named = 0;
+    Benchmark("Scan of 10000 processes", 200, [&](int scan) {
+        for (int i = 0; i < count; i++) list[i].cpuTime += static_cast<uint64_t>((i * 7919 + scan * 104729) % 1000) * 100;
+        for (int i = scan % 50; i < count; i += 500) list[i].startTime = nextStart++;      // 20 new processes
+        named += Scan(&top, scan, list, 64);
+    });
+    printf("  names converted per scan: %.1f\n", static_cast<double>(named - count) / 199);
+    CHECK(top.Valid());
+    CHECK(top.Count(false) == TopProcesses::TOP_COUNT);
+    CHECK(named <= count + 200 * 20);
+}
@@ -0,0 +1,218 @@
+// Tests of the layout and the screen of cpugpu-top, see TopScreen.h
+
+#include "Test.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "TopScreen.h"
+
+
+namespace {
+
+// Values of every metric, different per metric
+void FakeValues(double base, double* values) {
+    for (int i = 0; i < METRIC_COUNT; i++) values[i] = base + i;
+}
+
+// Number of lines that hold the line of a metric ("  Name ...") in one of the columns
+int CountMetric(const std::vector<std::string>& lines, const char* name) {
+    std::string entry = std::string("  ") + name + " ";
+    int found = 0;
+    for (const std::string& line : lines) {
+        for (size_t at = line.find(entry); at != std::string::npos; at = line.find(entry, at + 1)) found++;
+    }
+    return found;
+}
+
+}
+
+
+TEST(TopScreen, StandardTerminalShowsEveryMetric) {
+    MetricHistory history;
+    double values[METRIC_COUNT];
+    FakeValues(10.0, values);
+    for (int second = 0; second < 60; second++) history.Append(values);
+
+    int scroll = 0;
+    std::vector<std::string> lines = Layout("CPUGPU", 0, 0, history, values, 80, 24, &scroll);
+    CHECK(lines.size() <= 24);
+    CHECK(scroll == 0);
+    CHECK(lines[0].find("rows") == std::string::npos);
+    for (const std::string& line : lines) CHECK(line.size() <= 79);
+    for (int i = 0; i < METRIC_COUNT; i++) CHECK(CountMetric(lines, METRICS[i].name) >= 1);
+
+    // Two columns, each metric in one of them
+    int entries = 0;
+    for (size_t row = 1; row < lines.size(); row++) {
+        if (lines[row].compare(0, 2, "  ") == 0) entries++;
+        if (lines[row].size() > 40 && lines[row].compare(40, 2, "  ") == 0) entries++;
+    }
+    CHECK(entries == METRIC_COUNT);
+}
+
+
+TEST(TopScreen, TallTerminalUsesOneColumn) {
+    MetricHistory history;
+    double values[METRIC_COUNT];
+    FakeValues(10.0, values);
+    history.Append(values);
+
+    int scroll = 0;
+    std::vector<std::string> lines = Layout("CPUGPU", 0, 0, history, values, 80, 100, &scroll);
+    // One metric per line, with a blank line and a heading per group
+    int groups = 0;
+    for (int i = 0; i < METRIC_COUNT; i++) if (i == 0 || METRICS[i].group != METRICS[i - 1].group) groups++;
+    int blanks = 0, headings = 0, entries = 0;
+    for (size_t row = 1; row < lines.size(); row++) {
+        if (lines[row].empty()) blanks++;
+        else if (lines[row][0] != ' ') headings++;
+        else entries++;
+    }
+    CHECK(blanks == groups);
+    CHECK(headings == groups);
+    CHECK(entries == METRIC_COUNT);
+}
+
+
+TEST(TopScreen, SmallTerminalScrollsWithinBody) {
+    MetricHistory history;
+    double values[METRIC_COUNT];
+    FakeValues(10.0, values);
+    history.Append(values);
+
+    // Too narrow for two columns and too low for one: the header tells which rows are shown
+    int scroll = -5;
+    std::vector<std::string> lines = Layout("CPUGPU", 0, 0, history, values, 40, 10, &scroll);
+    CHECK(scroll == 0);
+    CHECK(lines.size() == 10);
+    CHECK(lines[0].find("rows 1-9 of ") != std::string::npos);
+    CHECK(lines[1] == "");
+    CHECK(lines[2] == "CPU");
+
+    // Scrolling past the end stops at the last page, which ends with the last metric
+    scroll = 1000;
+    lines = Layout("CPUGPU", 0, 0, history, values, 40, 10, &scroll);
+    CHECK(scroll > 0);
+    CHECK(lines.size() == 10);
+    CHECK(CountMetric(std::vector<std::string>(1, lines.back()), METRICS[METRIC_COUNT - 1].name) == 1);
+    int shownScroll = scroll;
+    scroll = shownScroll + 1;
+    Layout("CPUGPU", 0, 0, history, values, 40, 10, &scroll);
+    CHECK(scroll == shownScroll);
+}
+
+
+TEST(TopScreen, StaleValuesInParentheses) {
+    MetricHistory history;
+    double values[METRIC_COUNT];
+    FakeValues(10.0, values);
+    history.Append(values);
+
+    int scroll = 0;
+    std::vector<std::string> lines = Layout("CPUGPU", 0, 7, history, values, 80, 100, &scroll);
+    CHECK(lines[0].find("STALE, no data for 7s") != std::string::npos);
+    int parenthesized = 0;
+    for (size_t row = 1; row < lines.size(); row++) if (lines[row].find('(') != std::string::npos) parenthesized++;
+    CHECK(parenthesized == METRIC_COUNT);
+
+    lines = Layout("CPUGPU", 0, 0, history, values, 80, 100, &scroll);
+    CHECK(lines[0].find("STALE") == std::string::npos);
+    for (const std::string& line : lines) CHECK(line.find('(') == std::string::npos);
+}
+
+
+TEST(TopScreen, SparklineFollowsRange) {
+    MetricHistory history;
+    double values[METRIC_COUNT];
+    for (int second = 0; second < SPARK_LEVELS; second++) {
+        FakeValues(second, values);
+        history.Append(values);
+    }
+
+    // A rising metric climbs through every level; unknown seconds are blank
+    std::string line;
+    history.AppendSparkline(0, SPARK_LEVELS + 4, &line);
+    CHECK(line.size() == SPARK_LEVELS);
+    for (int i = 0; i < SPARK_LEVELS; i++) CHECK(line[i] == static_cast<char>(i + 1));
+
+    values[0] = NAN;
+    history.Append(values);
+    line.clear();
+    history.AppendSparkline(0, 3, &line);
+    CHECK(line.size() == 3);
+    CHECK(line[2] == ' ');
+}
+
+
+TEST(TopScreen, ScreenRewritesOnlyChangedSpans) {
+    Screen screen;
+    std::string out;
+    screen.Reset(20, 3, &out);
+    CHECK(out == "\x1b[H\x1b[2J");
+    CHECK(screen.SameSize(20, 3));
+    CHECK(!screen.SameSize(20, 4));
+
+    std::vector<std::string> lines = { "header", "  Load 42", std::string("  spark \x01\x08 ") + "\xB0" };
+    out.clear();
+    screen.Draw(lines, &out);
+    // Blanks already on the cleared screen are skipped; levels and degree signs are written as UTF-8
+    CHECK(out == "\x1b[1;1Hheader\x1b[2;3HLoad 42\x1b[3;3Hspark \xE2\x96\x81\xE2\x96\x88 \xC2\xB0");
+
+    // Nothing changed: nothing to write
+    out.clear();
+    screen.Draw(lines, &out);
+    CHECK(out.empty());
+
+    // One digit changed: the cursor moves there and writes that character only
+    lines[1] = "  Load 47";
+    out.clear();
+    screen.Draw(lines, &out);
+    CHECK(out == "\x1b[2;9H7");
+
+    // A shorter line blanks the rest; a line longer than the width minus one is cut
+    lines[0] = "head";
+    lines[2] = std::string(40, 'x');
+    out.clear();
+    screen.Draw(lines, &out);
+    CHECK(out == "\x1b[1;5H  \x1b[3;1H" + std::string(19, 'x'));
+}
+
+
+
+TEST(TopScreen, RefreshCost) {
+    // A standard terminal where every reading moves a little each second, as under a steady load
+    MetricHistory history;
+    Screen screen;
+    std::string out;
+    screen.Reset(80, 24, &out);
+    double values[METRIC_COUNT];
+    int scroll = 0;
+    std::vector<std::string> lines;
+    for (int second = 0; second < SPARK_SAMPLES; second++) {
+        FakeValues(40.0 + (second % 3), values);
+        history.Append(values);
+        lines = Layout("CPUGPU", 1700000000 + second, 0, history, values, 80, 24, &scroll);
+        out.clear();
+        screen.Draw(lines, &out);
+    }
+
+    // Against the same screen drawn in full, as a terminal without the difference would get it
+    Screen cleared;
+    std::string full;
+    cleared.Reset(80, 24, &full);
+    cleared.Draw(lines, &full);
+    const int seconds = 60;
+    size_t written = 0;
+    Benchmark("layout and redraw of 80x24", seconds, [&](int second) {
+        FakeValues(40.0 + (second % 3), values);
+        history.Append(values);
+        out.clear();
+        screen.Draw(Layout("CPUGPU", 1700000000 + second, 0, history, values, 80, 24, &scroll), &out);
+        written += out.size();
+    });
+    printf("  written per refresh: %zu bytes, %zu in full\n", written / seconds, full.size());
+    // The sparklines scroll every second, so the difference mostly saves the labels and the unchanged digits
+    CHECK(written / seconds < full.size());
+}